@@ -0,0 +1,357 @@
+#include "archive.hpp"
+#include "threadpool.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+// ------------------------------------------------------------------------------------------------
+
+namespace ELF
+{
+    namespace details {
+        static constexpr char   ArchiveMagic[] = "!<arch>\n";
+        static constexpr size_t MagicSize      = sizeof(ArchiveMagic) - 1;
+
+        // Offsets of the fields of an ar member header, all ASCII and padded with spaces.
+        static constexpr size_t NameField  = 0;
+        static constexpr size_t MtimeField = 16;
+        static constexpr size_t ModeField  = 40;
+        static constexpr size_t SizeField  = 48;
+        static constexpr size_t FmagField  = 58;
+
+        // Parses a space padded number, false when there are no digits at all.
+        static inline
+        bool
+        parse_number(const uint8_t* field, size_t width, uint64_t base, uint64_t& value)
+        {
+            value = 0;
+            size_t i = 0;
+
+            for (; i < width && field[i] >= '0' && field[i] < '0' + base; i++)
+                value = value * base + (field[i] - '0');
+
+            if(i == 0)
+                return false;
+
+            for (; i < width; i++)
+            {
+                if(field[i] != ' ')
+                    return false;
+            }
+
+            return true;
+        }
+
+        static inline
+        std::string_view
+        field_text(const uint8_t* field, size_t width)
+        {
+            std::string_view text(reinterpret_cast<const char*>(field), width);
+            size_t end = text.find_last_not_of(' ');
+
+            return text.substr(0, end == std::string_view::npos ? 0 : end + 1);
+        }
+
+        static inline
+        uint64_t
+        load_big(const uint8_t* src, size_t width)
+        {
+            uint64_t value = 0;
+            for (size_t i = 0; i < width; i++)
+                value = (value << 8) | src[i];
+
+            return value;
+        }
+
+        static inline
+        uint32_t
+        load_little32(const uint8_t* src)
+        {
+            return uint32_t(src[0]) | uint32_t(src[1]) << 8 | uint32_t(src[2]) << 16 | uint32_t(src[3]) << 24;
+        }
+    }
+
+    // ------------------------------------------------------------------------------------------------
+
+    bool
+    Archive::is_archive(ByteView bytes)
+    {
+        return bytes.size() >= details::MagicSize && std::memcmp(bytes.data(), details::ArchiveMagic, details::MagicSize) == 0;
+    }
+
+    Archive::Archive(const std::string& filename, AccessHint hint)
+    {
+        details::MappedFile file;
+
+        if(Error error = file.map(filename, hint); error != Error::None)
+            throw std::runtime_error(to_string(error));
+
+        mapping = std::make_shared<const details::MappedFile>(std::move(file));
+        data    = mapping->view();
+
+        if(Error error = parse(); error != Error::None)
+            throw std::runtime_error(to_string(error));
+    }
+
+    Archive::Archive(ByteView bytes)
+        : data(bytes)
+    {
+        if(Error error = parse(); error != Error::None)
+            throw std::runtime_error(to_string(error));
+    }
+
+    Error
+    Archive::parse()
+    {
+        using namespace details;
+
+        // Thin archives ("!<thin>\n") only name their members, there is nothing to view.
+        if(!is_archive(data))
+            return Error::NotArchive;
+
+        ByteView long_names;
+        ByteView index;
+        bool     wide_index = false;
+        bool     bsd_index  = false;
+
+        size_t offset = MagicSize;
+
+        while(offset < data.size())
+        {
+            // Some tools pad the last member with a newline even when its size is even.
+            if(data.size() - offset < HeaderSize)
+            {
+                if(data.size() - offset == 1 && data[offset] == '\n')
+                    break;
+
+                return Error::BadArchive;
+            }
+
+            const uint8_t* header = data.data() + offset;
+            uint64_t size  = 0;
+            uint64_t mtime = 0;
+            uint64_t mode  = 0;
+
+            if(header[FmagField] != '`' || header[FmagField + 1] != '\n' || !parse_number(header + SizeField, 10, 10, size))
+                return Error::BadArchive;
+
+            size_t body = offset + HeaderSize;
+            if(size > data.size() - body)
+                return Error::BadArchive;
+
+            // Special members leave these blank.
+            parse_number(header + MtimeField, 12, 10, mtime);
+            parse_number(header + ModeField, 8, 8, mode);
+
+            ByteView         contents(data.data() + body, size_t(size));
+            std::string_view name = field_text(header + NameField, 16);
+
+            if(name == "/" || name == "/SYM64/")
+            {
+                index      = contents;
+                wide_index = name.size() > 1;
+            }
+            else if(name == "//")
+                long_names = contents;
+            else
+            {
+                if(name.size() > 1 && name[0] == '/')
+                {
+                    // GNU long name: "/offset" into the "//" member, ending with "/\n".
+                    uint64_t at = 0;
+                    if(!parse_number(header + NameField + 1, 15, 10, at) || at >= long_names.size())
+                        return Error::BadArchive;
+
+                    std::string_view table(reinterpret_cast<const char*>(long_names.data()), long_names.size());
+                    size_t end = table.find('\n', size_t(at));
+
+                    name = table.substr(size_t(at), end == std::string_view::npos ? std::string_view::npos : end - size_t(at));
+                }
+                else if(name.size() > 3 && name.compare(0, 3, "#1/") == 0)
+                {
+                    // BSD long name: the name takes the first bytes of the member data.
+                    uint64_t length = 0;
+                    if(!parse_number(header + NameField + 3, 13, 10, length) || length > contents.size())
+                        return Error::BadArchive;
+
+                    name     = std::string_view(reinterpret_cast<const char*>(contents.data()), size_t(length));
+                    name     = name.substr(0, name.find('\0'));
+                    contents = ByteView(contents.data() + length, contents.size() - size_t(length));
+                }
+
+                if(!name.empty() && name.back() == '/')
+                    name.remove_suffix(1);
+
+                if(name == "__.SYMDEF" || name == "__.SYMDEF SORTED")
+                {
+                    index     = contents;
+                    bsd_index = true;
+                }
+                else
+                    members.push_back(ArchiveMember { name, offset, mtime, static_cast<uint32_t>(mode), contents });
+            }
+
+            // Members start on even offsets.
+            offset = body + size_t(size) + (size & 1);
+        }
+
+        if(index.data() == nullptr)
+            return Error::None;
+
+        has_index = true;
+        return bsd_index ? parse_bsd_symbol_index(index) : parse_symbol_index(index, wide_index);
+    }
+
+    // ------------------------------------------------------------------------------------------------
+
+    // Member whose header is at the offset, members.size() for an offset no header is at.
+    static inline
+    uint32_t
+    member_at(const std::vector<ArchiveMember>& members, uint64_t header)
+    {
+        auto it = std::lower_bound(members.begin(), members.end(), header, [](const ArchiveMember& member, uint64_t offset) {
+            return member.header < offset;
+        });
+
+        return static_cast<uint32_t>((it != members.end() && it->header == header) ? it - members.begin() : members.size());
+    }
+
+    Error
+    Archive::parse_symbol_index(ByteView index, bool wide)
+    {
+        // Big-endian count, as many member header offsets, then as many NUL-terminated names.
+        size_t width = wide ? 8 : 4;
+        if(index.size() < width)
+            return Error::BadArchive;
+
+        uint64_t count = details::load_big(index.data(), width);
+        if(count > (index.size() - width) / width)
+            return Error::BadArchive;
+
+        const uint8_t*   offsets = index.data() + width;
+        std::string_view names(reinterpret_cast<const char*>(offsets + count * width), index.size() - (count + 1) * width);
+
+        symbols.reserve(size_t(count));
+        symbol_members.reserve(size_t(count));
+
+        for (size_t i = 0, at = 0; i < count && at < names.size(); i++)
+        {
+            size_t end = names.find('\0', at);
+            if(end == std::string_view::npos)
+                end = names.size();
+
+            std::string_view name   = names.substr(at, end - at);
+            uint32_t         member = member_at(members, details::load_big(offsets + i * width, width));
+            at = end + 1;
+
+            if(member == members.size())
+                continue;
+
+            symbols.push_back(ArchiveSymbol { name, member });
+            symbol_members.emplace(name, member);
+        }
+
+        return Error::None;
+    }
+
+    Error
+    Archive::parse_bsd_symbol_index(ByteView index)
+    {
+        // Byte size of the (name offset, header offset) pairs, the pairs, the size of the
+        // names and the names. Written in the byte order of the host ranlib ran on, little here.
+        if(index.size() < 4)
+            return Error::BadArchive;
+
+        uint32_t ranlib_size = details::load_little32(index.data());
+        if(ranlib_size > index.size() - 4 || index.size() - 4 - ranlib_size < 4)
+            return Error::BadArchive;
+
+        const uint8_t* pairs      = index.data() + 4;
+        uint32_t       names_size = details::load_little32(pairs + ranlib_size);
+
+        if(names_size > index.size() - 8 - ranlib_size)
+            return Error::BadArchive;
+
+        std::string_view names(reinterpret_cast<const char*>(pairs + ranlib_size + 4), names_size);
+        size_t count = ranlib_size / 8;
+
+        symbols.reserve(count);
+        symbol_members.reserve(count);
+
+        for (size_t i = 0; i < count; i++)
+        {
+            uint32_t at     = details::load_little32(pairs + i * 8);
+            uint32_t member = member_at(members, details::load_little32(pairs + i * 8 + 4));
+
+            if(at >= names.size() || member == members.size())
+                continue;
+
+            std::string_view name = names.substr(at);
+            name = name.substr(0, name.find('\0'));
+
+            symbols.push_back(ArchiveSymbol { name, member });
+            symbol_members.emplace(name, member);
+        }
+
+        return Error::None;
+    }
+
+    // ------------------------------------------------------------------------------------------------
+
+    const ArchiveMember*
+    Archive::find_symbol(std::string_view name) const
+    {
+        auto it = symbol_members.find(name);
+        return it != symbol_members.end() ? &members[it->second] : nullptr;
+    }
+
+    OpenResult
+    Archive::open_member(size_t index, LoadMode mode) const
+    {
+        return open_member(members.at(index), mode);
+    }
+
+    OpenResult
+    Archive::open_member(const ArchiveMember& member, LoadMode mode) const
+    {
+        // Rejected from the header alone, a member that isn't ELF costs nothing.
+        if(ProbeResult probe = Reader::probe(member.data); !probe)
+            return probe.error;
+
+        return Reader::open(mapping, member.data, mode);
+    }
+
+    std::vector<OpenResult>
+    Archive::open_members(const ScanOptions& options) const
+    {
+        std::vector<OpenResult> results(members.size(), OpenResult(Error::NotELF));
+
+        // A task per few dozen members keeps the queues short, stealing still balances them.
+        constexpr size_t slice = 32;
+
+        if(members.size() <= slice)
+        {
+            for (size_t i = 0; i < members.size(); i++)
+                results[i] = open_member(members[i], options.mode);
+
+            return results;
+        }
+
+        ThreadPool pool(options.threads);
+        ThreadPool::TaskGroup group;
+
+        for (size_t first = 0; first < members.size(); first += slice)
+        {
+            size_t last = std::min(first + slice, members.size());
+
+            pool.submit(group, [this, &results, &options, first, last] {
+                for (size_t i = first; i < last; i++)
+                    results[i] = open_member(members[i], options.mode);
+            });
+        }
+
+        pool.wait(group);
+        return results;
+    }
+}
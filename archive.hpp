@@ -0,0 +1,117 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2021 Eviatar
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef ARCHIVE_HPP
+#define ARCHIVE_HPP
+#pragma once
+
+#include "readelf.hpp"
+#include "scanner.hpp"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// ------------------------------------------------------------------------------------------------
+
+namespace ELF
+{
+    // One file stored in an archive, its data points into the archive.
+    struct ArchiveMember
+    {
+        std::string_view name;   // resolved through the long-name table, without the trailing '/'.
+        uint64_t         header; // offset of the member header, what the symbol index refers to.
+        uint64_t         mtime;
+        uint32_t         mode;
+        ByteView         data;
+    };
+
+    // Entry of the archive symbol index.
+    struct ArchiveSymbol
+    {
+        std::string_view name;
+        uint32_t         member; // index into get_members().
+    };
+
+    // Static library in the System V/GNU ar format (BSD #1/ names and __.SYMDEF are read too).
+    // The file is mapped once and parsed header by header; member contents are only touched
+    // when a member is opened, and every member Reader is a view into the same mapping.
+    class Archive
+    {
+    public:
+        // Size of an ar member header.
+        static constexpr size_t HeaderSize = 60;
+
+        // True for anything starting with the "!<arch>\n" magic.
+        static bool is_archive(ByteView bytes);
+
+        // Maps the archive and reads its member headers, throws std::runtime_error when the
+        // file isn't an archive or a header is malformed. Thin archives are rejected.
+        explicit Archive(const std::string& filename, AccessHint hint = AccessHint::Normal);
+        // Reads from caller-owned memory which has to outlive the archive and its readers.
+        explicit Archive(ByteView bytes);
+
+        inline ByteView get_data() const { return data; }
+
+        // Regular members in file order, the symbol index and long-name table are not listed.
+        inline const std::vector<ArchiveMember>& get_members() const { return members; }
+
+        // Symbol index as stored, empty when the archive has none (ar without 's').
+        inline const std::vector<ArchiveSymbol>& get_symbols() const { return symbols; }
+        inline bool has_symbol_index() const { return has_index; }
+
+        // Member defining the symbol according to the index, nullptr when it isn't indexed.
+        // The first member wins when several define it, as with the linker. Constant time.
+        const ArchiveMember* find_symbol(std::string_view name) const;
+
+        // Reader over the member's slice of the mapping, it keeps the mapping alive.
+        OpenResult open_member(size_t index, LoadMode mode = LoadMode::Eager) const;
+        OpenResult open_member(const ArchiveMember& member, LoadMode mode = LoadMode::Eager) const;
+
+        // Opens every member on a work-stealing pool, results are in member order. Members that
+        // aren't ELF (or fail the header checks) hold the error instead.
+        std::vector<OpenResult> open_members(const ScanOptions& options = {}) const;
+
+    private:
+        Error parse();
+        Error parse_symbol_index(ByteView index, bool wide);
+        Error parse_bsd_symbol_index(ByteView index);
+
+    private:
+        std::shared_ptr<const details::MappedFile> mapping;
+        ByteView data;
+
+        std::vector<ArchiveMember> members;
+        std::vector<ArchiveSymbol> symbols;
+        bool has_index = false;
+
+        // Index entries point at member headers, resolved to members once parsed.
+        std::unordered_map<std::string_view, uint32_t> symbol_members;
+    };
+}
+
+#endif // ARCHIVE_HPP
@@ -0,0 +1,371 @@
+#include "readelf.hpp"
+#include "generator.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Reader hot paths over synthetic files. Reports go through Google Benchmark, so
+// --benchmark_format=json or --benchmark_out=<file> give machine-readable results.
+//
+// Extra flags:
+//   --elf_sections=16,1024,65000   section counts, filler sections pad the table
+//   --elf_symbols=10000            symbols of .symtab, as many relocations in .rela.text
+//   --elf_segments=64              program headers, PT_NULL entries pad the table
+//   --elf_classes=64le,64be,32le   classes and byte orders to generate
+
+// ------------------------------------------------------------------------------------------------
+
+namespace
+{
+    struct Shape
+    {
+        bool   elf64     = true;
+        bool   big       = false;
+        size_t sections  = 1024;
+        size_t symbols   = 10000;
+        size_t segments  = 64;
+
+        std::string
+        name() const
+        {
+            return std::string(elf64 ? "elf64" : "elf32") + (big ? "be" : "le") + "/sections:" + std::to_string(sections);
+        }
+    };
+
+    // A shared object with one function per symbol in .text, as many relocations in
+    // .rela.text and filler sections up to the requested count.
+    std::vector<uint8_t>
+    generate(const Shape& shape)
+    {
+        ELF::GeneratorOptions options;
+        options.file_class      = shape.elf64 ? ELF::FileClass::ELF64 : ELF::FileClass::ELF32;
+        options.endian          = shape.big ? ELF::Endianness::Big : ELF::Endianness::Little;
+        options.machine         = shape.elf64 ? ELF::InstructionSetArchitectureType::AMD_X86_64
+                                              : ELF::InstructionSetArchitectureType::X86;
+        options.program_headers = shape.segments;
+        options.sections        = shape.sections;
+        options.symbols         = shape.symbols;
+        options.relocations     = shape.symbols;
+
+        return ELF::generate_elf(options);
+    }
+
+    // One generated file, in memory and on disk.
+    struct Fixture
+    {
+        Shape                shape;
+        std::vector<uint8_t> bytes;
+        std::string          path;
+
+        ELF::ByteView view() const { return ELF::ByteView(bytes.data(), bytes.size()); }
+    };
+
+    std::vector<std::unique_ptr<Fixture>> fixtures;
+
+    const char* symtab_name = ".symtab";
+    const char* rela_name   = ".rela.text";
+
+    size_t
+    section_index(const ELF::Reader& reader, const char* name)
+    {
+        return static_cast<size_t>(reader.find_section(name) - reader.get_section_headers().data());
+    }
+
+    // ------------------------------------------------------------------------------------------------
+
+    void
+    BM_Probe(benchmark::State& state, const Fixture* fixture)
+    {
+        for (auto _ : state)
+            benchmark::DoNotOptimize(ELF::Reader::probe(fixture->path));
+
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    void
+    BM_OpenEager(benchmark::State& state, const Fixture* fixture)
+    {
+        for (auto _ : state)
+        {
+            ELF::OpenResult reader = ELF::Reader::open(fixture->path, ELF::AccessHint::Normal, ELF::LoadMode::Eager);
+            benchmark::DoNotOptimize(reader.error());
+        }
+
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    void
+    BM_OpenLazy(benchmark::State& state, const Fixture* fixture)
+    {
+        for (auto _ : state)
+        {
+            ELF::OpenResult reader = ELF::Reader::open(fixture->path, ELF::AccessHint::Normal, ELF::LoadMode::Lazy);
+            benchmark::DoNotOptimize(reader.error());
+        }
+
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    void
+    BM_DecodeProgramHeaders(benchmark::State& state, const Fixture* fixture)
+    {
+        size_t count = 0;
+
+        for (auto _ : state)
+        {
+            ELF::Reader reader(fixture->view(), ELF::LoadMode::Lazy);
+            count = reader.get_program_headers().size();
+            benchmark::DoNotOptimize(count);
+        }
+
+        size_t entsize = fixture->shape.elf64 ? 56 : 32;
+        state.SetItemsProcessed(state.iterations() * count);
+        state.SetBytesProcessed(state.iterations() * count * entsize);
+    }
+
+    void
+    BM_DecodeSectionHeaders(benchmark::State& state, const Fixture* fixture)
+    {
+        size_t count = 0;
+
+        for (auto _ : state)
+        {
+            ELF::Reader reader(fixture->view(), ELF::LoadMode::Lazy);
+            count = reader.get_section_headers().size();
+            benchmark::DoNotOptimize(count);
+        }
+
+        size_t entsize = fixture->shape.elf64 ? 64 : 40;
+        state.SetItemsProcessed(state.iterations() * count);
+        state.SetBytesProcessed(state.iterations() * count * entsize);
+    }
+
+    void
+    BM_FindSection(benchmark::State& state, const Fixture* fixture)
+    {
+        ELF::Reader reader(fixture->view());
+        reader.find_section(".text");
+
+        std::vector<std::string> names;
+        // Fillers sit between the fixed sections and .text, .fill.5 is one whatever the count.
+        for (size_t i = 5; i + 2 < fixture->shape.sections; i += std::max<size_t>(1, fixture->shape.sections / 256))
+            names.push_back(".fill." + std::to_string(i));
+        names.push_back(".text");
+
+        size_t i = 0;
+        for (auto _ : state)
+            benchmark::DoNotOptimize(reader.find_section(names[i++ % names.size()]));
+
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    void
+    BM_ReadSymbolTable(benchmark::State& state, const Fixture* fixture)
+    {
+        ELF::Reader reader(fixture->view());
+        size_t index = section_index(reader, symtab_name);
+
+        for (auto _ : state)
+            benchmark::DoNotOptimize(reader.read_symbol_table(index).count());
+
+        state.SetItemsProcessed(state.iterations() * (fixture->shape.symbols + 1));
+    }
+
+    void
+    BM_LookupSymbol(benchmark::State& state, const Fixture* fixture)
+    {
+        ELF::Reader reader(fixture->view());
+
+        std::vector<std::string> names;
+        std::mt19937_64 random(42);
+        for (size_t i = 0; i < 4096; i++)
+            names.push_back("function_" + std::to_string(random() % fixture->shape.symbols));
+
+        reader.lookup_symbol(names[0]);
+
+        size_t i = 0;
+        for (auto _ : state)
+            benchmark::DoNotOptimize(reader.lookup_symbol(names[i++ & 4095]));
+
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    void
+    BM_Symbolize(benchmark::State& state, const Fixture* fixture)
+    {
+        ELF::Reader reader(fixture->view());
+
+        std::vector<uint64_t> addresses(4096);
+        std::mt19937_64 random(42);
+        for (uint64_t& address : addresses)
+            address = 0x400000 + random() % (fixture->shape.symbols * 16);
+
+        reader.symbolize(addresses[0]);
+
+        size_t i = 0;
+        for (auto _ : state)
+            benchmark::DoNotOptimize(reader.symbolize(addresses[i++ & 4095]));
+
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    void
+    BM_SymbolizeBatch(benchmark::State& state, const Fixture* fixture)
+    {
+        ELF::Reader reader(fixture->view());
+
+        std::vector<uint64_t> addresses(4096);
+        std::mt19937_64 random(42);
+        for (uint64_t& address : addresses)
+            address = 0x400000 + random() % (fixture->shape.symbols * 16);
+
+        std::sort(addresses.begin(), addresses.end());
+        reader.symbolize(addresses[0]);
+
+        for (auto _ : state)
+            benchmark::DoNotOptimize(reader.symbolize(addresses).size());
+
+        state.SetItemsProcessed(state.iterations() * addresses.size());
+    }
+
+    void
+    BM_ReadRelocations(benchmark::State& state, const Fixture* fixture)
+    {
+        ELF::Reader reader(fixture->view());
+        size_t index = section_index(reader, rela_name);
+
+        for (auto _ : state)
+            benchmark::DoNotOptimize(reader.read_relocations(index).count());
+
+        state.SetItemsProcessed(state.iterations() * fixture->shape.symbols);
+    }
+
+    // ------------------------------------------------------------------------------------------------
+
+    std::vector<size_t>
+    parse_list(const char* list)
+    {
+        std::vector<size_t> values;
+        std::istringstream in(list);
+
+        for (std::string item; std::getline(in, item, ',');)
+            values.push_back(std::strtoull(item.c_str(), nullptr, 10));
+
+        return values;
+    }
+
+    // Takes the --elf_* flags out of argv, the rest is Google Benchmark's.
+    void
+    parse_flags(int& argc, char** argv, std::vector<Shape>& shapes)
+    {
+        std::vector<size_t> sections = { 16, 1024, 65000 };
+        std::vector<std::string> classes = { "64le", "32le", "64be" };
+        size_t symbols  = 10000;
+        size_t segments = 64;
+
+        int kept = 1;
+        for (int i = 1; i < argc; i++)
+        {
+            const char* arg = argv[i];
+
+            if(std::strncmp(arg, "--elf_sections=", 15) == 0)
+                sections = parse_list(arg + 15);
+            else if(std::strncmp(arg, "--elf_symbols=", 14) == 0)
+                symbols = std::strtoull(arg + 14, nullptr, 10);
+            else if(std::strncmp(arg, "--elf_segments=", 15) == 0)
+                segments = std::strtoull(arg + 15, nullptr, 10);
+            else if(std::strncmp(arg, "--elf_classes=", 14) == 0)
+            {
+                classes.clear();
+                std::istringstream in(arg + 14);
+                for (std::string item; std::getline(in, item, ',');)
+                    classes.push_back(item);
+            }
+            else
+                argv[kept++] = argv[i];
+        }
+
+        argc = kept;
+
+        for (const std::string& name : classes)
+        {
+            for (size_t count : sections)
+            {
+                Shape shape;
+                shape.elf64    = name.substr(0, 2) != "32";
+                shape.big      = name.size() >= 4 && name.substr(2, 2) == "be";
+                shape.sections = count; // 65280 and up use SHN_XINDEX
+                shape.symbols  = std::max<size_t>(symbols, 1);
+                shape.segments = segments;
+                shapes.push_back(shape);
+            }
+        }
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    std::vector<Shape> shapes;
+    parse_flags(argc, argv, shapes);
+
+    benchmark::Initialize(&argc, argv);
+    if(benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+
+    const char* tmp = std::getenv("TMPDIR");
+    std::string dir = tmp ? tmp : "/tmp";
+
+    for (const Shape& shape : shapes)
+    {
+        auto fixture   = std::make_unique<Fixture>();
+        fixture->shape = shape;
+        fixture->bytes = generate(shape);
+        fixture->path  = dir + "/readelf-bench-" + std::to_string(fixtures.size()) + ".elf";
+
+        std::ofstream(fixture->path, std::ios::binary).write(reinterpret_cast<const char*>(fixture->bytes.data()), fixture->bytes.size());
+        fixtures.push_back(std::move(fixture));
+    }
+
+    using Benchmark = void (*)(benchmark::State&, const Fixture*);
+    const std::pair<const char*, Benchmark> benchmarks[] = {
+        { "Probe",               BM_Probe                },
+        { "OpenEager",           BM_OpenEager            },
+        { "OpenLazy",            BM_OpenLazy             },
+        { "DecodeProgramHeaders", BM_DecodeProgramHeaders },
+        { "DecodeSectionHeaders", BM_DecodeSectionHeaders },
+        { "FindSection",         BM_FindSection          },
+        { "ReadSymbolTable",     BM_ReadSymbolTable      },
+        { "LookupSymbol",        BM_LookupSymbol         },
+        { "Symbolize",           BM_Symbolize            },
+        { "SymbolizeBatch",      BM_SymbolizeBatch       },
+        { "ReadRelocations",     BM_ReadRelocations      },
+    };
+
+    for (const auto& benchmark : benchmarks)
+    {
+        for (const auto& fixture : fixtures)
+        {
+            std::string name = std::string(benchmark.first) + "/" + fixture->shape.name();
+            benchmark::RegisterBenchmark(name.c_str(), benchmark.second, fixture.get());
+        }
+    }
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    for (const auto& fixture : fixtures)
+        std::remove(fixture->path.c_str());
+
+    return 0;
+}
@@ -0,0 +1,570 @@
+#include "digest.hpp"
+#include "threadpool.hpp"
+
+#include <array>
+#include <cstring>
+#include <algorithm>
+
+#if defined(__AVX2__)
+#   include <immintrin.h>
+#elif defined(__SSE2__)
+#   include <emmintrin.h>
+#endif
+
+// ------------------------------------------------------------------------------------------------
+
+namespace ELF
+{
+    namespace details {
+        static constexpr uint64_t Prime32_1 = 0x9E3779B1U;
+        static constexpr uint64_t Prime32_2 = 0x85EBCA77U;
+        static constexpr uint64_t Prime32_3 = 0xC2B2AE3DU;
+        static constexpr uint64_t Prime64_1 = 0x9E3779B185EBCA87ULL;
+        static constexpr uint64_t Prime64_2 = 0xC2B2AE3D27D4EB4FULL;
+        static constexpr uint64_t Prime64_3 = 0x165667B19E3779F9ULL;
+        static constexpr uint64_t Prime64_4 = 0x85EBCA77C2B2AE63ULL;
+        static constexpr uint64_t Prime64_5 = 0x27D4EB2F165667C5ULL;
+        static constexpr uint64_t PrimeMx1  = 0x165667919E3779F9ULL;
+        static constexpr uint64_t PrimeMx2  = 0x9FB21C651E98DF25ULL;
+
+        static constexpr size_t Lanes          = 8;
+        static constexpr size_t StripeSize     = 64;
+        static constexpr size_t StripesInBlock = 16;
+        static constexpr size_t BlockSize      = StripeSize * StripesInBlock;
+
+        // Stripe n of a block is keyed with words [n, n + 8), the scramble with the last eight.
+        static constexpr size_t SecretWords    = StripesInBlock + Lanes;
+        static constexpr size_t ScrambleWords  = StripesInBlock;
+        static constexpr size_t LastStripeWord = 13;
+        static constexpr size_t MergeWord      = 1;
+
+        static constexpr
+        std::array<uint64_t, SecretWords>
+        make_secret()
+        {
+            // splitmix64, for a key with no structure.
+            std::array<uint64_t, SecretWords> secret {};
+            uint64_t state = 0x5EC2E7D1CE5EEDULL;
+
+            for (size_t i = 0; i < SecretWords; i++)
+            {
+                uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+                secret[i] = z ^ (z >> 31);
+            }
+
+            return secret;
+        }
+
+        alignas(32) static constexpr std::array<uint64_t, SecretWords> Secret = make_secret();
+
+        static inline
+        uint64_t
+        read64(const uint8_t* src)
+        {
+            uint64_t value;
+            std::memcpy(&value, src, sizeof(value));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            value = __builtin_bswap64(value);
+#endif
+            return value;
+        }
+
+        static inline
+        uint32_t
+        read32(const uint8_t* src)
+        {
+            uint32_t value;
+            std::memcpy(&value, src, sizeof(value));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            value = __builtin_bswap32(value);
+#endif
+            return value;
+        }
+
+        static inline
+        uint64_t
+        rotl(uint64_t value, unsigned bits)
+        {
+            return (value << bits) | (value >> (64 - bits));
+        }
+
+        // Folds the 128-bit product of a and b into 64 bits.
+        static inline
+        uint64_t
+        mul_fold(uint64_t a, uint64_t b)
+        {
+#if defined(__SIZEOF_INT128__)
+            unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+            return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+#else
+            uint64_t lo_lo = (a & 0xFFFFFFFFU) * (b & 0xFFFFFFFFU);
+            uint64_t hi_lo = (a >> 32) * (b & 0xFFFFFFFFU);
+            uint64_t lo_hi = (a & 0xFFFFFFFFU) * (b >> 32);
+            uint64_t hi_hi = (a >> 32) * (b >> 32);
+
+            uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFFU) + lo_hi;
+            uint64_t upper = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+            uint64_t lower = (cross << 32) | (lo_lo & 0xFFFFFFFFU);
+            return lower ^ upper;
+#endif
+        }
+
+        static inline
+        uint64_t
+        avalanche(uint64_t h)
+        {
+            h ^= h >> 37;
+            h *= PrimeMx1;
+            return h ^ (h >> 32);
+        }
+
+        static inline
+        uint64_t
+        mix16(const uint8_t* src, size_t word, uint64_t seed)
+        {
+            return mul_fold(read64(src) ^ (Secret[word] + seed), read64(src + 8) ^ (Secret[word + 1] - seed));
+        }
+
+        // ------------------------------------------------------------------------------------------------
+
+        static inline
+        uint64_t
+        hash_short(const uint8_t* src, size_t len, uint64_t seed)
+        {
+            if(len > 8)
+            {
+                uint64_t lo  = read64(src) ^ ((Secret[3] ^ Secret[4]) + seed);
+                uint64_t hi  = read64(src + len - 8) ^ ((Secret[5] ^ Secret[6]) - seed);
+                uint64_t acc = len + __builtin_bswap64(lo) + hi + mul_fold(lo, hi);
+                return avalanche(acc);
+            }
+
+            if(len >= 4)
+            {
+                uint64_t input = read32(src + len - 4) + (uint64_t(read32(src)) << 32);
+                uint64_t h     = input ^ ((Secret[1] ^ Secret[2]) - seed);
+
+                h ^= rotl(h, 49) ^ rotl(h, 24);
+                h *= PrimeMx2;
+                h ^= (h >> 35) + len;
+                h *= PrimeMx2;
+                return h ^ (h >> 28);
+            }
+
+            if(len > 0)
+            {
+                uint32_t combined = (uint32_t(src[0]) << 16) | (uint32_t(src[len >> 1]) << 24) |
+                                     uint32_t(src[len - 1]) | (uint32_t(len) << 8);
+                uint64_t keyed = combined ^ ((uint32_t(Secret[0]) ^ uint32_t(Secret[0] >> 32)) + seed);
+                return avalanche(keyed * Prime64_1);
+            }
+
+            return avalanche(seed ^ Secret[7] ^ Secret[8]);
+        }
+
+        static inline
+        uint64_t
+        hash_medium(const uint8_t* src, size_t len, uint64_t seed)
+        {
+            uint64_t acc = len * Prime64_1;
+
+            // Pairs of 16 bytes from both ends, as many as the length covers.
+            if(len > 96)
+                acc += mix16(src + 48, 12, seed) + mix16(src + len - 64, 14, seed);
+            if(len > 64)
+                acc += mix16(src + 32, 8, seed) + mix16(src + len - 48, 10, seed);
+            if(len > 32)
+                acc += mix16(src + 16, 4, seed) + mix16(src + len - 32, 6, seed);
+
+            acc += mix16(src, 0, seed) + mix16(src + len - 16, 2, seed);
+            return avalanche(acc);
+        }
+
+        // ------------------------------------------------------------------------------------------------
+
+        // Every lane adds the product of the low and high halves of its keyed input and
+        // the raw input of its neighbour, for count stripes keyed from secret word first.
+        static inline
+        void
+        accumulate(uint64_t* acc, const uint8_t* src, size_t count, size_t first)
+        {
+#if defined(__AVX2__)
+            __m256i a0 = _mm256_load_si256(reinterpret_cast<const __m256i*>(acc));
+            __m256i a1 = _mm256_load_si256(reinterpret_cast<const __m256i*>(acc + 4));
+
+            for (size_t n = 0; n < count; n++)
+            {
+                const uint8_t* stripe = src + n * StripeSize;
+                const uint8_t* key    = reinterpret_cast<const uint8_t*>(Secret.data() + first + n);
+
+                __m256i d0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(stripe));
+                __m256i d1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(stripe + 32));
+                __m256i k0 = _mm256_xor_si256(d0, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(key)));
+                __m256i k1 = _mm256_xor_si256(d1, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(key + 32)));
+
+                __m256i p0 = _mm256_mul_epu32(k0, _mm256_shuffle_epi32(k0, _MM_SHUFFLE(0, 3, 0, 1)));
+                __m256i p1 = _mm256_mul_epu32(k1, _mm256_shuffle_epi32(k1, _MM_SHUFFLE(0, 3, 0, 1)));
+
+                a0 = _mm256_add_epi64(a0, _mm256_add_epi64(p0, _mm256_shuffle_epi32(d0, _MM_SHUFFLE(1, 0, 3, 2))));
+                a1 = _mm256_add_epi64(a1, _mm256_add_epi64(p1, _mm256_shuffle_epi32(d1, _MM_SHUFFLE(1, 0, 3, 2))));
+            }
+
+            _mm256_store_si256(reinterpret_cast<__m256i*>(acc), a0);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(acc + 4), a1);
+#elif defined(__SSE2__)
+            __m128i a[4];
+            for (size_t j = 0; j < 4; j++)
+                a[j] = _mm_load_si128(reinterpret_cast<const __m128i*>(acc + 2 * j));
+
+            for (size_t n = 0; n < count; n++)
+            {
+                const uint8_t* stripe = src + n * StripeSize;
+                const uint8_t* key    = reinterpret_cast<const uint8_t*>(Secret.data() + first + n);
+
+                for (size_t j = 0; j < 4; j++)
+                {
+                    __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(stripe + 16 * j));
+                    __m128i k = _mm_xor_si128(d, _mm_loadu_si128(reinterpret_cast<const __m128i*>(key + 16 * j)));
+                    __m128i p = _mm_mul_epu32(k, _mm_shuffle_epi32(k, _MM_SHUFFLE(0, 3, 0, 1)));
+
+                    a[j] = _mm_add_epi64(a[j], _mm_add_epi64(p, _mm_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2))));
+                }
+            }
+
+            for (size_t j = 0; j < 4; j++)
+                _mm_store_si128(reinterpret_cast<__m128i*>(acc + 2 * j), a[j]);
+#else
+            for (size_t n = 0; n < count; n++)
+            {
+                const uint8_t* stripe = src + n * StripeSize;
+
+                for (size_t i = 0; i < Lanes; i++)
+                {
+                    uint64_t value = read64(stripe + 8 * i);
+                    uint64_t keyed = value ^ Secret[first + n + i];
+
+                    acc[i ^ 1] += value;
+                    acc[i]     += (keyed & 0xFFFFFFFFU) * (keyed >> 32);
+                }
+            }
+#endif
+        }
+
+        // Keeps the lanes from saturating between blocks.
+        static inline
+        void
+        scramble(uint64_t* acc)
+        {
+#if defined(__SSE2__)
+            const __m128i prime = _mm_set1_epi32(int(Prime32_1));
+
+            for (size_t j = 0; j < 4; j++)
+            {
+                __m128i a = _mm_load_si128(reinterpret_cast<const __m128i*>(acc + 2 * j));
+                __m128i k = _mm_load_si128(reinterpret_cast<const __m128i*>(Secret.data() + ScrambleWords + 2 * j));
+
+                a = _mm_xor_si128(_mm_xor_si128(a, _mm_srli_epi64(a, 47)), k);
+
+                __m128i lo = _mm_mul_epu32(a, prime);
+                __m128i hi = _mm_mul_epu32(_mm_srli_epi64(a, 32), prime);
+                _mm_store_si128(reinterpret_cast<__m128i*>(acc + 2 * j), _mm_add_epi64(lo, _mm_slli_epi64(hi, 32)));
+            }
+#else
+            for (size_t i = 0; i < Lanes; i++)
+            {
+                uint64_t a = acc[i];
+                a ^= a >> 47;
+                a ^= Secret[ScrambleWords + i];
+                acc[i] = a * Prime32_1;
+            }
+#endif
+        }
+
+        static inline
+        uint64_t
+        hash_long(const uint8_t* src, size_t len, uint64_t seed)
+        {
+            alignas(32) uint64_t acc[Lanes] = {
+                Prime32_3 + seed, Prime64_1 - seed, Prime64_2 + seed, Prime64_3 - seed,
+                Prime64_4 + seed, Prime32_2 - seed, Prime64_5 + seed, Prime32_1 - seed
+            };
+
+            size_t blocks = (len - 1) / BlockSize;
+
+            for (size_t b = 0; b < blocks; b++)
+            {
+                accumulate(acc, src + b * BlockSize, StripesInBlock, 0);
+                scramble(acc);
+            }
+
+            // Whole stripes of the last block, then its last 64 bytes which may overlap them.
+            size_t stripes = ((len - 1) - blocks * BlockSize) / StripeSize;
+            accumulate(acc, src + blocks * BlockSize, stripes, 0);
+            accumulate(acc, src + len - StripeSize, 1, LastStripeWord);
+
+            uint64_t result = len * Prime64_1;
+            for (size_t i = 0; i < Lanes; i += 2)
+                result += mul_fold(acc[i] ^ Secret[MergeWord + i], acc[i + 1] ^ Secret[MergeWord + i + 1]);
+
+            return avalanche(result);
+        }
+    }
+
+    uint64_t
+    hash_bytes(ByteView bytes, uint64_t seed)
+    {
+        if(bytes.size() <= 16)
+            return details::hash_short(bytes.data(), bytes.size(), seed);
+
+        if(bytes.size() <= 128)
+            return details::hash_medium(bytes.data(), bytes.size(), seed);
+
+        return details::hash_long(bytes.data(), bytes.size(), seed);
+    }
+
+    uint64_t
+    hash_chunked(ByteView bytes, ThreadPool* pool)
+    {
+        if(bytes.size() <= HashChunkSize)
+            return hash_bytes(bytes);
+
+        size_t chunks = (bytes.size() + HashChunkSize - 1) / HashChunkSize;
+        std::vector<uint64_t> hashes(chunks);
+
+        auto hash_range = [&bytes, &hashes](size_t first, size_t last) {
+            for (size_t i = first; i < last; i++)
+                hashes[i] = hash_bytes(bytes.subview(i * HashChunkSize, HashChunkSize), i);
+        };
+
+        if(pool != nullptr && pool->size() > 1)
+        {
+            // A few chunks per task, about two tasks per worker.
+            size_t per_task = std::max<size_t>(1, chunks / (2 * pool->size()));
+            ThreadPool::TaskGroup group;
+
+            for (size_t first = 0; first < chunks; first += per_task)
+            {
+                size_t last = std::min(chunks, first + per_task);
+                pool->submit(group, [&hash_range, first, last] { hash_range(first, last); });
+            }
+
+            pool->wait(group);
+        }
+        else
+            hash_range(0, chunks);
+
+        // Little endian whatever the host, so the hash of the hashes is the same everywhere.
+        std::vector<uint8_t> serialized(chunks * 8);
+        for (size_t i = 0; i < chunks; i++)
+        {
+            for (size_t b = 0; b < 8; b++)
+                serialized[i * 8 + b] = static_cast<uint8_t>(hashes[i] >> (8 * b));
+        }
+
+        return hash_bytes(ByteView(serialized.data(), serialized.size()), bytes.size());
+    }
+
+    // ------------------------------------------------------------------------------------------------
+
+    // Accumulates fixed-width fields into a buffer that is hashed once.
+    class LayoutWriter
+    {
+    public:
+        template<typename T>
+        void
+        add(T value)
+        {
+            uint64_t wide = static_cast<uint64_t>(value);
+
+            for (size_t b = 0; b < 8; b++)
+                bytes.push_back(static_cast<uint8_t>(wide >> (8 * b)));
+        }
+
+        uint64_t hash() const { return hash_bytes(ByteView(bytes.data(), bytes.size())); }
+
+    private:
+        std::vector<uint8_t> bytes;
+    };
+
+    FileDigest
+    digest(const Reader& reader, ThreadPool* pool)
+    {
+        FileDigest result;
+        LayoutWriter layout;
+
+        const FileHeader& header = reader.get_file_header();
+        layout.add(header.bits);
+        layout.add(header.endian);
+        layout.add(header.type);
+        layout.add(header.machine);
+
+        for (const ProgramHeader& segment : reader.get_program_headers())
+        {
+            layout.add(segment.type);
+            layout.add(segment.flags);
+            layout.add(segment.filesz);
+            layout.add(segment.memsz);
+            layout.add(segment.align);
+        }
+
+        const auto& sections = reader.get_section_headers();
+        result.sections.reserve(sections.size());
+
+        for (size_t i = 0; i < sections.size(); i++)
+        {
+            const SectionHeader& section = sections[i];
+
+            layout.add(section.name);
+            layout.add(section.type);
+            layout.add(section.flags);
+            layout.add(section.size);
+            layout.add(section.addralign);
+
+            ByteView bytes = reader.get_section_data(section);
+            result.sections.push_back(SectionDigest { uint32_t(i), bytes.size(), hash_chunked(bytes, pool) });
+        }
+
+        result.layout = layout.hash();
+        return result;
+    }
+
+    // ------------------------------------------------------------------------------------------------
+
+    uint32_t
+    DedupIndex::intern(std::string_view name)
+    {
+        auto it = name_ids.find(std::string(name));
+        if(it != name_ids.end())
+            return it->second;
+
+        uint32_t id = static_cast<uint32_t>(names.size());
+        names.emplace_back(name);
+        name_ids.emplace(names.back(), id);
+        return id;
+    }
+
+    uint32_t
+    DedupIndex::add(const std::string& path, const Reader& reader, const FileDigest& digest)
+    {
+        const auto& sections = reader.get_section_headers();
+
+        // Names are resolved before taking the lock, a file without them indexes as unnamed.
+        std::vector<std::string_view> section_names(digest.sections.size());
+        for (size_t i = 0; i < digest.sections.size(); i++)
+        {
+            try
+            {
+                section_names[i] = reader.get_section_name(sections.at(digest.sections[i].index));
+            }
+            catch(const std::exception&)
+            {
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        uint32_t file = static_cast<uint32_t>(paths.size());
+        paths.push_back(path);
+        layouts.push_back(digest.layout);
+
+        for (size_t i = 0; i < digest.sections.size(); i++)
+        {
+            const SectionDigest& section = digest.sections[i];
+
+            // Empty sections are all alike and say nothing about the builds.
+            if(section.size == 0)
+                continue;
+
+            groups[Key { section.hash, section.size }].push_back(Member { file, section.index, intern(section_names[i]) });
+        }
+
+        return file;
+    }
+
+    std::vector<std::vector<DedupIndex::Entry>>
+    DedupIndex::duplicates(std::string_view name) const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<std::vector<Entry>> result;
+
+        uint32_t wanted = UINT32_MAX;
+        if(!name.empty())
+        {
+            auto it = name_ids.find(std::string(name));
+            if(it == name_ids.end())
+                return result;
+
+            wanted = it->second;
+        }
+
+        for (const auto& group : groups)
+        {
+            std::vector<Entry> entries;
+
+            for (const Member& member : group.second)
+            {
+                if(wanted == UINT32_MAX || member.name == wanted)
+                    entries.push_back(Entry { member.file, member.section });
+            }
+
+            if(entries.size() > 1)
+                result.push_back(std::move(entries));
+        }
+
+        return result;
+    }
+
+    std::vector<std::vector<uint32_t>>
+    DedupIndex::same_layout() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        std::unordered_map<uint64_t, std::vector<uint32_t>> by_layout;
+        for (size_t i = 0; i < layouts.size(); i++)
+            by_layout[layouts[i]].push_back(static_cast<uint32_t>(i));
+
+        std::vector<std::vector<uint32_t>> result;
+        for (auto& group : by_layout)
+        {
+            if(group.second.size() > 1)
+                result.push_back(std::move(group.second));
+        }
+
+        return result;
+    }
+
+    // ------------------------------------------------------------------------------------------------
+
+    void
+    index_files(const std::vector<std::string>& paths, DedupIndex& index, const ScanOptions& options)
+    {
+        ThreadPool pool(options.threads);
+        ThreadPool::TaskGroup group;
+
+        for (const std::string& path : paths)
+        {
+            pool.submit(group, [&pool, &index, &path] {
+                if(!Reader::probe(path))
+                    return;
+
+                // Every byte is read once front to back.
+                OpenResult reader = Reader::open(path, AccessHint::Sequential, LoadMode::Lazy);
+                if(!reader)
+                    return;
+
+                try
+                {
+                    index.add(path, reader.value(), digest(reader.value(), &pool));
+                }
+                catch(const std::exception&)
+                {
+                    // Malformed tables leave the file out of the index.
+                }
+            });
+        }
+
+        pool.wait(group);
+    }
+}
@@ -0,0 +1,134 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2021 Eviatar
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef DIGEST_HPP
+#define DIGEST_HPP
+#pragma once
+
+#include "readelf.hpp"
+#include "scanner.hpp"
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <mutex>
+#include <unordered_map>
+
+// ------------------------------------------------------------------------------------------------
+
+namespace ELF
+{
+    class ThreadPool;
+
+    // 64-bit XXH3-style hash: eight 64-bit lanes over 64-byte stripes, vectorized with SSE2 or
+    // AVX2 where available. Not compatible with XXH3 itself, the same on every host.
+    uint64_t hash_bytes(ByteView bytes, uint64_t seed = 0);
+
+    // Hashes ChunkSize pieces separately and then their hashes, so that large inputs can be
+    // spread over a pool. The result doesn't depend on whether or how wide a pool is used.
+    static constexpr size_t HashChunkSize = 1 << 20;
+    uint64_t hash_chunked(ByteView bytes, ThreadPool* pool = nullptr);
+
+    struct SectionDigest
+    {
+        uint32_t index;
+        uint64_t size;
+        uint64_t hash; // of the file contents, NOBITS sections hash as empty.
+    };
+
+    struct FileDigest
+    {
+        std::vector<SectionDigest> sections;
+
+        // Class, machine and type plus the type, flags, size and alignment of every segment and
+        // section. Two builds with the same fingerprint have the same shape, not the same bytes.
+        uint64_t layout;
+    };
+
+    // Hashes every section straight from the mapping. Sections above HashChunkSize are split
+    // over the pool when one is given.
+    FileDigest digest(const Reader& reader, ThreadPool* pool = nullptr);
+
+    // Sections of many files grouped by content, keyed by (hash, size). Adding is thread-safe.
+    class DedupIndex
+    {
+    public:
+        struct Entry
+        {
+            uint32_t file;
+            uint32_t section;
+        };
+
+        // Returns the id of the file, its index in get_paths().
+        uint32_t add(const std::string& path, const Reader& reader, const FileDigest& digest);
+
+        // Groups of two or more identical sections, optionally only those of a given name.
+        std::vector<std::vector<Entry>> duplicates(std::string_view name = {}) const;
+
+        const std::vector<std::string>& get_paths() const { return paths; }
+        const std::vector<uint64_t>&    get_layouts() const { return layouts; }
+
+        // Files sharing a layout fingerprint, groups of two or more.
+        std::vector<std::vector<uint32_t>> same_layout() const;
+
+    private:
+        struct Key
+        {
+            uint64_t hash;
+            uint64_t size;
+
+            inline bool operator==(const Key& other) const { return hash == other.hash && size == other.size; }
+        };
+
+        struct KeyHash
+        {
+            inline size_t operator()(const Key& key) const { return static_cast<size_t>(key.hash ^ (key.size * 0x9E3779B97F4A7C15ULL)); }
+        };
+
+        struct Member
+        {
+            uint32_t file;
+            uint32_t section;
+            uint32_t name; // into names.
+        };
+
+        uint32_t intern(std::string_view name);
+
+    private:
+        mutable std::mutex mutex;
+
+        std::vector<std::string> paths;
+        std::vector<uint64_t>    layouts;
+        std::vector<std::string> names;
+        std::unordered_map<std::string, uint32_t>            name_ids;
+        std::unordered_map<Key, std::vector<Member>, KeyHash> groups;
+    };
+
+    // Opens, digests and indexes every file on a work-stealing pool. Large sections of one
+    // file are hashed by several workers. Files that aren't ELF are skipped.
+    void index_files(const std::vector<std::string>& paths, DedupIndex& index, const ScanOptions& options = {});
+}
+
+#endif // DIGEST_HPP
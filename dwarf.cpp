@@ -0,0 +1,1274 @@
+#include "dwarf.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+
+// ------------------------------------------------------------------------------------------------
+
+namespace ELF
+{
+    namespace details {
+        static constexpr uint64_t NoOffset = UINT64_MAX;
+
+        // Forms and attributes read from the unit DIE and the DWARF 5 line header.
+        enum Form : uint64_t
+        {
+            DW_FORM_addr           = 0x01,
+            DW_FORM_block2         = 0x03,
+            DW_FORM_block4         = 0x04,
+            DW_FORM_data2          = 0x05,
+            DW_FORM_data4          = 0x06,
+            DW_FORM_data8          = 0x07,
+            DW_FORM_string         = 0x08,
+            DW_FORM_block          = 0x09,
+            DW_FORM_block1         = 0x0a,
+            DW_FORM_data1          = 0x0b,
+            DW_FORM_flag           = 0x0c,
+            DW_FORM_sdata          = 0x0d,
+            DW_FORM_strp           = 0x0e,
+            DW_FORM_udata          = 0x0f,
+            DW_FORM_ref_addr       = 0x10,
+            DW_FORM_ref1           = 0x11,
+            DW_FORM_ref2           = 0x12,
+            DW_FORM_ref4           = 0x13,
+            DW_FORM_ref8           = 0x14,
+            DW_FORM_ref_udata      = 0x15,
+            DW_FORM_indirect       = 0x16,
+            DW_FORM_sec_offset     = 0x17,
+            DW_FORM_exprloc        = 0x18,
+            DW_FORM_flag_present   = 0x19,
+            DW_FORM_strx           = 0x1a,
+            DW_FORM_addrx          = 0x1b,
+            DW_FORM_ref_sup4       = 0x1c,
+            DW_FORM_strp_sup       = 0x1d,
+            DW_FORM_data16         = 0x1e,
+            DW_FORM_line_strp      = 0x1f,
+            DW_FORM_ref_sig8       = 0x20,
+            DW_FORM_implicit_const = 0x21,
+            DW_FORM_loclistx       = 0x22,
+            DW_FORM_rnglistx       = 0x23,
+            DW_FORM_ref_sup8       = 0x24,
+            DW_FORM_strx1          = 0x25,
+            DW_FORM_strx2          = 0x26,
+            DW_FORM_strx3          = 0x27,
+            DW_FORM_strx4          = 0x28,
+            DW_FORM_addrx1         = 0x29,
+            DW_FORM_addrx2         = 0x2a,
+            DW_FORM_addrx3         = 0x2b,
+            DW_FORM_addrx4         = 0x2c,
+            DW_FORM_GNU_addr_index = 0x1f01,
+            DW_FORM_GNU_str_index  = 0x1f02,
+            DW_FORM_GNU_ref_alt    = 0x1f20,
+            DW_FORM_GNU_strp_alt   = 0x1f21
+        };
+
+        enum Attribute : uint64_t
+        {
+            DW_AT_stmt_list     = 0x10,
+            DW_AT_low_pc        = 0x11,
+            DW_AT_high_pc       = 0x12,
+            DW_AT_comp_dir      = 0x1b,
+            DW_AT_ranges        = 0x55,
+            DW_AT_addr_base     = 0x73,
+            DW_AT_GNU_addr_base = 0x2133
+        };
+
+        enum UnitType : uint8_t
+        {
+            DW_UT_compile       = 0x01,
+            DW_UT_type          = 0x02,
+            DW_UT_partial       = 0x03,
+            DW_UT_skeleton      = 0x04,
+            DW_UT_split_compile = 0x05,
+            DW_UT_split_type    = 0x06
+        };
+
+        enum LineContent : uint64_t
+        {
+            DW_LNCT_path            = 0x1,
+            DW_LNCT_directory_index = 0x2
+        };
+
+        enum LineOpcode : uint8_t
+        {
+            DW_LNS_extended_op      = 0x00,
+            DW_LNS_copy             = 0x01,
+            DW_LNS_advance_pc       = 0x02,
+            DW_LNS_advance_line     = 0x03,
+            DW_LNS_set_file         = 0x04,
+            DW_LNS_set_column       = 0x05,
+            DW_LNS_negate_stmt      = 0x06,
+            DW_LNS_set_basic_block  = 0x07,
+            DW_LNS_const_add_pc     = 0x08,
+            DW_LNS_fixed_advance_pc = 0x09,
+            DW_LNE_end_sequence     = 0x01,
+            DW_LNE_set_address      = 0x02,
+            DW_LNE_define_file      = 0x03
+        };
+
+        // ------------------------------------------------------------------------------------------------
+
+        // NUL terminated string at an offset of a string section, empty when it isn't inside.
+        static inline
+        std::string_view
+        section_string(ByteView section, uint64_t offset)
+        {
+            if(offset >= section.size())
+                return {};
+
+            const char* begin = reinterpret_cast<const char*>(section.data()) + offset;
+            auto        end   = std::find(section.begin() + offset, section.end(), 0);
+
+            return std::string_view(begin, size_t(end - (section.begin() + offset)));
+        }
+
+        // What a unit's forms need to be decoded.
+        struct FormContext
+        {
+            uint16_t version;
+            uint8_t  offset_size;
+            uint8_t  address_size;
+            ByteView strings;
+            ByteView line_strings;
+        };
+
+        struct FormValue
+        {
+            uint64_t         value = 0;
+            std::string_view string;
+        };
+
+        // Reads one attribute value, strings are resolved unless they go through .debug_str_offsets.
+        // False for a form this reader doesn't know, whose size can't be skipped.
+        static
+        bool
+        read_form(DwarfCursor& cursor, uint64_t form, int64_t implicit, const FormContext& context, FormValue& out)
+        {
+            out = FormValue();
+
+            // The form named by DW_FORM_indirect can't be DW_FORM_indirect again.
+            if(form == DW_FORM_indirect && (form = cursor.uleb()) == DW_FORM_indirect)
+                return false;
+
+            switch(form)
+            {
+            case DW_FORM_addr:           out.value = cursor.unsigned_value(context.address_size); break;
+            case DW_FORM_data1:
+            case DW_FORM_ref1:
+            case DW_FORM_flag:
+            case DW_FORM_strx1:
+            case DW_FORM_addrx1:         out.value = cursor.unsigned_value(1); break;
+            case DW_FORM_data2:
+            case DW_FORM_ref2:
+            case DW_FORM_strx2:
+            case DW_FORM_addrx2:         out.value = cursor.unsigned_value(2); break;
+            case DW_FORM_strx3:
+            case DW_FORM_addrx3:         out.value = cursor.unsigned_value(3); break;
+            case DW_FORM_data4:
+            case DW_FORM_ref4:
+            case DW_FORM_ref_sup4:
+            case DW_FORM_strx4:
+            case DW_FORM_addrx4:         out.value = cursor.unsigned_value(4); break;
+            case DW_FORM_data8:
+            case DW_FORM_ref8:
+            case DW_FORM_ref_sig8:
+            case DW_FORM_ref_sup8:       out.value = cursor.unsigned_value(8); break;
+            case DW_FORM_data16:         cursor.skip(16); break;
+            case DW_FORM_sdata:          out.value = static_cast<uint64_t>(cursor.sleb()); break;
+            case DW_FORM_udata:
+            case DW_FORM_ref_udata:
+            case DW_FORM_strx:
+            case DW_FORM_addrx:
+            case DW_FORM_loclistx:
+            case DW_FORM_rnglistx:
+            case DW_FORM_GNU_addr_index:
+            case DW_FORM_GNU_str_index:  out.value = cursor.uleb(); break;
+            case DW_FORM_string:         out.string = cursor.string(); break;
+            case DW_FORM_strp:           out.string = section_string(context.strings, out.value = cursor.unsigned_value(context.offset_size)); break;
+            case DW_FORM_line_strp:      out.string = section_string(context.line_strings, out.value = cursor.unsigned_value(context.offset_size)); break;
+            case DW_FORM_sec_offset:
+            case DW_FORM_strp_sup:
+            case DW_FORM_GNU_ref_alt:
+            case DW_FORM_GNU_strp_alt:   out.value = cursor.unsigned_value(context.offset_size); break;
+            case DW_FORM_ref_addr:       out.value = cursor.unsigned_value(context.version <= 2 ? context.address_size : context.offset_size); break;
+            case DW_FORM_flag_present:   out.value = 1; break;
+            case DW_FORM_implicit_const: out.value = static_cast<uint64_t>(implicit); break;
+            case DW_FORM_block1:         cursor.skip(cursor.u8()); break;
+            case DW_FORM_block2:         cursor.skip(cursor.u16()); break;
+            case DW_FORM_block4:         cursor.skip(cursor.u32()); break;
+            case DW_FORM_block:
+            case DW_FORM_exprloc:        cursor.skip(cursor.uleb()); break;
+            default:                     return false;
+            }
+
+            return cursor.ok();
+        }
+
+        static inline
+        bool
+        is_constant_form(uint64_t form)
+        {
+            switch(form)
+            {
+            case DW_FORM_data1: case DW_FORM_data2: case DW_FORM_data4: case DW_FORM_data8:
+            case DW_FORM_sdata: case DW_FORM_udata: case DW_FORM_implicit_const:
+                return true;
+            default:
+                return false;
+            }
+        }
+
+        static inline
+        bool
+        is_index_form(uint64_t form)
+        {
+            return form == DW_FORM_addrx || form == DW_FORM_GNU_addr_index || (form >= DW_FORM_addrx1 && form <= DW_FORM_addrx4);
+        }
+
+        // ------------------------------------------------------------------------------------------------
+
+        struct LineFile
+        {
+            std::string_view name;
+            std::string_view directory;
+        };
+
+        // Rows restart here from absolute values, offset is into the row bytes.
+        struct LineBlock
+        {
+            uint64_t address;
+            uint32_t offset;
+        };
+
+        struct LineRange
+        {
+            uint64_t begin;
+            uint64_t end;
+            uint32_t unit;
+        };
+
+        static inline
+        bool
+        range_order(const LineRange& a, const LineRange& b)
+        {
+            return a.begin != b.begin ? a.begin < b.begin : a.unit < b.unit;
+        }
+
+        // Row of the line number matrix, end_sequence ones mark the first address past a sequence.
+        struct LineRow
+        {
+            uint64_t address      = 0;
+            uint32_t file         = 0;
+            uint32_t line         = 0;
+            uint32_t column       = 0;
+            bool     end_sequence = false;
+        };
+
+        // Sorted rows of one unit. Each row is a ULEB of the address delta shifted left twice,
+        // with a file-changed bit and an end-of-sequence bit, then for rows that aren't the end
+        // of a sequence the file index if it changed, the SLEB line delta and the column.
+        struct LineRows
+        {
+            std::vector<LineFile>  files;
+            std::vector<LineBlock> blocks;
+            std::vector<uint8_t>   rows;
+            std::vector<LineRange> sequences;
+
+            size_t
+            memory_usage() const
+            {
+                return sizeof(*this) + files.capacity() * sizeof(LineFile) + blocks.capacity() * sizeof(LineBlock) +
+                       rows.capacity() + sequences.capacity() * sizeof(LineRange);
+            }
+        };
+
+        struct LineUnit
+        {
+            uint64_t         info_offset = NoOffset; // unit in .debug_info, NoOffset when found from .debug_line.
+            uint64_t         line_offset = NoOffset; // its line program, read from the unit DIE on load.
+            uint8_t          address_size = 0;       // 0 when the unit header wasn't read.
+            std::string_view comp_dir;
+            bool             has_ranges = false;
+            bool             loaded     = false;
+
+            std::unique_ptr<const LineRows> rows; // empty until loaded, or for a corrupt program.
+        };
+
+        // What is read from a unit header and its first DIE.
+        struct UnitDie
+        {
+            uint64_t         stmt_list    = NoOffset;
+            uint64_t         low          = 0;
+            uint64_t         high         = 0;
+            uint64_t         addr_base    = NoOffset;
+            uint64_t         next         = NoOffset; // offset of the next unit.
+            uint8_t          address_size = 0;
+            std::string_view comp_dir;
+
+            bool has_low        = false;
+            bool has_high       = false;
+            bool low_is_index   = false;
+            bool high_is_index  = false;
+            bool high_is_offset = false;
+            bool has_ranges     = false;
+        };
+
+        // ------------------------------------------------------------------------------------------------
+
+        static inline
+        void
+        put_uleb(std::vector<uint8_t>& out, uint64_t value)
+        {
+            do
+            {
+                uint8_t byte = value & 0x7F;
+                value >>= 7;
+                out.push_back(value ? byte | 0x80 : byte);
+            }
+            while(value);
+        }
+
+        static inline
+        void
+        put_sleb(std::vector<uint8_t>& out, int64_t value)
+        {
+            for (;;)
+            {
+                uint8_t byte = value & 0x7F;
+                value >>= 7;
+
+                if((value == 0 && !(byte & 0x40)) || (value == -1 && (byte & 0x40)))
+                {
+                    out.push_back(byte);
+                    return;
+                }
+
+                out.push_back(byte | 0x80);
+            }
+        }
+
+        static inline
+        void
+        encode_rows(LineRows& out, const std::vector<LineRow>& rows)
+        {
+            LineRow previous;
+            size_t  in_block = LineTable::RowsPerBlock;
+
+            out.rows.reserve(rows.size() * 3);
+            out.blocks.reserve(rows.size() / LineTable::RowsPerBlock + 1);
+
+            for (const LineRow& row : rows)
+            {
+                uint64_t delta = row.address - previous.address;
+
+                // Deltas too wide for the flag bits start a block of their own.
+                if(in_block == LineTable::RowsPerBlock || delta > (UINT64_MAX >> 2))
+                {
+                    out.blocks.push_back(LineBlock { row.address, static_cast<uint32_t>(out.rows.size()) });
+                    previous = LineRow();
+                    previous.address = row.address;
+                    previous.file    = UINT32_MAX;
+                    in_block = 0;
+                    delta    = 0;
+                }
+
+                bool file_changed = !row.end_sequence && row.file != previous.file;
+                put_uleb(out.rows, delta << 2 | uint64_t(file_changed) << 1 | uint64_t(row.end_sequence));
+
+                if(!row.end_sequence)
+                {
+                    if(file_changed)
+                        put_uleb(out.rows, row.file);
+
+                    put_sleb(out.rows, int64_t(row.line) - int64_t(previous.line));
+                    put_uleb(out.rows, row.column);
+
+                    previous.file = row.file;
+                    previous.line = row.line;
+                }
+
+                previous.address = row.address;
+                in_block++;
+            }
+
+            out.rows.shrink_to_fit();
+            out.blocks.shrink_to_fit();
+        }
+
+        // Decodes the rows of one block in order.
+        struct RowDecoder
+        {
+            const uint8_t* at  = nullptr;
+            const uint8_t* end = nullptr;
+            LineRow        row;
+
+            void
+            start(const LineRows& rows, size_t block)
+            {
+                at  = rows.rows.data() + rows.blocks[block].offset;
+                end = rows.rows.data() + (block + 1 < rows.blocks.size() ? rows.blocks[block + 1].offset : rows.rows.size());
+
+                row = LineRow();
+                row.address = rows.blocks[block].address;
+                row.file    = UINT32_MAX;
+            }
+
+            uint64_t
+            uleb()
+            {
+                uint64_t value = 0;
+                for (unsigned shift = 0; at < end; shift += 7)
+                {
+                    uint8_t byte = *at++;
+                    value |= uint64_t(byte & 0x7F) << shift;
+
+                    if(!(byte & 0x80))
+                        break;
+                }
+
+                return value;
+            }
+
+            int64_t
+            sleb()
+            {
+                uint64_t value = 0;
+                unsigned shift = 0;
+                uint8_t  byte  = 0;
+
+                do
+                {
+                    byte   = *at++;
+                    value |= uint64_t(byte & 0x7F) << shift;
+                    shift += 7;
+                }
+                while((byte & 0x80) && at < end);
+
+                if(shift < 64 && (byte & 0x40))
+                    value |= ~uint64_t(0) << shift;
+
+                return static_cast<int64_t>(value);
+            }
+
+            bool
+            next()
+            {
+                if(at >= end)
+                    return false;
+
+                uint64_t head = uleb();
+                row.address     += head >> 2;
+                row.end_sequence = head & 1;
+
+                if(!row.end_sequence)
+                {
+                    if(head & 2)
+                        row.file = static_cast<uint32_t>(uleb());
+
+                    row.line   = static_cast<uint32_t>(int64_t(row.line) + sleb());
+                    row.column = static_cast<uint32_t>(uleb());
+                }
+
+                return true;
+            }
+        };
+
+        // Lookup position inside a unit, reused by batched lookups so that ascending addresses
+        // in the same block continue decoding where the previous one stopped.
+        struct RowCursor
+        {
+            const LineRows* rows   = nullptr;
+            size_t          block  = 0;
+            uint64_t        target = 0;
+            RowDecoder      decoder;
+            LineRow         current;
+            bool            has_current = false;
+            bool            has_pending = false;
+        };
+
+        static
+        LineInfo
+        find_row(RowCursor& cursor, const LineRows& rows, uint64_t address)
+        {
+            auto it = std::upper_bound(rows.blocks.begin(), rows.blocks.end(), address, [](uint64_t address, const LineBlock& block) {
+                return address < block.address;
+            });
+
+            if(it == rows.blocks.begin())
+                return {};
+
+            size_t block = size_t(it - rows.blocks.begin()) - 1;
+
+            if(cursor.rows != &rows || cursor.block != block || address < cursor.target)
+            {
+                cursor.rows  = &rows;
+                cursor.block = block;
+                cursor.has_current = false;
+                cursor.has_pending = false;
+                cursor.decoder.start(rows, block);
+            }
+
+            cursor.target = address;
+
+            // The decoder holds the first row past the previous target when one is pending.
+            for (;;)
+            {
+                if(!cursor.has_pending)
+                {
+                    if(!cursor.decoder.next())
+                        break;
+
+                    cursor.has_pending = true;
+                }
+
+                if(cursor.decoder.row.address > address)
+                    break;
+
+                cursor.current     = cursor.decoder.row;
+                cursor.has_current = true;
+                cursor.has_pending = false;
+            }
+
+            const LineRow& row = cursor.current;
+            if(!cursor.has_current || row.end_sequence || row.file >= rows.files.size())
+                return {};
+
+            const LineFile& file = rows.files[row.file];
+            return LineInfo { file.name, file.directory, row.line, row.column, row.address };
+        }
+
+        // Section by its name or the GNU .zdebug one, empty when the file has neither.
+        static inline
+        SectionBuffer
+        debug_section(const Reader& reader, std::string_view name, std::string_view zdebug)
+        {
+            const SectionHeader* section = reader.find_section(name);
+            if(section == nullptr)
+                section = reader.find_section(zdebug);
+
+            return section ? reader.get_uncompressed_data(*section) : SectionBuffer();
+        }
+    }
+
+    // ------------------------------------------------------------------------------------------------
+
+    LineTable::LineTable(const Reader& reader)
+        : reader(reader),
+          endian(reader.get_file_header().endian),
+          address_size(reader.get_file_header().bits == uint8_t(FileClass::ELF64) ? 8 : 4)
+    {
+        line_section = details::debug_section(reader, ".debug_line", ".zdebug_line");
+        if(line_section.empty())
+            return;
+
+        line_strings    = details::debug_section(reader, ".debug_line_str", ".zdebug_line_str");
+        strings         = details::debug_section(reader, ".debug_str", ".zdebug_str");
+        info_section    = details::debug_section(reader, ".debug_info", ".zdebug_info");
+        abbrev_section  = details::debug_section(reader, ".debug_abbrev", ".zdebug_abbrev");
+        addr_section    = details::debug_section(reader, ".debug_addr", ".zdebug_addr");
+        aranges_section = details::debug_section(reader, ".debug_aranges", ".zdebug_aranges");
+
+        find_units();
+    }
+
+    LineTable::~LineTable() = default;
+
+    void
+    LineTable::find_units()
+    {
+        if(!aranges_section.empty() && !info_section.empty())
+            find_units_from_aranges();
+
+        if(units.empty() && !info_section.empty())
+            find_units_from_info();
+
+        if(units.empty())
+            find_units_from_lines();
+
+        std::sort(ranges.begin(), ranges.end(), details::range_order);
+    }
+
+    // Relocatable objects start every unit at 0, elsewhere a range there is left by discarded code.
+    static inline
+    bool
+    is_discarded(const Reader& reader, uint64_t address)
+    {
+        return (address == 0 && reader.get_file_header().type != ObjectFileType::REL) || address >= UINT64_MAX - 1;
+    }
+
+    void
+    LineTable::find_units_from_aranges()
+    {
+        using namespace details;
+
+        std::unordered_map<uint64_t, uint32_t> unit_at;
+        DwarfCursor cursor(aranges_section.bytes(), 0, endian);
+
+        while(cursor.remaining())
+        {
+            size_t   start = cursor.offset();
+            uint8_t  offset_size = 4;
+            uint64_t end = cursor.initial_length(offset_size);
+
+            uint16_t version     = cursor.u16();
+            uint64_t info_offset = cursor.unsigned_value(offset_size);
+            uint8_t  width       = cursor.u8();
+            uint8_t  segment     = cursor.u8();
+
+            if(!cursor.ok() || version != 2 || (width != 4 && width != 8) || segment != 0)
+                break;
+
+            auto [it, added] = unit_at.emplace(info_offset, static_cast<uint32_t>(units.size()));
+            if(added)
+            {
+                units.emplace_back();
+                units.back().info_offset  = info_offset;
+                units.back().address_size = width;
+                units.back().has_ranges   = true;
+            }
+
+            // Tuples are aligned to twice the address size from the start of the set.
+            size_t header = cursor.offset() - start;
+            cursor.skip((2 * width - header % (2 * width)) % (2 * width));
+
+            while(cursor.offset() + 2 * width <= end)
+            {
+                uint64_t begin  = cursor.unsigned_value(width);
+                uint64_t length = cursor.unsigned_value(width);
+
+                if(begin == 0 && length == 0)
+                    break;
+
+                if(length != 0 && !is_discarded(reader, begin))
+                    ranges.push_back(LineRange { begin, begin + length, it->second });
+            }
+
+            cursor.seek(end);
+        }
+
+        // Units .debug_aranges leaves out are kept without ranges, their DIE is read on load.
+        for (uint64_t offset = 0; offset < info_section.size();)
+        {
+            DwarfCursor header(info_section.bytes(), size_t(offset), endian);
+            uint8_t     offset_size = 4;
+            uint64_t    end = header.initial_length(offset_size);
+
+            if(!header.ok())
+                break;
+
+            if(unit_at.count(offset) == 0)
+            {
+                units.emplace_back();
+                units.back().info_offset = offset;
+            }
+
+            offset = end;
+        }
+    }
+
+    void
+    LineTable::find_units_from_info()
+    {
+        using namespace details;
+
+        for (uint64_t offset = 0; offset < info_section.size();)
+        {
+            UnitDie die;
+            bool    found = read_unit_die(offset, die);
+
+            if(die.next == NoOffset)
+                break;
+
+            if(found && die.stmt_list != NoOffset)
+            {
+                LineUnit unit;
+                unit.info_offset  = offset;
+                unit.line_offset  = die.stmt_list;
+                unit.address_size = die.address_size;
+                unit.comp_dir     = die.comp_dir;
+
+                uint64_t low  = die.low;
+                uint64_t high = die.high;
+                bool     has_range = die.has_low && die.has_high && !die.has_ranges;
+
+                // Indices go through the unit's slice of .debug_addr.
+                if(has_range && (die.low_is_index || die.high_is_index))
+                {
+                    DwarfCursor addresses(addr_section.bytes(), 0, endian);
+                    has_range = die.addr_base != NoOffset;
+
+                    if(has_range && die.low_is_index)
+                    {
+                        addresses.seek(die.addr_base + low * die.address_size);
+                        low = addresses.unsigned_value(die.address_size);
+                    }
+
+                    if(has_range && die.high_is_index)
+                    {
+                        addresses.seek(die.addr_base + high * die.address_size);
+                        high = addresses.unsigned_value(die.address_size);
+                    }
+
+                    has_range = has_range && addresses.ok();
+                }
+
+                if(die.high_is_offset)
+                    high += low;
+
+                if(has_range && high > low && !is_discarded(reader, low))
+                {
+                    unit.has_ranges = true;
+                    ranges.push_back(LineRange { low, high, static_cast<uint32_t>(units.size()) });
+                }
+
+                units.push_back(std::move(unit));
+            }
+
+            offset = die.next;
+        }
+    }
+
+    void
+    LineTable::find_units_from_lines()
+    {
+        details::DwarfCursor cursor(line_section.bytes(), 0, endian);
+
+        while(cursor.remaining())
+        {
+            uint64_t offset = cursor.offset();
+            uint8_t  offset_size = 4;
+            uint64_t end = cursor.initial_length(offset_size);
+
+            if(!cursor.ok())
+                break;
+
+            units.emplace_back();
+            units.back().line_offset = offset;
+            cursor.seek(end);
+        }
+    }
+
+    // ------------------------------------------------------------------------------------------------
+
+    bool
+    LineTable::read_unit_die(uint64_t offset, details::UnitDie& die) const
+    {
+        using namespace details;
+
+        DwarfCursor cursor(info_section.bytes(), size_t(std::min<uint64_t>(offset, info_section.size())), endian);
+        uint8_t     offset_size = 4;
+        uint64_t    end = cursor.initial_length(offset_size);
+
+        if(!cursor.ok())
+            return false;
+
+        die.next = end;
+
+        uint16_t version = cursor.u16();
+        uint8_t  type    = DW_UT_compile;
+        uint64_t abbrev_offset = 0;
+
+        if(version >= 5)
+        {
+            type             = cursor.u8();
+            die.address_size = cursor.u8();
+            abbrev_offset    = cursor.unsigned_value(offset_size);
+
+            if(type == DW_UT_skeleton || type == DW_UT_split_compile)
+                cursor.skip(8);
+            else if(type == DW_UT_type || type == DW_UT_split_type)
+                return false;
+        }
+        else
+        {
+            abbrev_offset    = cursor.unsigned_value(offset_size);
+            die.address_size = cursor.u8();
+        }
+
+        uint64_t code = cursor.uleb();
+
+        if(!cursor.ok() || version < 2 || version > 5 || (die.address_size != 4 && die.address_size != 8) || code == 0)
+            return false;
+
+        // Finds the abbreviation, usually the first of the unit's table.
+        DwarfCursor abbrev(abbrev_section.bytes(), size_t(std::min<uint64_t>(abbrev_offset, abbrev_section.size())), endian);
+
+        for (;;)
+        {
+            uint64_t entry = abbrev.uleb();
+            if(!abbrev.ok() || entry == 0)
+                return false;
+
+            abbrev.uleb(); // tag
+            abbrev.u8();   // children
+
+            if(entry == code)
+                break;
+
+            for (uint64_t name = 1, form = 1; abbrev.ok() && (name || form);)
+            {
+                name = abbrev.uleb();
+                form = abbrev.uleb();
+
+                if(form == DW_FORM_implicit_const)
+                    abbrev.sleb();
+            }
+        }
+
+        FormContext context { version, offset_size, die.address_size, strings.bytes(), line_strings.bytes() };
+
+        for (;;)
+        {
+            uint64_t name     = abbrev.uleb();
+            uint64_t form     = abbrev.uleb();
+            int64_t  implicit = form == DW_FORM_implicit_const ? abbrev.sleb() : 0;
+
+            if(!abbrev.ok() || (name == 0 && form == 0))
+                break;
+
+            FormValue value;
+            if(!read_form(cursor, form, implicit, context, value))
+                return false;
+
+            switch(name)
+            {
+            case DW_AT_stmt_list:
+                die.stmt_list = value.value;
+                break;
+            case DW_AT_low_pc:
+                die.low          = value.value;
+                die.has_low      = true;
+                die.low_is_index = is_index_form(form);
+                break;
+            case DW_AT_high_pc:
+                die.high           = value.value;
+                die.has_high       = true;
+                die.high_is_index  = is_index_form(form);
+                die.high_is_offset = is_constant_form(form);
+                break;
+            case DW_AT_comp_dir:
+                die.comp_dir = value.string;
+                break;
+            case DW_AT_ranges:
+                die.has_ranges = true;
+                break;
+            case DW_AT_addr_base:
+            case DW_AT_GNU_addr_base:
+                die.addr_base = value.value;
+                break;
+            default:
+                break;
+            }
+        }
+
+        return true;
+    }
+
+    std::unique_ptr<const details::LineRows>
+    LineTable::run_program(uint32_t index) const
+    {
+        using namespace details;
+
+        const LineUnit& unit = units[index];
+        DwarfCursor cursor(line_section.bytes(), size_t(std::min<uint64_t>(unit.line_offset, line_section.size())), endian);
+
+        uint8_t  offset_size = 4;
+        uint64_t end     = cursor.initial_length(offset_size);
+        uint16_t version = cursor.u16();
+        uint8_t  width   = unit.address_size ? unit.address_size : address_size;
+
+        if(version >= 5)
+        {
+            width = cursor.u8();
+            cursor.u8(); // segment selector size
+        }
+
+        uint64_t header_length  = cursor.unsigned_value(offset_size);
+        uint64_t program        = cursor.offset() + header_length;
+        uint8_t  min_length     = cursor.u8();
+        uint8_t  max_ops        = version >= 4 ? cursor.u8() : 1;
+        cursor.u8(); // default_is_stmt, statement boundaries aren't kept
+        int8_t   line_base      = static_cast<int8_t>(cursor.u8());
+        uint8_t  line_range     = cursor.u8();
+        uint8_t  opcode_base    = cursor.u8();
+
+        if(!cursor.ok() || version < 2 || version > 5 || line_range == 0 || opcode_base == 0 || program > end)
+            return nullptr;
+
+        if(max_ops == 0)
+            max_ops = 1;
+
+        std::vector<uint8_t> opcode_lengths(opcode_base, 0);
+        for (size_t i = 1; i < opcode_base; i++)
+            opcode_lengths[i] = cursor.u8();
+
+        auto rows = std::make_unique<LineRows>();
+        std::vector<std::string_view> directories;
+
+        if(version >= 5)
+        {
+            // Entries are described by (content type, form) pairs, paths may live in the string sections.
+            FormContext context { version, offset_size, width, strings.bytes(), line_strings.bytes() };
+
+            auto read_entries = [&](auto&& add) {
+                uint8_t format_count = cursor.u8();
+                std::vector<std::pair<uint64_t, uint64_t>> format(format_count);
+
+                for (auto& [content, form] : format)
+                {
+                    content = cursor.uleb();
+                    form    = cursor.uleb();
+                }
+
+                uint64_t count = cursor.uleb();
+                for (uint64_t i = 0; i < count && cursor.ok(); i++)
+                {
+                    std::string_view path;
+                    uint64_t         directory = 0;
+
+                    for (const auto& [content, form] : format)
+                    {
+                        FormValue value;
+                        if(!read_form(cursor, form, 0, context, value))
+                            return false;
+
+                        if(content == DW_LNCT_path)
+                            path = value.string;
+                        else if(content == DW_LNCT_directory_index)
+                            directory = value.value;
+                    }
+
+                    add(path, directory);
+                }
+
+                return cursor.ok();
+            };
+
+            bool valid = read_entries([&](std::string_view path, uint64_t) {
+                directories.push_back(path);
+            });
+
+            valid = valid && read_entries([&](std::string_view path, uint64_t directory) {
+                rows->files.push_back(LineFile { path, directory < directories.size() ? directories[directory] : std::string_view() });
+            });
+
+            if(!valid)
+                return nullptr;
+        }
+        else
+        {
+            // Directory 0 and file 0 are implicit: the compilation directory and the primary file.
+            directories.push_back(unit.comp_dir);
+
+            for (std::string_view path = cursor.string(); cursor.ok() && !path.empty(); path = cursor.string())
+                directories.push_back(path);
+
+            rows->files.push_back(LineFile {});
+
+            for (std::string_view path = cursor.string(); cursor.ok() && !path.empty(); path = cursor.string())
+            {
+                uint64_t directory = cursor.uleb();
+                cursor.uleb(); // modification time
+                cursor.uleb(); // length
+
+                rows->files.push_back(LineFile { path, directory < directories.size() ? directories[directory] : std::string_view() });
+            }
+
+            if(!cursor.ok())
+                return nullptr;
+        }
+
+        // Runs the state machine, one vector of rows per sequence.
+        std::vector<std::vector<LineRow>> sequences;
+        std::vector<LineRow> sequence;
+
+        LineRow  state;
+        uint32_t op_index = 0;
+
+        auto reset = [&] {
+            state = LineRow();
+            state.file = 1;
+            state.line = 1;
+            op_index   = 0;
+        };
+
+        auto advance = [&](uint64_t operation) {
+            if(max_ops == 1)
+                state.address += min_length * operation;
+            else
+            {
+                state.address += min_length * ((op_index + operation) / max_ops);
+                op_index       = static_cast<uint32_t>((op_index + operation) % max_ops);
+            }
+        };
+
+        reset();
+        cursor.seek(program);
+
+        while(cursor.offset() < end && cursor.ok())
+        {
+            uint8_t opcode = cursor.u8();
+
+            if(opcode >= opcode_base)
+            {
+                uint8_t adjusted = opcode - opcode_base;
+                advance(adjusted / line_range);
+                state.line += line_base + adjusted % line_range;
+                sequence.push_back(state);
+                continue;
+            }
+
+            switch(opcode)
+            {
+            case DW_LNS_extended_op:
+            {
+                uint64_t length = cursor.uleb();
+                size_t   next   = cursor.offset() + size_t(std::min<uint64_t>(length, cursor.remaining()));
+                uint8_t  sub    = length ? cursor.u8() : 0;
+
+                if(sub == DW_LNE_end_sequence)
+                {
+                    state.end_sequence = true;
+                    sequence.push_back(state);
+                    sequences.push_back(std::move(sequence));
+                    sequence.clear();
+                    reset();
+                }
+                else if(sub == DW_LNE_set_address)
+                {
+                    state.address = cursor.unsigned_value(std::min<size_t>(length - 1, 8));
+                    op_index      = 0;
+                }
+                else if(sub == DW_LNE_define_file && version < 5)
+                {
+                    std::string_view path = cursor.string();
+                    uint64_t directory    = cursor.uleb();
+                    rows->files.push_back(LineFile { path, directory < directories.size() ? directories[directory] : std::string_view() });
+                }
+
+                cursor.seek(next);
+                break;
+            }
+            case DW_LNS_copy:
+                sequence.push_back(state);
+                break;
+            case DW_LNS_advance_pc:
+                advance(cursor.uleb());
+                break;
+            case DW_LNS_advance_line:
+                state.line = static_cast<uint32_t>(int64_t(state.line) + cursor.sleb());
+                break;
+            case DW_LNS_set_file:
+                state.file = static_cast<uint32_t>(cursor.uleb());
+                break;
+            case DW_LNS_set_column:
+                state.column = static_cast<uint32_t>(cursor.uleb());
+                break;
+            case DW_LNS_const_add_pc:
+                advance((255 - opcode_base) / line_range);
+                break;
+            case DW_LNS_fixed_advance_pc:
+                state.address += cursor.u16();
+                op_index       = 0;
+                break;
+            case DW_LNS_negate_stmt:
+            case DW_LNS_set_basic_block:
+                break;
+            default:
+                // prologue_end, epilogue_begin, set_isa and unknown ones, skipped by their operand count.
+                for (uint8_t i = 0; i < opcode_lengths[opcode]; i++)
+                    cursor.uleb();
+                break;
+            }
+        }
+
+        // Sequences in address order, overlapping ones and those of discarded code are dropped.
+        sequences.erase(std::remove_if(sequences.begin(), sequences.end(), [this](const std::vector<LineRow>& rows) {
+            return rows.size() < 2 || is_discarded(reader, rows.front().address) || rows.back().address <= rows.front().address;
+        }), sequences.end());
+
+        std::sort(sequences.begin(), sequences.end(), [](const std::vector<LineRow>& a, const std::vector<LineRow>& b) {
+            return a.front().address < b.front().address;
+        });
+
+        std::vector<LineRow> flat;
+        uint64_t covered = 0;
+
+        for (std::vector<LineRow>& rows_of : sequences)
+        {
+            if(!flat.empty() && rows_of.front().address < covered)
+                continue;
+
+            // Addresses only grow inside a sequence, a producer that breaks this gets sorted.
+            if(!std::is_sorted(rows_of.begin(), rows_of.end(), [](const LineRow& a, const LineRow& b) { return a.address < b.address; }))
+                std::stable_sort(rows_of.begin(), rows_of.end() - 1, [](const LineRow& a, const LineRow& b) { return a.address < b.address; });
+
+            rows->sequences.push_back(LineRange { rows_of.front().address, rows_of.back().address, index });
+            covered = rows_of.back().address;
+            flat.insert(flat.end(), rows_of.begin(), rows_of.end());
+        }
+
+        encode_rows(*rows, flat);
+        rows->files.shrink_to_fit();
+        rows->sequences.shrink_to_fit();
+
+        return rows;
+    }
+
+    // ------------------------------------------------------------------------------------------------
+
+    const details::LineRows*
+    LineTable::load(size_t index) const
+    {
+        details::LineUnit& unit = units[index];
+
+        if(!unit.loaded)
+        {
+            unit.loaded = true;
+
+            if(unit.line_offset == details::NoOffset && unit.info_offset != details::NoOffset)
+            {
+                details::UnitDie die;
+                if(read_unit_die(unit.info_offset, die))
+                {
+                    unit.line_offset  = die.stmt_list;
+                    unit.address_size = die.address_size;
+                    unit.comp_dir     = die.comp_dir;
+                }
+            }
+
+            if(unit.line_offset != details::NoOffset)
+                unit.rows = run_program(static_cast<uint32_t>(index));
+        }
+
+        return unit.rows.get();
+    }
+
+    void
+    LineTable::load_unranged() const
+    {
+        unranged_loaded = true;
+        size_t known = ranges.size();
+
+        for (size_t i = 0; i < units.size(); i++)
+        {
+            if(units[i].has_ranges || units[i].loaded)
+                continue;
+
+            if(const details::LineRows* rows = load(i))
+                ranges.insert(ranges.end(), rows->sequences.begin(), rows->sequences.end());
+        }
+
+        if(ranges.size() != known)
+        {
+            std::sort(ranges.begin(), ranges.end(), details::range_order);
+        }
+    }
+
+    const details::LineRange*
+    LineTable::find_range(uint64_t address) const
+    {
+        for (int pass = 0; pass < 2; pass++)
+        {
+            auto it = std::upper_bound(ranges.begin(), ranges.end(), address, [](uint64_t address, const details::LineRange& range) {
+                return address < range.begin;
+            });
+
+            // Units sharing a start, such as two with rows for one COMDAT function, go in unit order.
+            auto first = it;
+            while(first != ranges.begin() && (first - 1)->begin == (it - 1)->begin)
+                --first;
+
+            for (; first != it; ++first)
+            {
+                if(address < first->end)
+                    return &*first;
+            }
+
+            if(unranged_loaded)
+                break;
+
+            load_unranged();
+        }
+
+        return nullptr;
+    }
+
+    LineInfo
+    LineTable::lookup(uint64_t address) const
+    {
+        const details::LineRange* range = has_lines() ? find_range(address) : nullptr;
+        const details::LineRows*  rows  = range ? load(range->unit) : nullptr;
+
+        details::RowCursor cursor;
+        return rows ? details::find_row(cursor, *rows, address) : LineInfo();
+    }
+
+    std::vector<LineInfo>
+    LineTable::lookup(const std::vector<uint64_t>& addresses) const
+    {
+        std::vector<LineInfo> results(addresses.size());
+        if(!has_lines())
+            return results;
+
+        // Visits the addresses in ascending order, through a permutation when they aren't.
+        std::vector<uint32_t> order;
+        bool sorted = std::is_sorted(addresses.begin(), addresses.end());
+
+        if(!sorted)
+        {
+            order.resize(addresses.size());
+            for (size_t i = 0; i < order.size(); i++)
+                order[i] = static_cast<uint32_t>(i);
+
+            std::sort(order.begin(), order.end(), [&addresses](uint32_t a, uint32_t b) {
+                return addresses[a] < addresses[b];
+            });
+        }
+
+        details::RowCursor        cursor;
+        const details::LineRange* range = nullptr;
+
+        for (size_t i = 0; i < addresses.size(); i++)
+        {
+            size_t   slot    = sorted ? i : order[i];
+            uint64_t address = addresses[slot];
+
+            if(range == nullptr || address < range->begin || address >= range->end)
+                range = find_range(address);
+
+            if(const details::LineRows* rows = range ? load(range->unit) : nullptr)
+                results[slot] = details::find_row(cursor, *rows, address);
+        }
+
+        return results;
+    }
+
+    // ------------------------------------------------------------------------------------------------
+
+    size_t
+    LineTable::get_unit_count() const
+    {
+        return units.size();
+    }
+
+    size_t
+    LineTable::get_loaded_unit_count() const
+    {
+        return size_t(std::count_if(units.begin(), units.end(), [](const details::LineUnit& unit) { return unit.loaded; }));
+    }
+
+    size_t
+    LineTable::get_memory_usage() const
+    {
+        size_t bytes = units.capacity() * sizeof(details::LineUnit) + ranges.capacity() * sizeof(details::LineRange);
+
+        for (const details::LineUnit& unit : units)
+        {
+            if(unit.rows)
+                bytes += unit.rows->memory_usage();
+        }
+
+        return bytes;
+    }
+}
@@ -0,0 +1,258 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2021 Eviatar
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef DWARF_HPP
+#define DWARF_HPP
+#pragma once
+
+#include "readelf.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// ------------------------------------------------------------------------------------------------
+
+namespace ELF
+{
+    // Source position of an address, file is empty when no line table row covers it.
+    struct LineInfo
+    {
+        std::string_view file;      // as named by the line table, often relative to directory.
+        std::string_view directory;
+        uint32_t         line    = 0; // 0 for code the compiler attributes to no line.
+        uint32_t         column  = 0;
+        uint64_t         address = 0; // start of the row containing the address.
+    };
+
+    namespace details {
+        // Bounds checked reads in the file's byte order, for .debug_* and .eh_frame alike. Reading
+        // past the end yields zeros and marks the cursor failed, callers check once per entry.
+        class DwarfCursor
+        {
+        public:
+            DwarfCursor(ByteView bytes, size_t offset, Endianness endian)
+                : bytes(bytes), at(offset), big(endian == Endianness::Big), failed(offset > bytes.size()) {}
+
+            inline bool   ok()        const { return !failed; }
+            inline size_t offset()    const { return at; }
+            inline size_t remaining() const { return failed ? 0 : bytes.size() - at; }
+
+            inline void
+            seek(uint64_t offset)
+            {
+                if(offset > bytes.size())
+                    failed = true;
+                else
+                    at = size_t(offset);
+            }
+
+            inline void skip(uint64_t count) { seek(count > remaining() ? UINT64_MAX : at + count); }
+
+            uint64_t
+            unsigned_value(size_t width)
+            {
+                if(width > remaining())
+                {
+                    failed = true;
+                    return 0;
+                }
+
+                uint64_t value = 0;
+                for (size_t i = 0; i < width; i++)
+                    value |= uint64_t(bytes[at + i]) << (8 * (big ? width - 1 - i : i));
+
+                at += width;
+                return value;
+            }
+
+            inline uint8_t  u8()  { return static_cast<uint8_t>(unsigned_value(1)); }
+            inline uint16_t u16() { return static_cast<uint16_t>(unsigned_value(2)); }
+            inline uint32_t u32() { return static_cast<uint32_t>(unsigned_value(4)); }
+
+            uint64_t
+            uleb()
+            {
+                uint64_t value = 0;
+                for (unsigned shift = 0; at < bytes.size(); shift += 7)
+                {
+                    uint8_t byte = bytes[at++];
+                    if(shift < 64)
+                        value |= uint64_t(byte & 0x7F) << shift;
+
+                    if(!(byte & 0x80))
+                        return value;
+                }
+
+                failed = true;
+                return 0;
+            }
+
+            int64_t
+            sleb()
+            {
+                uint64_t value = 0;
+                unsigned shift = 0;
+
+                while(at < bytes.size())
+                {
+                    uint8_t byte = bytes[at++];
+                    if(shift < 64)
+                        value |= uint64_t(byte & 0x7F) << shift;
+                    shift += 7;
+
+                    if(!(byte & 0x80))
+                    {
+                        if(shift < 64 && (byte & 0x40))
+                            value |= ~uint64_t(0) << shift;
+
+                        return static_cast<int64_t>(value);
+                    }
+                }
+
+                failed = true;
+                return 0;
+            }
+
+            std::string_view
+            string()
+            {
+                const char* begin = reinterpret_cast<const char*>(bytes.data()) + at;
+                size_t      end   = std::find(bytes.begin() + at, bytes.end(), 0) - bytes.begin();
+
+                if(failed || end == bytes.size())
+                {
+                    failed = true;
+                    return {};
+                }
+
+                std::string_view text(begin, end - at);
+                at = end + 1;
+                return text;
+            }
+
+            // Unit length, 4 bytes or 0xffffffff and 8 for 64-bit DWARF. Returns the offset of the
+            // unit's end and sets the width of section offsets in it.
+            uint64_t
+            initial_length(uint8_t& offset_size)
+            {
+                uint64_t length = u32();
+                offset_size     = 4;
+
+                if(length == 0xFFFFFFFFU)
+                {
+                    length      = unsigned_value(8);
+                    offset_size = 8;
+                }
+                else if(length >= 0xFFFFFFF0U)
+                    failed = true;
+
+                if(length > remaining())
+                    failed = true;
+
+                return failed ? bytes.size() : at + length;
+            }
+
+        private:
+            ByteView bytes;
+            size_t   at;
+            bool     big;
+            bool     failed;
+        };
+
+        struct LineUnit;
+        struct LineRange;
+        struct LineRows;
+        struct UnitDie;
+    }
+
+    // Address to file:line lookups over .debug_line, DWARF 2 to 5. Units are found through
+    // .debug_aranges, or the CU ranges of .debug_info when it is absent, and the line program
+    // of a unit only runs on the first lookup inside it. Its rows are kept sorted and delta
+    // coded in blocks, a few bytes each, so memory follows the units actually looked up.
+    // Units without known ranges are all run on the first lookup no range covers. Relocatable
+    // objects are read as stored, without applying the relocations of their debug sections.
+    //
+    // Like the Reader, lookups fill caches and need the caller's own synchronization.
+    class LineTable
+    {
+    public:
+        // Rows restart from absolute values every RowsPerBlock rows.
+        static constexpr size_t RowsPerBlock = 16;
+
+        // Finds the debug sections, compressed ones are inflated through the reader, which has
+        // to outlive the table. Throws std::runtime_error when they can't be decompressed.
+        explicit LineTable(const Reader& reader);
+        ~LineTable();
+
+        LineTable(const LineTable&) = delete;
+        LineTable& operator=(const LineTable&) = delete;
+
+        // False for a file without .debug_line.
+        inline bool has_lines() const { return !line_section.empty(); }
+
+        LineInfo lookup(uint64_t address) const;
+        // Looks up many addresses in one pass, sorted ones decode each block of rows once.
+        std::vector<LineInfo> lookup(const std::vector<uint64_t>& addresses) const;
+
+        size_t get_unit_count() const;
+        size_t get_loaded_unit_count() const;
+        // Bytes held by the rows and file tables of the loaded units.
+        size_t get_memory_usage() const;
+
+    private:
+        void find_units();
+        void find_units_from_aranges();
+        void find_units_from_info();
+        void find_units_from_lines();
+        void load_unranged() const;
+
+        // Reads the unit header and first DIE at an offset of .debug_info.
+        bool read_unit_die(uint64_t offset, details::UnitDie& die) const;
+        std::unique_ptr<const details::LineRows> run_program(uint32_t unit) const;
+
+        const details::LineRows* load(size_t unit) const;
+        const details::LineRange* find_range(uint64_t address) const;
+
+    private:
+        const Reader& reader;
+        Endianness    endian;
+        uint8_t       address_size;
+
+        SectionBuffer line_section;
+        SectionBuffer line_strings;
+        SectionBuffer strings;
+        SectionBuffer info_section;
+        SectionBuffer abbrev_section;
+        SectionBuffer addr_section;
+        SectionBuffer aranges_section;
+
+        // Units and the address ranges pointing at them, sorted by start address.
+        mutable std::vector<details::LineUnit>  units;
+        mutable std::vector<details::LineRange> ranges;
+        mutable bool unranged_loaded = false;
+    };
+}
+
+#endif // DWARF_HPP
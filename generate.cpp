@@ -0,0 +1,159 @@
+#include "generator.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+// Writes a synthetic ELF file for benchmarks and fuzzing.
+//
+//   readelf-generate [options] <output>
+//     --class=32|64              file class, 64 by default
+//     --endian=little|big        byte order, little by default
+//     --type=rel|exec|dyn|core   object type, dyn by default
+//     --machine=N                e_machine, x86-64 by default
+//     --segments=N               program headers, PN_XNUM from 65535
+//     --sections=N               sections, SHN_XINDEX from 65280
+//     --symbols=N                functions in .text and .symtab
+//     --relocations=N            entries of .rela.text
+//     --filler-size=N[K|M|G]     bytes of every filler section
+
+static bool parse_size(const char* text, uint64_t& value)
+{
+    char* end = nullptr;
+    errno = 0;
+    value = std::strtoull(text, &end, 0);
+
+    if(end == text || errno == ERANGE || *text == '-')
+        return false;
+
+    unsigned shift = 0;
+    switch(*end)
+    {
+    case 'K': case 'k': shift = 10; end++; break;
+    case 'M': case 'm': shift = 20; end++; break;
+    case 'G': case 'g': shift = 30; end++; break;
+    default: break;
+    }
+
+    // A suffix that would shift bits out gives a wrapped, much smaller size.
+    if(value > (UINT64_MAX >> shift))
+        return false;
+
+    value <<= shift;
+    return *end == '\0';
+}
+
+static bool parse_type(const std::string& name, ELF::ObjectFileType& type)
+{
+    if(name == "rel")       type = ELF::ObjectFileType::REL;
+    else if(name == "exec") type = ELF::ObjectFileType::EXEC;
+    else if(name == "dyn")  type = ELF::ObjectFileType::DYN;
+    else if(name == "core") type = ELF::ObjectFileType::CORE;
+    else                    return false;
+
+    return true;
+}
+
+static int usage()
+{
+    std::cerr << "usage: readelf-generate [--class=32|64] [--endian=little|big] [--type=rel|exec|dyn|core]\n"
+                 "                        [--machine=N] [--segments=N] [--sections=N] [--symbols=N]\n"
+                 "                        [--relocations=N] [--filler-size=N[K|M|G]] <output>" << std::endl;
+    return 2;
+}
+
+int main(int argc, char** argv)
+{
+    ELF::GeneratorOptions options;
+    std::string output;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        size_t      eq  = arg.find('=');
+
+        // Anything else starting with "--", such as --help, is not taken as the output.
+        if(arg.compare(0, 2, "--") == 0 && eq == std::string::npos)
+        {
+            std::cerr << "Invalid option: " << arg << std::endl;
+            return usage();
+        }
+
+        if(arg.compare(0, 2, "--") != 0)
+        {
+            if(!output.empty())
+                return usage();
+
+            output = arg;
+            continue;
+        }
+
+        std::string flag  = arg.substr(0, eq);
+        std::string value = arg.substr(eq + 1);
+        uint64_t    number = 0;
+        bool        valid  = true;
+
+        if(flag == "--class")
+        {
+            valid = value == "32" || value == "64";
+            options.file_class = value == "32" ? ELF::FileClass::ELF32 : ELF::FileClass::ELF64;
+        }
+        else if(flag == "--endian")
+        {
+            valid = value == "little" || value == "big";
+            options.endian = value == "big" ? ELF::Endianness::Big : ELF::Endianness::Little;
+        }
+        else if(flag == "--type")
+            valid = parse_type(value, options.type);
+        else if(!parse_size(value.c_str(), number))
+            valid = false;
+        else if(flag == "--machine")
+            options.machine = static_cast<ELF::InstructionSetArchitectureType>(number);
+        else if(flag == "--segments")
+            options.program_headers = number;
+        else if(flag == "--sections")
+            options.sections = number;
+        else if(flag == "--symbols")
+            options.symbols = number;
+        else if(flag == "--relocations")
+            options.relocations = number;
+        else if(flag == "--filler-size")
+            options.filler_size = number;
+        else
+            valid = false;
+
+        if(!valid)
+        {
+            std::cerr << "Invalid option: " << arg << std::endl;
+            return usage();
+        }
+    }
+
+    if(output.empty())
+        return usage();
+
+    try
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        if(!ELF::write_elf(output, options))
+        {
+            std::cerr << output << ": " << std::strerror(errno) << std::endl;
+            return 1;
+        }
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cerr << "Wrote " << ELF::generated_size(options) << " bytes in " << elapsed.count() << " s." << std::endl;
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << output << ": " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,498 @@
+#include "generator.hpp"
+
+#include <string>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+
+#if defined(__unix__) || defined(__APPLE__)
+#   define READELF_HAS_MMAP 1
+#   include <fcntl.h>
+#   include <unistd.h>
+#   include <sys/mman.h>
+#endif
+
+// ------------------------------------------------------------------------------------------------
+
+namespace ELF
+{
+    namespace details {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        static constexpr Endianness HostEndian = Endianness::Big;
+#else
+        static constexpr Endianness HostEndian = Endianness::Little;
+#endif
+
+        static constexpr uint64_t PageAlignment = 0x1000;
+        static constexpr uint32_t LoReserve     = static_cast<uint32_t>(SectionIndex::LORESERVE);
+        static constexpr uint32_t XIndex        = static_cast<uint32_t>(SectionIndex::XINDEX);
+
+        // Section names in .shstrtab order, the filler names follow them.
+        static constexpr const char FixedNames[] = "\0.symtab\0.strtab\0.rela.text\0.symtab_shndx\0.text\0.shstrtab";
+        static constexpr uint32_t SymtabName   = 1;
+        static constexpr uint32_t StrtabName   = 9;
+        static constexpr uint32_t RelaName     = 17;
+        static constexpr uint32_t ShndxName    = 28;
+        static constexpr uint32_t TextName     = 42;
+        static constexpr uint32_t ShstrtabName = 48;
+
+        static constexpr const char FunctionPrefix[] = "function_";
+        static constexpr const char FillerPrefix[]   = ".fill.";
+
+        // Layout arithmetic throws rather than wraps, a wrapped size would be written past.
+        static inline
+        uint64_t
+        checked_add(uint64_t a, uint64_t b)
+        {
+            if(b > UINT64_MAX - a)
+                throw std::out_of_range("Generated file does not fit the 64-bit offsets.");
+
+            return a + b;
+        }
+
+        static inline
+        uint64_t
+        checked_multiply(uint64_t a, uint64_t b)
+        {
+            if(a != 0 && b > UINT64_MAX / a)
+                throw std::out_of_range("Generated file does not fit the 64-bit offsets.");
+
+            return a * b;
+        }
+
+        static inline
+        uint64_t
+        align_up(uint64_t value, uint64_t alignment)
+        {
+            return checked_add(value, alignment - 1) & ~(alignment - 1);
+        }
+
+        static inline
+        size_t
+        decimal_length(uint64_t value)
+        {
+            size_t length = 1;
+            for (; value >= 10; value /= 10)
+                length++;
+
+            return length;
+        }
+
+        // Total decimal_length() of [0, count), a digit count at a time.
+        static inline
+        uint64_t
+        decimal_lengths(uint64_t count)
+        {
+            uint64_t total = 0;
+            uint64_t first = 0;
+            uint64_t next  = 10;
+
+            for (uint64_t length = 1; first < count; length++)
+            {
+                uint64_t last = std::min(count, next);
+                total = checked_add(total, checked_multiply(last - first, length));
+                first = last;
+                next  = (next > UINT64_MAX / 10) ? UINT64_MAX : next * 10;
+            }
+
+            return total;
+        }
+
+        // Offsets and sizes of everything in the file, all computed before a byte is written.
+        struct GeneratedLayout
+        {
+            bool   elf64;
+            size_t ehsize;
+            size_t phentsize;
+            size_t shentsize;
+            size_t symsize;
+            size_t relasize;
+
+            size_t   phnum;
+            size_t   shnum;
+            bool     extended;    // .text is past SHN_LORESERVE, .symtab_shndx is needed.
+            uint32_t first_filler;
+            uint32_t text_index;
+            uint32_t shstrtab_index;
+
+            uint64_t phoff;
+            uint64_t text;
+            uint64_t text_size;
+            uint64_t strtab;
+            uint64_t strtab_size;
+            uint64_t shstrtab;
+            uint64_t shstrtab_size;
+            uint64_t symtab;
+            uint64_t shndx;
+            uint64_t rela;
+            uint64_t fillers;
+            uint64_t shoff;
+            uint64_t size;
+        };
+
+        static inline
+        GeneratedLayout
+        plan_layout(const GeneratorOptions& options)
+        {
+            GeneratedLayout layout {};
+            layout.elf64     = options.file_class == FileClass::ELF64;
+            layout.ehsize    = layout.elf64 ? sizeof(Elf64::FileHeader)    : sizeof(Elf32::FileHeader);
+            layout.phentsize = layout.elf64 ? sizeof(Elf64::ProgramHeader) : sizeof(Elf32::ProgramHeader);
+            layout.shentsize = layout.elf64 ? sizeof(Elf64::SectionHeader) : sizeof(Elf32::SectionHeader);
+            layout.symsize   = layout.elf64 ? sizeof(Elf64::Symbol)        : sizeof(Elf32::Symbol);
+            layout.relasize  = layout.elf64 ? sizeof(Elf64::Rela)          : sizeof(Elf32::Rela);
+
+            layout.phnum    = std::max<size_t>(options.program_headers, 1);
+            layout.shnum    = std::max<size_t>(options.sections, 6);
+            layout.extended = layout.shnum - 2 >= LoReserve;
+
+            // Counts past PN_XNUM and SHN_XINDEX are kept in 32-bit fields of section 0.
+            if(layout.phnum > UINT32_MAX || layout.shnum > UINT32_MAX)
+                throw std::out_of_range("Header counts do not fit 32 bits.");
+
+            layout.first_filler   = layout.extended ? 5 : 4;
+            layout.text_index     = static_cast<uint32_t>(layout.shnum - 2);
+            layout.shstrtab_index = static_cast<uint32_t>(layout.shnum - 1);
+
+            uint64_t symbols = checked_add(options.symbols, 1);
+            uint64_t fillers = layout.text_index - layout.first_filler;
+
+            layout.text_size     = checked_multiply(options.symbols, options.function_size);
+            layout.strtab_size   = checked_add(1 + decimal_lengths(options.symbols), checked_multiply(options.symbols, sizeof(FunctionPrefix)));
+            layout.shstrtab_size = sizeof(FixedNames) + fillers * sizeof(FillerPrefix) +
+                                   decimal_lengths(layout.text_index) - decimal_lengths(layout.first_filler);
+
+            // Names are found through 32-bit offsets into either table.
+            if(layout.strtab_size > UINT32_MAX || layout.shstrtab_size > UINT32_MAX)
+                throw std::out_of_range("Names do not fit the 32-bit string table offsets.");
+
+            uint64_t at = layout.ehsize;
+
+            layout.phoff = at = align_up(at, 8);
+            at = checked_add(at, layout.phnum * layout.phentsize);
+
+            // .text starts a page, so that the PT_LOAD over it is congruent with its address.
+            layout.text = at = align_up(at, PageAlignment);
+            at = checked_add(at, layout.text_size);
+
+            layout.strtab = at;
+            at = checked_add(at, layout.strtab_size);
+
+            layout.shstrtab = at;
+            at = checked_add(at, layout.shstrtab_size);
+
+            layout.symtab = at = align_up(at, 8);
+            at = checked_add(at, checked_multiply(symbols, layout.symsize));
+
+            layout.shndx = at;
+            if(layout.extended)
+                at = checked_add(at, checked_multiply(symbols, sizeof(uint32_t)));
+
+            layout.rela = at = align_up(at, 8);
+            at = checked_add(at, checked_multiply(options.relocations, layout.relasize));
+
+            layout.fillers = at;
+            at = checked_add(at, checked_multiply(fillers, align_up(options.filler_size, 8)));
+
+            layout.shoff = at = align_up(at, 8);
+            at = checked_add(at, layout.shnum * layout.shentsize);
+
+            layout.size = at;
+
+            uint64_t text_end = checked_add(options.text_address, layout.text_size);
+
+            if(!layout.elf64 && (layout.size > UINT32_MAX || text_end > UINT32_MAX))
+                throw std::out_of_range("Generated file does not fit the 32-bit offsets.");
+
+            return layout;
+        }
+
+        // ------------------------------------------------------------------------------------------------
+
+        template<typename T>
+        static inline
+        T
+        byte_swap(T value)
+        {
+            T swapped = 0;
+
+            for (size_t i = 0; i < sizeof(T); i++, value >>= 8)
+                swapped = static_cast<T>((swapped << 8) | (value & 0xFFU));
+
+            return swapped;
+        }
+
+        // Writes consecutive fields in the file's class and byte order.
+        class FieldWriter
+        {
+        public:
+            FieldWriter(uint8_t* at, const GeneratorOptions& options)
+                : at(at), swap(options.endian != HostEndian), elf64(options.file_class == FileClass::ELF64) {}
+
+            inline void u8(uint64_t value)   { *at++ = static_cast<uint8_t>(value); }
+            inline void u16(uint64_t value)  { put(static_cast<uint16_t>(value)); }
+            inline void u32(uint64_t value)  { put(static_cast<uint32_t>(value)); }
+            inline void u64(uint64_t value)  { put(value); }
+            inline void word(uint64_t value) { elf64 ? u64(value) : u32(value); }
+
+            inline void bytes(const void* src, size_t size) { std::memcpy(at, src, size); at += size; }
+            inline void seek(uint8_t* target) { at = target; }
+
+        private:
+            template<typename T>
+            inline void
+            put(T value)
+            {
+                if(swap)
+                    value = byte_swap(value);
+
+                std::memcpy(at, &value, sizeof(T));
+                at += sizeof(T);
+            }
+
+            uint8_t*   at;
+            const bool swap;
+            const bool elf64;
+        };
+
+        static inline
+        void
+        write_section(FieldWriter& out, uint32_t name, SectionType type, uint64_t flags, uint64_t addr, uint64_t offset,
+                      uint64_t size, uint32_t link, uint32_t info, uint64_t addralign, uint64_t entsize)
+        {
+            out.u32(name);
+            out.u32(static_cast<uint32_t>(type));
+            out.word(flags);
+            out.word(addr);
+            out.word(offset);
+            out.word(size);
+            out.u32(link);
+            out.u32(info);
+            out.word(addralign);
+            out.word(entsize);
+        }
+
+        static inline
+        void
+        write_segment(FieldWriter& out, bool elf64, SegmentType type, uint32_t flags, uint64_t offset,
+                      uint64_t address, uint64_t size, uint64_t align)
+        {
+            out.u32(static_cast<uint32_t>(type));
+
+            if(elf64)
+                out.u32(flags);
+
+            out.word(offset);
+            out.word(address);
+            out.word(address);
+            out.word(size);
+            out.word(size);
+
+            if(!elf64)
+                out.u32(flags);
+
+            out.word(align);
+        }
+    }
+
+    // ------------------------------------------------------------------------------------------------
+
+    uint64_t
+    generated_size(const GeneratorOptions& options)
+    {
+        return details::plan_layout(options).size;
+    }
+
+    void
+    generate_elf(const GeneratorOptions& options, uint8_t* out)
+    {
+        using namespace details;
+
+        const GeneratedLayout layout = plan_layout(options);
+        const bool elf64 = layout.elf64;
+
+        FieldWriter w(out, options);
+
+        // File header, the counts that don't fit go into section 0.
+        bool many_sections = layout.shnum >= LoReserve;
+        bool many_segments = layout.phnum >= ExtendedPhnum;
+        bool far_names     = layout.shstrtab_index >= LoReserve;
+
+        w.bytes("\x7F" "ELF", 4);
+        w.u8(static_cast<uint8_t>(options.file_class));
+        w.u8(static_cast<uint8_t>(options.endian));
+        w.u8(1);
+        w.seek(out + IdentSize);
+
+        w.u16(static_cast<uint16_t>(options.type));
+        w.u16(static_cast<uint16_t>(options.machine));
+        w.u32(1);
+        w.word(options.text_address);
+        w.word(layout.phoff);
+        w.word(layout.shoff);
+        w.u32(0);
+        w.u16(layout.ehsize);
+        w.u16(layout.phentsize);
+        w.u16(many_segments ? ExtendedPhnum : layout.phnum);
+        w.u16(layout.shentsize);
+        w.u16(many_sections ? 0 : layout.shnum);
+        w.u16(far_names ? XIndex : layout.shstrtab_index);
+
+        // Program headers, PT_NULL entries are all zeros already.
+        w.seek(out + layout.phoff);
+        write_segment(w, elf64, SegmentType::LOAD, 0x5, layout.text, options.text_address, layout.text_size, PageAlignment);
+
+        // String tables, written name by name without building them in memory first.
+        char digits[24];
+        auto append_name = [&w, &digits](const char* prefix, size_t prefix_size, uint64_t number) {
+            size_t length = 0;
+            for (uint64_t rest = number; length == 0 || rest != 0; rest /= 10)
+                digits[sizeof(digits) - 1 - length++] = static_cast<char>('0' + rest % 10);
+
+            w.bytes(prefix, prefix_size);
+            w.bytes(digits + sizeof(digits) - length, length);
+            w.u8(0);
+        };
+
+        w.seek(out + layout.strtab + 1);
+        for (size_t i = 0; i < options.symbols; i++)
+            append_name(FunctionPrefix, sizeof(FunctionPrefix) - 1, i);
+
+        w.seek(out + layout.shstrtab);
+        w.bytes(FixedNames, sizeof(FixedNames));
+        for (size_t i = layout.first_filler; i < layout.text_index; i++)
+            append_name(FillerPrefix, sizeof(FillerPrefix) - 1, i);
+
+        // .symtab: the null symbol, then one global function per name.
+        uint32_t text_shndx = layout.extended ? XIndex : layout.text_index;
+        uint32_t name       = 1;
+
+        w.seek(out + layout.symtab + layout.symsize);
+        for (size_t i = 0; i < options.symbols; i++)
+        {
+            uint64_t value = options.text_address + i * options.function_size;
+            uint8_t  info  = (static_cast<uint8_t>(SymbolBinding::GLOBAL) << 4) | static_cast<uint8_t>(SymbolType::FUNC);
+
+            if(elf64)
+            {
+                w.u32(name); w.u8(info); w.u8(0); w.u16(text_shndx); w.u64(value); w.u64(options.function_size);
+            }
+            else
+            {
+                w.u32(name); w.u32(value); w.u32(options.function_size); w.u8(info); w.u8(0); w.u16(text_shndx);
+            }
+
+            name += static_cast<uint32_t>(sizeof(FunctionPrefix) + decimal_length(i));
+        }
+
+        // .symtab_shndx: the real index of every symbol whose st_shndx is SHN_XINDEX.
+        if(layout.extended)
+        {
+            w.seek(out + layout.shndx + sizeof(uint32_t));
+            for (size_t i = 0; i < options.symbols; i++)
+                w.u32(layout.text_index);
+        }
+
+        // .rela.text: absolute relocations over the functions, cycling through the symbols.
+        w.seek(out + layout.rela);
+        for (size_t i = 0; i < options.relocations; i++)
+        {
+            uint64_t function = options.symbols ? i % options.symbols : 0;
+            uint64_t symbol   = options.symbols ? function + 1 : 0;
+
+            w.word(options.text_address + function * options.function_size);
+            w.word(elf64 ? (symbol << 32) | 1 : (symbol << 8) | 1);
+            w.word(0);
+        }
+
+        // Section headers.
+        w.seek(out + layout.shoff);
+
+        write_section(w, 0, SectionType::NONE, 0, 0, 0,
+                      many_sections ? layout.shnum : 0, far_names ? layout.shstrtab_index : 0,
+                      many_segments ? static_cast<uint32_t>(layout.phnum) : 0, 0, 0);
+
+        uint64_t symtab_size = (options.symbols + 1) * layout.symsize;
+        write_section(w, SymtabName, SectionType::SYMTAB, 0, 0, layout.symtab, symtab_size, 2, 1, 8, layout.symsize);
+        write_section(w, StrtabName, SectionType::STRTAB, 0, 0, layout.strtab, layout.strtab_size, 0, 0, 1, 0);
+
+        write_section(w, RelaName, SectionType::RELA, static_cast<uint64_t>(SectionAttribute::INFO_LINK), 0, layout.rela,
+                      options.relocations * layout.relasize, 1, layout.text_index, 8, layout.relasize);
+
+        if(layout.extended)
+            write_section(w, ShndxName, SectionType::SYMTAB_SHNDX, 0, 0, layout.shndx,
+                          (options.symbols + 1) * sizeof(uint32_t), 1, 0, 4, sizeof(uint32_t));
+
+        uint32_t filler_name = ShstrtabName + static_cast<uint32_t>(sizeof(".shstrtab"));
+        uint64_t filler_size = align_up(options.filler_size, 8);
+
+        for (size_t i = layout.first_filler; i < layout.text_index; i++)
+        {
+            uint64_t offset = layout.fillers + (i - layout.first_filler) * filler_size;
+            write_section(w, filler_name, SectionType::PROGBITS, 0, 0, offset, options.filler_size, 0, 0, 8, 0);
+            filler_name += static_cast<uint32_t>(sizeof(FillerPrefix) + decimal_length(i));
+        }
+
+        write_section(w, TextName, SectionType::PROGBITS,
+                      static_cast<uint64_t>(SectionAttribute::ALLOC) | static_cast<uint64_t>(SectionAttribute::EXECINSTR),
+                      options.text_address, layout.text, layout.text_size, 0, 0, 16, 0);
+        write_section(w, ShstrtabName, SectionType::STRTAB, 0, 0, layout.shstrtab, layout.shstrtab_size, 0, 0, 1, 0);
+    }
+
+    std::vector<uint8_t>
+    generate_elf(const GeneratorOptions& options)
+    {
+        std::vector<uint8_t> bytes(generated_size(options), 0);
+        generate_elf(options, bytes.data());
+        return bytes;
+    }
+
+    bool
+    write_elf(const std::string& path, const GeneratorOptions& options)
+    {
+        uint64_t size = generated_size(options);
+
+#if defined(READELF_HAS_MMAP)
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if(fd < 0)
+            return false;
+
+        bool written = ::ftruncate(fd, off_t(size)) == 0;
+
+#if defined(__linux__)
+        // Reserve the blocks now, a full disk then fails here rather than with SIGBUS mid-write.
+        // Filesystems without fallocate() keep the sparse file.
+        if(written)
+        {
+            int error = ::posix_fallocate(fd, 0, off_t(size));
+            written = error == 0 || error == EOPNOTSUPP || error == EINVAL;
+        }
+#endif
+
+        void* base = written ? ::mmap(nullptr, size_t(size), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+
+        if(base != MAP_FAILED)
+        {
+            // Fresh pages read as zeros, only the headers and tables are touched.
+            generate_elf(options, static_cast<uint8_t*>(base));
+            ::munmap(base, size_t(size));
+        }
+
+        written = written && base != MAP_FAILED;
+        ::close(fd);
+
+        if(!written)
+            ::unlink(path.c_str());
+
+        return written;
+#else
+        std::vector<uint8_t> bytes = generate_elf(options);
+
+        std::ofstream ofs(path, std::ios::binary | std::ios::out | std::ios::trunc);
+        ofs.write(reinterpret_cast<const char*>(bytes.data()), std::streamsize(bytes.size()));
+        return bool(ofs);
+#endif
+    }
+}
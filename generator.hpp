@@ -0,0 +1,75 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2021 Eviatar
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef GENERATOR_HPP
+#define GENERATOR_HPP
+#pragma once
+
+#include "readelf.hpp"
+
+#include <string>
+#include <vector>
+
+// ------------------------------------------------------------------------------------------------
+
+namespace ELF
+{
+    // Shape of a synthetic file. The sections are the null section, .symtab, .strtab,
+    // .rela.text, .symtab_shndx when it's needed, filler sections up to the requested count,
+    // .text with one function per symbol and .shstrtab last, so that a table of 0xFF00 sections
+    // or more exercises SHN_XINDEX in both the file header and the symbols. The first program
+    // header is a PT_LOAD over .text, the others are PT_NULL.
+    struct GeneratorOptions
+    {
+        FileClass                      file_class = FileClass::ELF64;
+        Endianness                     endian     = Endianness::Little;
+        ObjectFileType                 type       = ObjectFileType::DYN;
+        InstructionSetArchitectureType machine    = InstructionSetArchitectureType::AMD_X86_64;
+
+        size_t program_headers = 1;   // at least 1, PN_XNUM from 0xFFFF.
+        size_t sections        = 6;   // at least 6, or 7 with .symtab_shndx.
+        size_t symbols         = 1000;
+        size_t relocations     = 1000; // RELA entries against .text, spread over the symbols.
+
+        uint64_t function_size = 16;
+        uint64_t filler_size   = 0;   // bytes of every filler section, to grow the file.
+        uint64_t text_address  = 0x400000;
+    };
+
+    // Exact size of the generated file. Throws std::out_of_range when the layout overflows
+    // 64 bits, or an ELF32 file would need offsets above 4 GiB.
+    uint64_t generated_size(const GeneratorOptions& options);
+
+    // Writes the file into generated_size() bytes at out. Only headers and tables are written,
+    // out has to be zero-filled already, as calloc() memory or a fresh file mapping is.
+    void generate_elf(const GeneratorOptions& options, uint8_t* out);
+    std::vector<uint8_t> generate_elf(const GeneratorOptions& options);
+
+    // Allocates the whole file up front and writes it through a shared mapping, so the filler
+    // sections cost nothing but the allocation. Returns false when the file can't be written.
+    bool write_elf(const std::string& path, const GeneratorOptions& options);
+}
+
+#endif // GENERATOR_HPP
@@ -1,561 +1,788 @@
 #include "readelf.hpp"
-#include <iostream>
+#include "names.hpp"
+#include "scanner.hpp"
+#include "resolver.hpp"
 
-int main()
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+
+#include <unistd.h>
+
+// readelf [--format=text|json|ndjson] <file>...
+// readelf --scan <directory | file | @list>...
+// readelf --deps <file>...
+
+// ------------------------------------------------------------------------------------------------
+
+// Buffered output to a file descriptor. Fields are formatted straight into the buffer, which
+// goes out in large write() calls; nothing is flushed per line.
+class Writer
 {
-    ELF::Reader reader("test");
-    auto header = reader.get_file_header();
-
-    std::cout << std::hex;
-
-    // ELF magic header.
-    auto magic = header.magic;
-    std::cout << "Magic: " << " 0x" <<
-        static_cast<int>(magic[0]) << " 0x" << 
-        static_cast<int>(magic[1]) << " 0x" << 
-        static_cast<int>(magic[2]) << " 0x" << 
-        static_cast<int>(magic[3]) << std::endl;
-
-
-    // 32 or 64 bit format
-    int8_t format_bits = header.bits;
-    std::cout << "Class: " << (format_bits == 32 ? "ELF32" : "ELF64") << std::endl;
-
-    // Little or Big endian
-    auto endian = header.endian;
-    std::cout << "Endianness: " << (endian == ELF::Endianness::Little ? "Little" : "Big") << std::endl;
-
-    // OS ABI
-    auto abi = header.osabi;
-    std::cout << "ABI: ";
-
-    switch(abi) {
-    case ELF::ABIType::AIX:
-        std::cout << "AIX";
-        break;
-    
-    case ELF::ABIType::AROS:
-        std::cout << "AROS";
-        break;
-    
-    case ELF::ABIType::CloudABI:
-        std::cout << "CloudABI";
-        break;
-
-    case ELF::ABIType::FenixOS:
-        std::cout << "FenixOS";
-        break;
-
-    case ELF::ABIType::FreeBSD:
-        std::cout << "FreeBSD";
-        break;
-
-    case ELF::ABIType::GNU_Hurd:
-        std::cout << "GNU Hurd";
-        break;
-
-    case ELF::ABIType::HP_UX:
-        std::cout << "HP UX";
-        break;
-
-    case ELF::ABIType::IRIX:
-        std::cout << "IRIX";
-        break;
-
-    case ELF::ABIType::Linux:
-        std::cout << "Linux";
-        break;
-
-    case ELF::ABIType::NetBSD:
-        std::cout << "NetBSD";
-        break;
-
-    case ELF::ABIType::NonStop_Kernel:
-        std::cout << "NonStop Kernel";
-        break;
-
-    case ELF::ABIType::Novell_Modesto:
-        std::cout << "Novell Modesto";
-        break;
-
-    case ELF::ABIType::OpenBSD:
-        std::cout << "OpenBSD";
-        break;
-
-    case ELF::ABIType::OpenVMS:
-        std::cout << "OpenVMS";
-        break;
-
-    case ELF::ABIType::Solaris:
-        std::cout << "Solaris";
-        break;
-
-    case ELF::ABIType::Stratus_Technologies_OpenVOS:
-        std::cout << "Stratus Technologies OpenVOS";
-        break;
-    
-    case ELF::ABIType::SystemV:
-        std::cout << "SystemV";
-        break;
-
-    case ELF::ABIType::Tru64:
-        std::cout << "Tru64";
-        break;
+public:
+    static constexpr size_t Capacity = size_t(1) << 16;
+
+    explicit Writer(int fd) : fd(fd), buffer(new char[Capacity]) {}
+    ~Writer() { flush(); }
+
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+
+    // False once a write failed, such as when the reading end of a pipe went away.
+    inline bool good() const { return !failed; }
+
+    Writer&
+    operator<<(std::string_view text)
+    {
+        if(text.size() > Capacity - size)
+        {
+            flush();
+
+            if(text.size() >= Capacity)
+            {
+                write_all(text.data(), text.size());
+                return *this;
+            }
+        }
+
+        std::memcpy(buffer.get() + size, text.data(), text.size());
+        size += text.size();
+        return *this;
     }
-    
-    std::cout << std::endl;
 
-    // Object File Type
-    auto obj_type = header.type;
-    std::cout << "Object File Type: ";
+    Writer&
+    operator<<(char c)
+    {
+        if(size == Capacity)
+            flush();
 
-    switch (obj_type)
+        buffer[size++] = c;
+        return *this;
+    }
+
+    // Right-aligned in a column of the given width.
+    Writer&
+    dec(uint64_t value, size_t width = 0)
     {
-    case ELF::ObjectFileType::CORE:
-        std::cout << "CORE";
-        break;
-
-    case ELF::ObjectFileType::DYN:
-        std::cout << "DYN";
-        break;
-
-    case ELF::ObjectFileType::EXEC:
-        std::cout << "EXEC";
-        break;
-
-    case ELF::ObjectFileType::HIOS:
-        std::cout << "HIOS";
-        break;
-
-    case ELF::ObjectFileType::HIPROC:
-        std::cout << "HIPROC";
-        break;
-
-    case ELF::ObjectFileType::LOOS:
-        std::cout << "LOOS";
-        break;
-
-    case ELF::ObjectFileType::LOPROC:
-        std::cout << "LOPROC";
-        break;
-
-    case ELF::ObjectFileType::NONE:
-        std::cout << "NONE";
-        break;
-    
-    case ELF::ObjectFileType::REL:
-        std::cout << "REL";
-        break;
+        char   digits[20];
+        size_t count = std::to_chars(digits, digits + sizeof(digits), value).ptr - digits;
+
+        reserve(std::max(width, count));
+        for (; width > count; width--)
+            buffer[size++] = ' ';
+
+        std::memcpy(buffer.get() + size, digits, count);
+        size += count;
+        return *this;
     }
-    std::cout << std::endl;
 
-    // ISA
-    auto isa = header.machine;
-    std::cout << "Instruction Set: ";
-    switch(isa)
+    // Lowercase digits without a prefix, zero-padded to width.
+    Writer&
+    hex(uint64_t value, size_t width = 0)
     {
-    case ELF::InstructionSetArchitectureType::Advanced_Logic_TinyJ_Embedded_Processor_Family:
-        std::cout << "Advanced Logic TinyJ Embedded Processor Family";
-        break;
-    
-    case ELF::InstructionSetArchitectureType::AMD_X86_64:
-        std::cout << "AMD X86_64";
-        break;
-
-    case ELF::InstructionSetArchitectureType::Argonaut_RISC_Core:
-        std::cout << "Argonaut RISC Core";
-        break;
-
-    case ELF::InstructionSetArchitectureType::ARM_64bit:
-    case ELF::InstructionSetArchitectureType::ARM:
-        std::cout << "ARM";
-        break;
-
-    case ELF::InstructionSetArchitectureType::AT_And_T_WE_32100:
-        std::cout << "AT&T WE 32100";
-        break;
-
-    case ELF::InstructionSetArchitectureType::Berkeley_Packet_Filter:
-        std::cout << "Berkeley Packet Filter";
-        break;
-
-    case ELF::InstructionSetArchitectureType::Denso_NDR1_Microprocessor:
-        std::cout << "Denso NDR1 Microprocessor";
-        break;
-
-    case ELF::InstructionSetArchitectureType::Digital_Alpha:
-        std::cout << "Digital Alpha";
-        break;
-
-    case ELF::InstructionSetArchitectureType::Fujitsu_FR20:
-        std::cout << "Fujitsu FR20";
-        break;
-
-    case ELF::InstructionSetArchitectureType::Fujitsu_MMA_Multimedia_Accelerator:
-        std::cout << "Fujitsu MMA Multimedia Accelerator";
-        break;
-
-    case ELF::InstructionSetArchitectureType::Hewlett_Packard_PA_RISC:
-        std::cout << "Hewlett Packard PA RISC";
-        break;
-
-    case ELF::InstructionSetArchitectureType::Hitachi_H8_300:
-        std::cout << "Hitachi H8 300";
-        break;
-
-    case ELF::InstructionSetArchitectureType::Hitachi_H8_300H:
-        std::cout << "Hitachi H8 300H";
-        break;
-
-    case ELF::InstructionSetArchitectureType::Hitachi_H8_500:
-        std::cout << "Hitachi H8 500";
-        break;
-
-    case ELF::InstructionSetArchitectureType::Hitachi_H8S:
-        std::cout << "Hitachi H8S";
-        break;
-
-    case ELF::InstructionSetArchitectureType::IA_64:
-        std::cout << "IA 64";
-        break;
-    
-    case ELF::InstructionSetArchitectureType::IBM_SPU_SPC:
-        std::cout << "IBM SPU/SPC";
-        break;
-
-    case ELF::InstructionSetArchitectureType::IBM_System:
-        std::cout << "IBM System";
-        break;
-
-    case ELF::InstructionSetArchitectureType::Intel_80860:
-        std::cout << "Intel 80860";
-        break;
-
-    case ELF::InstructionSetArchitectureType::Intel_80960:
-        std::cout << "Intel 80960";
-        break;
-
-    case ELF::InstructionSetArchitectureType::Intel_MCU:
-        std::cout << "Intel MCU";
-        break;
-
-    case ELF::InstructionSetArchitectureType::M68k:
-        std::cout << "M68k";
-        break;
-
-    case ELF::InstructionSetArchitectureType::M88k:
-        std::cout << "M88k";
-        break;
-
-    case ELF::InstructionSetArchitectureType::MCST_Elbrus_e2k:
-        std::cout << "MCST Elbrus e2k";
-        break;
-
-    case ELF::InstructionSetArchitectureType::MIPS:
-        std::cout << "MIPS";
-        break;
-
-    case ELF::InstructionSetArchitectureType::MIPS_RS3000_Little_Endian:
-        std::cout << "MIPS RS3000";
-        break;
-
-    case ELF::InstructionSetArchitectureType::Motorola_ColdFire:
-        std::cout << "Motorola ColdFire";
-        break;
-
-    case ELF::InstructionSetArchitectureType::Motorola_M68HC12:
-        std::cout << "Motorola M68HC12";
-        break;
-
-    case ELF::InstructionSetArchitectureType::Motorola_RCE:
-        std::cout << "Motorola RCE";
-        break;
-
-    case ELF::InstructionSetArchitectureType::Motorola_StarCore_Processor:
-        std::cout << "Motorola StarCore Processor";
-        break;
-
-    case ELF::InstructionSetArchitectureType::NEC_V800:
-        std::cout << "NEC V800";
-        break;
-
-    case ELF::InstructionSetArchitectureType::No_Specific:
-        std::cout << "No Specific";
-        break;
-
-    case ELF::InstructionSetArchitectureType::PowerPC_64bit:
-    case ELF::InstructionSetArchitectureType::PowerPC:
-        std::cout << "PowerPC";
-        break;
-
-    case ELF::InstructionSetArchitectureType::RISC_V:
-        std::cout << "RISC V";
-        break;
-
-    case ELF::InstructionSetArchitectureType::S390:
-        std::cout << "S390";
-        break;
-
-    case ELF::InstructionSetArchitectureType::Siemens_PCP:
-        std::cout << "Siemens PCP";
-        break;
-
-    case ELF::InstructionSetArchitectureType::Siemens_TriCore_Embedded_Processor:
-        std::cout << "Siemens TriCore Embedded Processor";
-        break;
-
-    case ELF::InstructionSetArchitectureType::Sony_nCPU_Embedded_RISC_Processor:
-        std::cout << "Sony nCPU Embedded RISC Processor";
-        break;
-
-    case ELF::InstructionSetArchitectureType::SPARC_Ver9:
-    case ELF::InstructionSetArchitectureType::SPARC:
-        std::cout << "SPARC";
-        break;
-
-    case ELF::InstructionSetArchitectureType::Stanford_MIPS_X:
-        std::cout << "Stanford MIPS X";
-        break;
-
-    case ELF::InstructionSetArchitectureType::STMicroelectronics_ST100_Processor:
-        std::cout << "STMicroelectronics ST100 Processor";
-        break;
-
-    case ELF::InstructionSetArchitectureType::SuperH:
-        std::cout << "SuperH";
-        break;
-
-    case ELF::InstructionSetArchitectureType::TMS320C6000_Family:
-        std::cout << "TMS320C6000 Family";
-        break;
-
-    case ELF::InstructionSetArchitectureType::Toyota_ME16_Processor:
-        std::cout << "Toyota ME16 Processor";
-        break;
-
-    case ELF::InstructionSetArchitectureType::TRW_RH32:
-        std::cout << "TRW RH32";
-        break;
-
-    case ELF::InstructionSetArchitectureType::WDC_65C816:
-        std::cout << "WDC 65C816";
-        break;
-
-    case ELF::InstructionSetArchitectureType::X86:
-        std::cout << "X86";
-        break;
+        char   digits[16];
+        size_t count = 0;
+
+        do
+        {
+            digits[15 - count++] = "0123456789abcdef"[value & 0xF];
+            value >>= 4;
+        }
+        while(value);
+
+        reserve(std::max(width, count));
+        for (; width > count; width--)
+            buffer[size++] = '0';
+
+        std::memcpy(buffer.get() + size, digits + 16 - count, count);
+        size += count;
+        return *this;
     }
-    std::cout << std::endl;
 
-    // Entry Point
-    uint64_t entry = header.entry;
-    std::cout << "Entry Point: 0x" << entry << std::endl;
+    // Left-aligned in a column of the given width, longer text isn't cut.
+    Writer&
+    pad(std::string_view text, size_t width)
+    {
+        *this << text;
+        for (size_t i = text.size(); i < width; i++)
+            *this << ' ';
 
-    // Start of program header
-    uint64_t phoff = header.phoff;
-    std::cout << "Start of Program Header: " << std::dec << phoff << std::endl;
+        return *this;
+    }
 
-    // Start of section header
-    uint64_t shoff = header.shoff;
-    std::cout << "Start of Section Header: " << std::dec << shoff << std::endl;
+    // Quoted JSON string, control characters and bytes of invalid UTF-8 are escaped.
+    Writer&
+    json(std::string_view text)
+    {
+        *this << '"';
+
+        size_t plain = 0;
+        for (size_t i = 0; i < text.size(); i++)
+        {
+            unsigned char c = static_cast<unsigned char>(text[i]);
+            if(c >= 0x20 && c != '"' && c != '\\' && c < 0x80)
+                continue;
+
+            size_t length = c >= 0x80 ? utf8_length(text, i) : 0;
+            if(length != 0)
+            {
+                i += length - 1;
+                continue;
+            }
+
+            *this << text.substr(plain, i - plain);
+            plain = i + 1;
+
+            switch(c)
+            {
+            case '"':  *this << "\\\""; break;
+            case '\\': *this << "\\\\"; break;
+            case '\n': *this << "\\n";  break;
+            case '\r': *this << "\\r";  break;
+            case '\t': *this << "\\t";  break;
+            default:   *this << "\\u00"; hex(c, 2); break;
+            }
+        }
+
+        *this << text.substr(plain) << '"';
+        return *this;
+    }
+
+    bool
+    flush()
+    {
+        if(size != 0)
+            write_all(buffer.get(), size);
+
+        size = 0;
+        return !failed;
+    }
+
+private:
+    inline void
+    reserve(size_t count)
+    {
+        if(Capacity - size < count)
+            flush();
+    }
 
-    // Flags
-    uint32_t flags = header.flags;
-    std::cout << "Flags: 0x" << std::hex << flags << std::endl;
+    void
+    write_all(const char* data, size_t length)
+    {
+        while(length != 0 && !failed)
+        {
+            ssize_t written = ::write(fd, data, length);
+            if(written < 0)
+            {
+                failed = errno != EINTR;
+                continue;
+            }
+
+            data   += written;
+            length -= size_t(written);
+        }
+    }
 
-    // Header Size
-    uint16_t ehsize = header.ehsize;
-    std::cout << "Header Size: " << std::dec << ehsize << std::endl;
+    // Bytes of the well-formed UTF-8 sequence at i, 0 when it isn't one.
+    static size_t
+    utf8_length(std::string_view text, size_t i)
+    {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        size_t length = c >= 0xF0 && c <= 0xF4 ? 4 : c >= 0xE0 ? 3 : c >= 0xC2 && c < 0xE0 ? 2 : 0;
 
-    // Program Header Size
-    uint16_t phentsize = header.phentsize;
-    std::cout << "Program Header Table Entry Size: " << phentsize << std::endl;
+        if(length == 0 || text.size() - i < length)
+            return 0;
 
-    // Number of program entries
-    uint16_t phnum = header.phnum;
-    std::cout << "Number of Program Entries: " << phnum << std::endl;
+        for (size_t k = 1; k < length; k++)
+        {
+            if((static_cast<unsigned char>(text[i + k]) & 0xC0) != 0x80)
+                return 0;
+        }
 
-    // Section header table entry size
-    uint16_t shentsize = header.shentsize;
-    std::cout << "Section Header Table Entry Size: " << shentsize << std::endl;
+        return length;
+    }
 
-    // Number of section entries
-    uint16_t shnum = header.shnum;
-    std::cout << "Number of Section Entries: " << shnum << std::endl;
+private:
+    int                     fd;
+    std::unique_ptr<char[]> buffer;
+    size_t                  size   = 0;
+    bool                    failed = false;
+};
 
-    // Index of the section header table entry
-    uint16_t shstrndx = header.shstrndx;
-    std::cout << "Index of the Section Header Table Entry: " << shstrndx << std::endl;
+// Members of one JSON object, the caller writes the braces.
+class JsonFields
+{
+public:
+    explicit JsonFields(Writer& out) : out(out) {}
 
-    auto program_headers = reader.get_program_headers();
-    for (size_t i = 0; i < program_headers.size(); i++)
+    JsonFields&
+    number(std::string_view name, uint64_t value)
     {
-        auto& header = program_headers[i];
+        key(name).dec(value);
+        return *this;
+    }
+
+    JsonFields&
+    string(std::string_view name, std::string_view value)
+    {
+        key(name).json(value);
+        return *this;
+    }
+
+    // Name of an enumerator, its value in hex when it has none.
+    JsonFields&
+    enumerator(std::string_view name, std::string_view text, uint64_t value)
+    {
+        if(!text.empty())
+            return string(name, text);
+
+        key(name) << "\"0x";
+        out.hex(value) << '"';
+        return *this;
+    }
+
+private:
+    Writer&
+    key(std::string_view name)
+    {
+        out << (first ? "\"" : ",\"") << name << "\":";
+        first = false;
+        return out;
+    }
 
-        std::cout << std::endl;
+private:
+    Writer& out;
+    bool    first = true;
+};
 
-        std::cout << "Program Header Number: " << std::dec << i << std::endl;
-        
-        std::cout << "Type: ";
-        switch(header.type)
+enum class Format
+{
+    Text,
+    Json,
+    Ndjson
+};
+
+// Everything a dump reads that can throw, loaded before any of it is written so a malformed
+// file leaves nothing half-written in the output. Names that can't be read get binutils'
+// placeholders instead of rejecting the whole file.
+struct Headers
+{
+    explicit Headers(const ELF::Reader& reader)
+        : segments(reader.get_program_headers()), sections(reader.get_section_headers())
+    {
+        // SHN_UNDEF, or any index past the table, means the file has no section names.
+        size_t shstrndx = reader.get_section_name_index();
+        bool   strings  = shstrndx != 0 && shstrndx < sections.size();
+
+        names.reserve(sections.size());
+        for (const ELF::SectionHeader& section : sections)
+            names.push_back(strings ? name_of(reader, section) : "<no-strings>");
+    }
+
+    static std::string_view
+    name_of(const ELF::Reader& reader, const ELF::SectionHeader& section)
+    {
+        try
         {
-        case ELF::SegmentType::LOAD:
-            std::cout << "LOAD";
-            break;
+            return reader.get_section_name(section);
+        }
+        catch(const std::exception&)
+        {
+            return "<corrupt>";
+        }
+    }
 
-        case ELF::SegmentType::DYNAMIC:
-            std::cout << "DYNAMIC";
-            break;
+    const std::vector<ELF::ProgramHeader>& segments;
+    const std::vector<ELF::SectionHeader>& sections;
+    std::vector<std::string_view>          names;
+};
 
-        case ELF::SegmentType::INTERP:
-            std::cout << "INTERP";
-            break;
+// ------------------------------------------------------------------------------------------------
 
-        case ELF::SegmentType::SHLIB:
-            std::cout << "SHLIB";
-            break;
+template<typename E>
+static inline uint64_t raw(E value) { return static_cast<uint64_t>(value); }
 
-        case ELF::SegmentType::NOTE:
-            std::cout << "NOTE";
-            break;
+// Name of an enumerator for the text output, 0x-prefixed hex when it has none.
+template<typename E>
+static Writer& name(Writer& out, E value, size_t width = 0)
+{
+    std::string_view text = ELF::to_string(value);
+    if(!text.empty())
+        return out.pad(text, width);
 
-        case ELF::SegmentType::PHDR:
-            std::cout << "PHDR";
-            break;
+    char digits[20] = "0x";
+    size_t length = std::to_chars(digits + 2, digits + sizeof(digits), raw(value), 16).ptr - digits;
+    return out.pad(std::string_view(digits, length), width);
+}
 
-        case ELF::SegmentType::TLS:
-            std::cout << "TLS";
-            break;
+template<typename E, size_t N>
+static std::string_view letters(const ELF::details::FlagLetter<E> (&table)[N], uint64_t flags, char (&out)[N])
+{
+    return std::string_view(out, ELF::flag_letters(table, flags, out));
+}
 
-        case ELF::SegmentType::LOOS:
-            std::cout << "LOOS";
-            break;
+static void header_fields(JsonFields& fields, const ELF::Reader& reader)
+{
+    const ELF::FileHeader& header = reader.get_file_header();
+
+    fields.enumerator("class", ELF::to_string(static_cast<ELF::FileClass>(header.bits)), header.bits)
+          .enumerator("endian", ELF::to_string(header.endian), raw(header.endian))
+          .enumerator("osabi", ELF::to_string(header.osabi), raw(header.osabi))
+          .number("abi_version", header.abiver)
+          .enumerator("type", ELF::to_string(header.type), raw(header.type))
+          .enumerator("machine", ELF::to_string(header.machine), raw(header.machine))
+          .number("machine_id", raw(header.machine))
+          .number("version", header.version2)
+          .number("entry", header.entry)
+          .number("phoff", header.phoff)
+          .number("shoff", header.shoff)
+          .number("flags", header.flags)
+          .number("ehsize", header.ehsize)
+          .number("phentsize", header.phentsize)
+          .number("phnum", reader.get_program_header_count())
+          .number("shentsize", header.shentsize)
+          .number("shnum", reader.get_section_header_count())
+          .number("shstrndx", reader.get_section_name_index());
+}
 
-        case ELF::SegmentType::HIOS:
-            std::cout << "HIOS";
-            break;
+static void segment_fields(JsonFields& fields, const ELF::ProgramHeader& segment, size_t index)
+{
+    char flags[std::size(ELF::SegmentFlagLetters)];
+
+    fields.number("index", index)
+          .enumerator("type", ELF::to_string(segment.type), raw(segment.type))
+          .string("flags", letters(ELF::SegmentFlagLetters, segment.flags, flags))
+          .number("offset", segment.offset)
+          .number("vaddr", segment.vaddr)
+          .number("paddr", segment.paddr)
+          .number("filesz", segment.filesz)
+          .number("memsz", segment.memsz)
+          .number("align", segment.align);
+}
 
-        case ELF::SegmentType::LOPROC:
-            std::cout << "LOPROC";
-            break;
+static void section_fields(JsonFields& fields, const Headers& headers, size_t index)
+{
+    const ELF::SectionHeader& section = headers.sections[index];
+    char flags[std::size(ELF::SectionFlagLetters)];
+
+    fields.number("index", index)
+          .string("name", headers.names[index])
+          .enumerator("type", ELF::to_string(section.type), raw(section.type))
+          .string("flags", letters(ELF::SectionFlagLetters, raw(section.flags), flags))
+          .number("addr", section.addr)
+          .number("offset", section.offset)
+          .number("size", section.size)
+          .number("link", section.link)
+          .number("info", section.info)
+          .number("addralign", section.addralign)
+          .number("entsize", section.entsize);
+}
 
-        case ELF::SegmentType::HIPROC:
-            std::cout << "HIPROC";
-            break;
+// ------------------------------------------------------------------------------------------------
 
-        case ELF::SegmentType::NONE:
-        default:
-            std::cout << "NULL";
-            break;
+// Same layout as binutils readelf -hlSW.
+static void dump_text(Writer& out, const ELF::Reader& reader, const Headers& headers)
+{
+    const ELF::FileHeader& header = reader.get_file_header();
+    const bool elf64 = header.bits == static_cast<uint8_t>(ELF::FileClass::ELF64);
+    const size_t address_width = elf64 ? 16 : 8;
+    const size_t size_width    = elf64 ? 6 : 5;
+
+    out << "ELF Header:\n  Magic:  ";
+    for (uint8_t byte : header.magic)
+        out.hex(byte, 2) << ' ';
+
+    out << "\n  Class:                             ";
+    name(out, static_cast<ELF::FileClass>(header.bits));
+    out << "\n  Data:                              ";
+    name(out, header.endian) << " endian";
+    out << "\n  OS/ABI:                            ";
+    name(out, header.osabi);
+    out << "\n  ABI Version:                       ";
+    out.dec(header.abiver);
+    out << "\n  Type:                              ";
+    name(out, header.type);
+    out << "\n  Machine:                           ";
+    name(out, header.machine);
+    out << "\n  Version:                           0x";
+    out.hex(header.version2);
+    out << "\n  Entry point address:               0x";
+    out.hex(header.entry);
+    out << "\n  Start of program headers:          ";
+    out.dec(header.phoff) << " (bytes into file)";
+    out << "\n  Start of section headers:          ";
+    out.dec(header.shoff) << " (bytes into file)";
+    out << "\n  Flags:                             0x";
+    out.hex(header.flags);
+    out << "\n  Size of this header:               ";
+    out.dec(header.ehsize) << " (bytes)";
+    out << "\n  Size of program headers:           ";
+    out.dec(header.phentsize) << " (bytes)";
+    out << "\n  Number of program headers:         ";
+    out.dec(reader.get_program_header_count());
+    out << "\n  Size of section headers:           ";
+    out.dec(header.shentsize) << " (bytes)";
+    out << "\n  Number of section headers:         ";
+    out.dec(reader.get_section_header_count());
+    out << "\n  Section header string table index: ";
+    out.dec(reader.get_section_name_index()) << '\n';
+
+    const auto& segments = headers.segments;
+    if(!segments.empty())
+    {
+        out << "\nProgram Headers:\n  Type           Offset   ";
+        out.pad("VirtAddr", address_width + 3).pad("PhysAddr", address_width + 3);
+        out << (elf64 ? "FileSiz  MemSiz   Flg Align\n" : "FileSiz MemSiz  Flg Align\n");
+
+        for (const ELF::ProgramHeader& segment : segments)
+        {
+            out << "  ";
+            name(out, segment.type, 14) << " 0x";
+            out.hex(segment.offset, 6) << " 0x";
+            out.hex(segment.vaddr, address_width) << " 0x";
+            out.hex(segment.paddr, address_width) << " 0x";
+            out.hex(segment.filesz, size_width) << " 0x";
+            out.hex(segment.memsz, size_width) << ' ';
+
+            // Each letter keeps its column, as in readelf.
+            for (const auto& flag : ELF::SegmentFlagLetters)
+                out << ((segment.flags & raw(flag.flag)) ? flag.letter : ' ');
+
+            out << (segment.align ? " 0x" : " ");
+            out.hex(segment.align) << '\n';
         }
-        std::cout << std::endl;
-
-        std::cout << std::hex;
-        std::cout << "Offset: 0x" << header.offset << std::endl;
-        std::cout << "Virtual Address: 0x" << header.vaddr << std::endl;
-        std::cout << "Physical Address: 0x" << header.paddr << std::endl;
-        std::cout << "File Size: 0x" << header.filesz << std::endl;
-        std::cout << "Memory Size: 0x" << header.memsz << std::endl;
-        std::cout << "Alignment: 0x" << header.align << std::endl;
     }
 
-    auto section_headers = reader.get_section_headers();
-    for (size_t i = 0; i < section_headers.size(); i++)
+    const auto& sections = headers.sections;
+    if(!sections.empty())
     {
-        auto& header = section_headers[i];
+        out << "\nSection Headers:\n  [Nr] Name              Type            ";
+        out.pad(elf64 ? "Address" : "Addr", address_width + 1) << "Off    Size   ES Flg Lk Inf Al\n";
+
+        for (size_t i = 0; i < sections.size(); i++)
+        {
+            const ELF::SectionHeader& section = sections[i];
+            char flags[std::size(ELF::SectionFlagLetters)];
+
+            out << "  [";
+            out.dec(i, 2) << "] ";
+            out.pad(headers.names[i], 17) << ' ';
+            name(out, section.type, 15) << ' ';
+            out.hex(section.addr, address_width) << ' ';
+            out.hex(section.offset, 6) << ' ';
+            out.hex(section.size, 6) << ' ';
+            out.hex(section.entsize, 2) << ' ';
+
+            std::string_view set = letters(ELF::SectionFlagLetters, raw(section.flags), flags);
+            for (size_t width = set.size(); width < 3; width++)
+                out << ' ';
+
+            out << set << ' ';
+            out.dec(section.link, 2) << ' ';
+            out.dec(section.info, 3) << ' ';
+            out.dec(section.addralign, 2) << '\n';
+        }
+
+        out << "Key to Flags:\n"
+               "  W (write), A (alloc), X (execute), M (merge), S (strings), I (info),\n"
+               "  L (link order), O (extra OS processing required), G (group), T (TLS),\n"
+               "  C (compressed), E (exclude)\n";
+    }
+}
 
-        std::cout << std::endl;
+// One document per file: header, then the segment and section arrays.
+static void dump_json(Writer& out, const std::string& path, const ELF::Reader& reader, const Headers& headers)
+{
+    out << "{\"file\":";
+    out.json(path) << ",\"header\":{";
 
-        std::cout << "Section Header Number: " << std::dec << i << std::endl;
+    JsonFields header(out);
+    header_fields(header, reader);
 
-        std::cout << "Name Position: 0x" << std::hex << header.name << std::endl;
+    out << "},\"segments\":[";
+    const auto& segments = headers.segments;
+    for (size_t i = 0; i < segments.size(); i++)
+    {
+        JsonFields fields(out);
+        out << (i ? ",{" : "{");
+        segment_fields(fields, segments[i], i);
+        out << '}';
+    }
+
+    out << "],\"sections\":[";
+    const auto& sections = headers.sections;
+    for (size_t i = 0; i < sections.size(); i++)
+    {
+        JsonFields fields(out);
+        out << (i ? ",{" : "{");
+        section_fields(fields, headers, i);
+        out << '}';
+    }
+
+    out << "]}";
+}
+
+// One record per line, each naming its file and kind so lines can be routed independently.
+static void dump_ndjson(Writer& out, const std::string& path, const ELF::Reader& reader, const Headers& headers)
+{
+    auto record = [&](std::string_view kind) {
+        JsonFields fields(out);
+        out << '{';
+        fields.string("file", path).string("record", kind);
+        return fields;
+    };
+
+    {
+        JsonFields fields = record("header");
+        header_fields(fields, reader);
+        out << "}\n";
+    }
 
-        std::cout << "Type: ";
-        switch(header.type)
+    const auto& segments = headers.segments;
+    for (size_t i = 0; i < segments.size(); i++)
+    {
+        JsonFields fields = record("segment");
+        segment_fields(fields, segments[i], i);
+        out << "}\n";
+    }
+
+    const auto& sections = headers.sections;
+    for (size_t i = 0; i < sections.size(); i++)
+    {
+        JsonFields fields = record("section");
+        section_fields(fields, headers, i);
+        out << "}\n";
+    }
+}
+
+static int dump(const std::vector<std::string>& files, Format format)
+{
+    Writer out(STDOUT_FILENO);
+    int status = 0;
+    bool first = true;
+
+    if(format == Format::Json)
+        out << '[';
+
+    for (const std::string& path : files)
+    {
+        ELF::OpenResult reader = ELF::Reader::open(path, ELF::AccessHint::Sequential);
+        if(!reader)
         {
-        case ELF::SectionType::PROGBITS:
-            std::cout << "PROGBITS";
-            break;
+            out.flush();
+            std::cerr << path << ": " << ELF::to_string(reader.error()) << std::endl;
+            status = 1;
+            continue;
+        }
 
-        case ELF::SectionType::SYMTAB:
-            std::cout << "SYMTAB";
-            break;
+        std::optional<Headers> headers;
 
-        case ELF::SectionType::STRTAB:
-            std::cout << "STRTAB";
-            break;
+        try
+        {
+            headers.emplace(*reader);
+        }
+        catch(const std::exception& e)
+        {
+            out.flush();
+            std::cerr << path << ": " << e.what() << std::endl;
+            status = 1;
+            continue;
+        }
 
-        case ELF::SectionType::RELA:
-            std::cout << "RELA";
+        switch(format)
+        {
+        case Format::Text:
+            if(files.size() > 1)
+                out << (first ? "" : "\n") << "File: " << path << '\n';
+            dump_text(out, *reader, *headers);
             break;
 
-        case ELF::SectionType::HASH:
-            std::cout << "HASH";
+        case Format::Json:
+            if(!first)
+                out << ",\n";
+            dump_json(out, path, *reader, *headers);
             break;
 
-        case ELF::SectionType::DYNAMIC:
-            std::cout << "DYNAMIC";
+        case Format::Ndjson:
+            dump_ndjson(out, path, *reader, *headers);
             break;
+        }
 
-        case ELF::SectionType::NOTE:
-            std::cout << "NOTE";
-            break;
+        first = false;
 
-        case ELF::SectionType::NOBITS:
-            std::cout << "NOBITS";
-            break;
+        if(!out.good())
+            return 1;
+    }
 
-        case ELF::SectionType::REL:
-            std::cout << "REL";
-            break;
+    if(format == Format::Json)
+        out << "]\n";
 
-        case ELF::SectionType::SHLIB:
-            std::cout << "SHLIB";
-            break;
+    return out.flush() ? status : 1;
+}
 
-        case ELF::SectionType::DYNSYM:
-            std::cout << "DYNSYM";
-            break;
+// ------------------------------------------------------------------------------------------------
 
-        case ELF::SectionType::INIT_ARRAY:
-            std::cout << "INIT_ARRAY";
-            break;
+// One line per ELF file, rejected files are only counted.
+static int scan(const std::vector<std::string>& targets)
+{
+    struct Counters
+    {
+        size_t files    = 0;
+        size_t elf      = 0;
+        size_t sections = 0;
+    };
+
+    ELF::ScanOptions options;
+    std::vector<Counters> counters(ELF::scan_worker_count(options));
+    std::mutex output;
+    Writer out(STDOUT_FILENO);
+
+    auto visitor = [&counters, &output, &out](const ELF::ScanResult& result) {
+        Counters& local = counters[result.worker];
+        local.files++;
+
+        if(result.reader == nullptr)
+            return;
+
+        const auto& header = result.reader->get_file_header();
+        local.elf++;
+        local.sections += result.reader->get_section_header_count();
+
+        std::lock_guard<std::mutex> lock(output);
+        out << result.path << " class=";
+        name(out, static_cast<ELF::FileClass>(header.bits)) << " endian=";
+        name(out, header.endian) << " type=0x";
+        out.hex(raw(header.type)) << " machine=0x";
+        out.hex(raw(header.machine)) << " phnum=";
+        out.dec(result.reader->get_program_header_count()) << " shnum=";
+        out.dec(result.reader->get_section_header_count()) << '\n';
+    };
+
+    for (const std::string& target : targets)
+    {
+        // @file holds one path per line.
+        if(!target.empty() && target[0] == '@')
+        {
+            std::ifstream list(target.substr(1));
+            std::vector<std::string> paths;
 
-        case ELF::SectionType::FINI_ARRAY:
-            std::cout << "FINI_ARRAY";
-            break;
+            for (std::string path; std::getline(list, path);)
+            {
+                if(!path.empty())
+                    paths.push_back(path);
+            }
 
-        case ELF::SectionType::PREINIT_ARRAY:
-            std::cout << "PREINIT_ARRAY";
-            break;
+            ELF::scan_files(paths, visitor, options);
+        }
+        else
+            ELF::scan_tree(target, visitor, options);
+    }
 
-        case ELF::SectionType::GROUP:
-            std::cout << "GROUP";
-            break;
+    out.flush();
 
-        case ELF::SectionType::SYMTAB_SHNDX:
-            std::cout << "SYMTAB_SHNDX";
-            break;
+    Counters total;
+    for (const Counters& local : counters)
+    {
+        total.files    += local.files;
+        total.elf      += local.elf;
+        total.sections += local.sections;
+    }
 
-        case ELF::SectionType::NUM:
-            std::cout << "NUM";
-            break;
+    std::cerr << "Scanned " << total.files << " files, " << total.elf << " ELF, "
+              << total.sections << " sections." << std::endl;
+    return 0;
+}
 
-        case ELF::SectionType::NONE:
-        default:
-            std::cout << "NULL";
-            break;
+// ldd-like listing of every object's dependency closure, one resolver for all of them.
+static int deps(const std::vector<std::string>& targets)
+{
+    ELF::ResolveOptions options;
+
+    if(const char* paths = std::getenv("LD_LIBRARY_PATH"))
+    {
+        std::istringstream list(paths);
+        for (std::string path; std::getline(list, path, ':');)
+            options.library_paths.push_back(path.empty() ? "." : path);
+    }
+
+    ELF::DependencyResolver resolver(options);
+    Writer out(STDOUT_FILENO);
+    int status = 0;
+
+    for (const std::string& target : targets)
+    {
+        try
+        {
+            ELF::DependencyGraph graph = resolver.resolve(target);
+
+            out << target << ":\n";
+            for (size_t i = 1; i < graph.nodes.size(); i++)
+            {
+                const ELF::Dependency& node = graph.nodes[i];
+                out << '\t' << node.name << " => " << (node.path.empty() ? "not found" : node.path) << '\n';
+            }
         }
-        std::cout << std::endl;
+        catch(const std::exception& e)
+        {
+            out.flush();
+            std::cerr << target << ": " << e.what() << std::endl;
+            status = 1;
+        }
+    }
 
-        // std::cout << "Flags";
+    return status;
+}
+
+static int usage()
+{
+    std::cerr << "usage: readelf [--format=text|json|ndjson] <file>...\n"
+                 "       readelf --scan <directory | file | @list>...\n"
+                 "       readelf --deps <file>..." << std::endl;
+    return 2;
+}
+
+int main(int argc, char** argv)
+{
+    // readelf --scan <directory | file | @list>...
+    if(argc > 1 && std::strcmp(argv[1], "--scan") == 0)
+        return scan(std::vector<std::string>(argv + 2, argv + argc));
 
-        std::cout << "Virtual Address: 0x" << std::hex << header.addr << std::endl;
-        std::cout << "Offset: 0x" << header.offset << std::endl;
-        std::cout << "Size: 0x" << header.size << std::endl;
-        std::cout << "Link: 0x" << header.link << std::endl;
-        std::cout << "Info: 0x" << header.info << std::endl;
-        std::cout << "Address Alignment: 0x" << header.addralign << std::endl;
-        std::cout << "Entry Size: 0x" << header.entsize << std::endl;
+    // readelf --deps <file>...
+    if(argc > 1 && std::strcmp(argv[1], "--deps") == 0)
+        return deps(std::vector<std::string>(argv + 2, argv + argc));
+
+    Format format = Format::Text;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string_view arg = argv[i];
+
+        if(arg == "--format=text")
+            format = Format::Text;
+        else if(arg == "--format=json")
+            format = Format::Json;
+        else if(arg == "--format=ndjson")
+            format = Format::Ndjson;
+        else if(arg.size() > 1 && arg[0] == '-')
+            return usage();
+        else
+            files.emplace_back(arg);
     }
+
+    if(files.empty())
+        return usage();
+
+    return dump(files, format);
 }
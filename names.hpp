@@ -0,0 +1,285 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2021 Eviatar
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef NAMES_HPP
+#define NAMES_HPP
+#pragma once
+
+#include "readelf.hpp"
+
+#include <string_view>
+
+// ------------------------------------------------------------------------------------------------
+
+namespace ELF
+{
+    namespace details {
+        template<typename E>
+        struct EnumName
+        {
+            E                value;
+            std::string_view name;
+        };
+
+        // The tables are short, a scan is as fast as anything cleverer and folds for constants.
+        template<typename E, size_t N>
+        constexpr
+        std::string_view
+        find_name(const EnumName<E> (&names)[N], E value)
+        {
+            for (const EnumName<E>& entry : names)
+            {
+                if(entry.value == value)
+                    return entry.name;
+            }
+
+            return {};
+        }
+
+        // One letter per flag bit, in the order readelf prints them.
+        template<typename E>
+        struct FlagLetter
+        {
+            E    flag;
+            char letter;
+        };
+    }
+
+    // Names of the enumerations, empty for values without one.
+
+    inline constexpr details::EnumName<FileClass> FileClassNames[] = {
+        { FileClass::ELF32, "ELF32" },
+        { FileClass::ELF64, "ELF64" },
+    };
+
+    inline constexpr details::EnumName<Endianness> EndiannessNames[] = {
+        { Endianness::Little, "little" },
+        { Endianness::Big,    "big"    },
+    };
+
+    inline constexpr details::EnumName<ABIType> ABINames[] = {
+        { ABIType::SystemV,                      "SystemV"                      },
+        { ABIType::HP_UX,                        "HP UX"                        },
+        { ABIType::NetBSD,                       "NetBSD"                       },
+        { ABIType::Linux,                        "Linux"                        },
+        { ABIType::GNU_Hurd,                     "GNU Hurd"                     },
+        { ABIType::Solaris,                      "Solaris"                      },
+        { ABIType::AIX,                          "AIX"                          },
+        { ABIType::IRIX,                         "IRIX"                         },
+        { ABIType::FreeBSD,                      "FreeBSD"                      },
+        { ABIType::Tru64,                        "Tru64"                        },
+        { ABIType::Novell_Modesto,               "Novell Modesto"               },
+        { ABIType::OpenBSD,                      "OpenBSD"                      },
+        { ABIType::OpenVMS,                      "OpenVMS"                      },
+        { ABIType::NonStop_Kernel,               "NonStop Kernel"               },
+        { ABIType::AROS,                         "AROS"                         },
+        { ABIType::FenixOS,                      "FenixOS"                      },
+        { ABIType::CloudABI,                     "CloudABI"                     },
+        { ABIType::Stratus_Technologies_OpenVOS, "Stratus Technologies OpenVOS" },
+    };
+
+    inline constexpr details::EnumName<ObjectFileType> ObjectFileTypeNames[] = {
+        { ObjectFileType::NONE,   "NONE"   },
+        { ObjectFileType::REL,    "REL"    },
+        { ObjectFileType::EXEC,   "EXEC"   },
+        { ObjectFileType::DYN,    "DYN"    },
+        { ObjectFileType::CORE,   "CORE"   },
+        { ObjectFileType::LOOS,   "LOOS"   },
+        { ObjectFileType::HIOS,   "HIOS"   },
+        { ObjectFileType::LOPROC, "LOPROC" },
+        { ObjectFileType::HIPROC, "HIPROC" },
+    };
+
+    inline constexpr details::EnumName<InstructionSetArchitectureType> MachineNames[] = {
+        { InstructionSetArchitectureType::No_Specific,                                    "No Specific"                                    },
+        { InstructionSetArchitectureType::AT_And_T_WE_32100,                              "AT&T WE 32100"                                  },
+        { InstructionSetArchitectureType::SPARC,                                          "SPARC"                                          },
+        { InstructionSetArchitectureType::X86,                                            "X86"                                            },
+        { InstructionSetArchitectureType::M68k,                                           "M68k"                                           },
+        { InstructionSetArchitectureType::M88k,                                           "M88k"                                           },
+        { InstructionSetArchitectureType::Intel_MCU,                                      "Intel MCU"                                      },
+        { InstructionSetArchitectureType::Intel_80860,                                    "Intel 80860"                                    },
+        { InstructionSetArchitectureType::MIPS,                                           "MIPS"                                           },
+        { InstructionSetArchitectureType::IBM_System,                                     "IBM System"                                     },
+        { InstructionSetArchitectureType::MIPS_RS3000_Little_Endian,                      "MIPS RS3000"                                    },
+        { InstructionSetArchitectureType::Hewlett_Packard_PA_RISC,                        "Hewlett Packard PA RISC"                        },
+        { InstructionSetArchitectureType::Intel_80960,                                    "Intel 80960"                                    },
+        { InstructionSetArchitectureType::PowerPC,                                        "PowerPC"                                        },
+        { InstructionSetArchitectureType::PowerPC_64bit,                                  "PowerPC64"                                      },
+        { InstructionSetArchitectureType::S390,                                           "S390"                                           },
+        { InstructionSetArchitectureType::IBM_SPU_SPC,                                    "IBM SPU/SPC"                                    },
+        { InstructionSetArchitectureType::NEC_V800,                                       "NEC V800"                                       },
+        { InstructionSetArchitectureType::Fujitsu_FR20,                                   "Fujitsu FR20"                                   },
+        { InstructionSetArchitectureType::TRW_RH32,                                       "TRW RH32"                                       },
+        { InstructionSetArchitectureType::Motorola_RCE,                                   "Motorola RCE"                                   },
+        { InstructionSetArchitectureType::ARM,                                            "ARM"                                            },
+        { InstructionSetArchitectureType::Digital_Alpha,                                  "Digital Alpha"                                  },
+        { InstructionSetArchitectureType::SuperH,                                         "SuperH"                                         },
+        { InstructionSetArchitectureType::SPARC_Ver9,                                     "SPARC V9"                                       },
+        { InstructionSetArchitectureType::Siemens_TriCore_Embedded_Processor,             "Siemens TriCore Embedded Processor"             },
+        { InstructionSetArchitectureType::Argonaut_RISC_Core,                             "Argonaut RISC Core"                             },
+        { InstructionSetArchitectureType::Hitachi_H8_300,                                 "Hitachi H8 300"                                 },
+        { InstructionSetArchitectureType::Hitachi_H8_300H,                                "Hitachi H8 300H"                                },
+        { InstructionSetArchitectureType::Hitachi_H8S,                                    "Hitachi H8S"                                    },
+        { InstructionSetArchitectureType::Hitachi_H8_500,                                 "Hitachi H8 500"                                 },
+        { InstructionSetArchitectureType::IA_64,                                          "IA 64"                                          },
+        { InstructionSetArchitectureType::Stanford_MIPS_X,                                "Stanford MIPS X"                                },
+        { InstructionSetArchitectureType::Motorola_ColdFire,                              "Motorola ColdFire"                              },
+        { InstructionSetArchitectureType::Motorola_M68HC12,                               "Motorola M68HC12"                               },
+        { InstructionSetArchitectureType::Fujitsu_MMA_Multimedia_Accelerator,             "Fujitsu MMA Multimedia Accelerator"             },
+        { InstructionSetArchitectureType::Siemens_PCP,                                    "Siemens PCP"                                    },
+        { InstructionSetArchitectureType::Sony_nCPU_Embedded_RISC_Processor,              "Sony nCPU Embedded RISC Processor"              },
+        { InstructionSetArchitectureType::Denso_NDR1_Microprocessor,                      "Denso NDR1 Microprocessor"                      },
+        { InstructionSetArchitectureType::Motorola_StarCore_Processor,                    "Motorola StarCore Processor"                    },
+        { InstructionSetArchitectureType::Toyota_ME16_Processor,                          "Toyota ME16 Processor"                          },
+        { InstructionSetArchitectureType::STMicroelectronics_ST100_Processor,             "STMicroelectronics ST100 Processor"             },
+        { InstructionSetArchitectureType::Advanced_Logic_TinyJ_Embedded_Processor_Family, "Advanced Logic TinyJ Embedded Processor Family" },
+        { InstructionSetArchitectureType::AMD_X86_64,                                     "AMD X86_64"                                     },
+        { InstructionSetArchitectureType::TMS320C6000_Family,                             "TMS320C6000 Family"                             },
+        { InstructionSetArchitectureType::MCST_Elbrus_e2k,                                "MCST Elbrus e2k"                                },
+        { InstructionSetArchitectureType::ARM_64bit,                                      "AArch64"                                        },
+        { InstructionSetArchitectureType::RISC_V,                                         "RISC V"                                         },
+        { InstructionSetArchitectureType::Berkeley_Packet_Filter,                         "Berkeley Packet Filter"                         },
+        { InstructionSetArchitectureType::WDC_65C816,                                     "WDC 65C816"                                     },
+    };
+
+    inline constexpr details::EnumName<SegmentType> SegmentTypeNames[] = {
+        { SegmentType::NONE,         "NULL"         },
+        { SegmentType::LOAD,         "LOAD"         },
+        { SegmentType::DYNAMIC,      "DYNAMIC"      },
+        { SegmentType::INTERP,       "INTERP"       },
+        { SegmentType::NOTE,         "NOTE"         },
+        { SegmentType::SHLIB,        "SHLIB"        },
+        { SegmentType::PHDR,         "PHDR"         },
+        { SegmentType::TLS,          "TLS"          },
+        { SegmentType::LOOS,         "LOOS"         },
+        { SegmentType::GNU_EH_FRAME, "GNU_EH_FRAME" },
+        { SegmentType::GNU_STACK,    "GNU_STACK"    },
+        { SegmentType::GNU_RELRO,    "GNU_RELRO"    },
+        { SegmentType::GNU_PROPERTY, "GNU_PROPERTY" },
+        { SegmentType::HIOS,         "HIOS"         },
+        { SegmentType::LOPROC,       "LOPROC"       },
+        { SegmentType::HIPROC,       "HIPROC"       },
+    };
+
+    inline constexpr details::EnumName<SectionType> SectionTypeNames[] = {
+        { SectionType::NONE,          "NULL"          },
+        { SectionType::PROGBITS,      "PROGBITS"      },
+        { SectionType::SYMTAB,        "SYMTAB"        },
+        { SectionType::STRTAB,        "STRTAB"        },
+        { SectionType::RELA,          "RELA"          },
+        { SectionType::HASH,          "HASH"          },
+        { SectionType::DYNAMIC,       "DYNAMIC"       },
+        { SectionType::NOTE,          "NOTE"          },
+        { SectionType::NOBITS,        "NOBITS"        },
+        { SectionType::REL,           "REL"           },
+        { SectionType::SHLIB,         "SHLIB"         },
+        { SectionType::DYNSYM,        "DYNSYM"        },
+        { SectionType::INIT_ARRAY,    "INIT_ARRAY"    },
+        { SectionType::FINI_ARRAY,    "FINI_ARRAY"    },
+        { SectionType::PREINIT_ARRAY, "PREINIT_ARRAY" },
+        { SectionType::GROUP,         "GROUP"         },
+        { SectionType::SYMTAB_SHNDX,  "SYMTAB_SHNDX"  },
+        { SectionType::NUM,           "NUM"           },
+        { SectionType::GNU_HASH,      "GNU_HASH"      },
+        { SectionType::GNU_VERDEF,    "GNU_VERDEF"    },
+        { SectionType::GNU_VERNEED,   "GNU_VERNEED"   },
+        { SectionType::GNU_VERSYM,    "GNU_VERSYM"    },
+    };
+
+    inline constexpr details::EnumName<SymbolBinding> SymbolBindingNames[] = {
+        { SymbolBinding::LOCAL,  "LOCAL"      },
+        { SymbolBinding::GLOBAL, "GLOBAL"     },
+        { SymbolBinding::WEAK,   "WEAK"       },
+        { SymbolBinding::LOOS,   "GNU_UNIQUE" },
+    };
+
+    inline constexpr details::EnumName<SymbolType> SymbolTypeNames[] = {
+        { SymbolType::NOTYPE,  "NOTYPE"  },
+        { SymbolType::OBJECT,  "OBJECT"  },
+        { SymbolType::FUNC,    "FUNC"    },
+        { SymbolType::SECTION, "SECTION" },
+        { SymbolType::FILE,    "FILE"    },
+        { SymbolType::COMMON,  "COMMON"  },
+        { SymbolType::TLS,     "TLS"     },
+        { SymbolType::IFUNC,   "IFUNC"   },
+    };
+
+    inline constexpr details::EnumName<CompressionType> CompressionTypeNames[] = {
+        { CompressionType::ZLIB, "ZLIB" },
+        { CompressionType::ZSTD, "ZSTD" },
+    };
+
+    inline constexpr details::FlagLetter<SectionAttribute> SectionFlagLetters[] = {
+        { SectionAttribute::WRITE,            'W' },
+        { SectionAttribute::ALLOC,            'A' },
+        { SectionAttribute::EXECINSTR,        'X' },
+        { SectionAttribute::MERGE,            'M' },
+        { SectionAttribute::STRINGS,          'S' },
+        { SectionAttribute::INFO_LINK,        'I' },
+        { SectionAttribute::LINK_ORDER,       'L' },
+        { SectionAttribute::OS_NONCONFORMING, 'O' },
+        { SectionAttribute::GROUP,            'G' },
+        { SectionAttribute::TLS,              'T' },
+        { SectionAttribute::COMPRESSED,       'C' },
+        { SectionAttribute::EXCLUDE,          'E' },
+    };
+
+    inline constexpr details::FlagLetter<SegmentFlag> SegmentFlagLetters[] = {
+        { SegmentFlag::READ,    'R' },
+        { SegmentFlag::WRITE,   'W' },
+        { SegmentFlag::EXECUTE, 'E' },
+    };
+
+    constexpr std::string_view to_string(FileClass value)       { return details::find_name(FileClassNames, value); }
+    constexpr std::string_view to_string(Endianness value)      { return details::find_name(EndiannessNames, value); }
+    constexpr std::string_view to_string(ABIType value)         { return details::find_name(ABINames, value); }
+    constexpr std::string_view to_string(ObjectFileType value)  { return details::find_name(ObjectFileTypeNames, value); }
+    constexpr std::string_view to_string(InstructionSetArchitectureType value) { return details::find_name(MachineNames, value); }
+    constexpr std::string_view to_string(SegmentType value)     { return details::find_name(SegmentTypeNames, value); }
+    constexpr std::string_view to_string(SectionType value)     { return details::find_name(SectionTypeNames, value); }
+    constexpr std::string_view to_string(SymbolBinding value)   { return details::find_name(SymbolBindingNames, value); }
+    constexpr std::string_view to_string(SymbolType value)      { return details::find_name(SymbolTypeNames, value); }
+    constexpr std::string_view to_string(CompressionType value) { return details::find_name(CompressionTypeNames, value); }
+
+    static_assert(to_string(SegmentType::GNU_EH_FRAME) == "GNU_EH_FRAME", "names are resolved at compile time");
+
+    // Writes the letters of the set flags into out, which needs room for every letter of the
+    // table, and returns how many were written.
+    template<typename E, size_t N>
+    constexpr
+    size_t
+    flag_letters(const details::FlagLetter<E> (&letters)[N], uint64_t flags, char* out)
+    {
+        size_t count = 0;
+        for (const details::FlagLetter<E>& entry : letters)
+        {
+            if(flags & static_cast<uint64_t>(entry.flag))
+                out[count++] = entry.letter;
+        }
+
+        return count;
+    }
+}
+
+#endif // NAMES_HPP
@@ -1,21 +1,233 @@
 #include "readelf.hpp"
+#include "threadpool.hpp"
 
 #include <string>
 #include <cstring>
 #include <fstream>
 #include <vector>
 #include <stdexcept>
-#include <iterator>
 #include <iostream>
+#include <algorithm>
+#include <list>
+#include <mutex>
+#include <filesystem>
+#include <thread>
+#include <atomic>
+#include <climits>
+#include <cerrno>
 // #include <elf.h>
 
+#if defined(READELF_HAS_ZLIB)
+#   include <zlib.h>
+#endif
+
+#if defined(READELF_HAS_ZSTD)
+#   include <zstd.h>
+#endif
+
+#if defined(__SSSE3__)
+#   include <tmmintrin.h>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#   define READELF_HAS_MMAP 1
+#   include <fcntl.h>
+#   include <unistd.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#endif
+
 // ------------------------------------------------------------------------------------------------
 
 namespace ELF
 {
+#if defined(READELF_HAS_MMAP)
+    static inline
+    int
+    to_madvise(AccessHint hint)
+    {
+        switch(hint)
+        {
+        case AccessHint::Random:     return MADV_RANDOM;
+        case AccessHint::Sequential: return MADV_SEQUENTIAL;
+        case AccessHint::WillNeed:   return MADV_WILLNEED;
+        case AccessHint::Normal:
+        default:                     return MADV_NORMAL;
+        }
+    }
+#endif
+
+    namespace details {
+        MappedFile::MappedFile(MappedFile&& other) noexcept
+            : base(other.base), length(other.length), fallback(std::move(other.fallback))
+        {
+            other.base   = nullptr;
+            other.length = 0;
+        }
+
+        Error
+        MappedFile::map(const std::string& filename, AccessHint hint)
+        {
+#if defined(READELF_HAS_MMAP)
+            int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+            if(fd < 0)
+                return Error::OpenFailed;
+
+            struct stat st;
+            if(::fstat(fd, &st) != 0)
+            {
+                ::close(fd);
+                return Error::OpenFailed;
+            }
+
+            size_t size = static_cast<size_t>(st.st_size);
+
+            // mmap() refuses zero-length mappings, an empty file is simply an empty view.
+            if(size != 0)
+            {
+                void* addr = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if(addr == MAP_FAILED)
+                {
+                    ::close(fd);
+                    return Error::MapFailed;
+                }
+
+                base   = static_cast<const uint8_t*>(addr);
+                length = size;
+                advise(0, length, hint);
+            }
+
+            // The mapping keeps its own reference to the file.
+            ::close(fd);
+#else
+            (void)hint;
+
+            std::ifstream ifs(filename, std::ios::binary | std::ios::in | std::ios::ate);
+            if(!ifs.is_open())
+                return Error::OpenFailed;
+
+            fallback.resize(static_cast<size_t>(ifs.tellg()));
+            ifs.seekg(0);
+            ifs.read(reinterpret_cast<char*>(fallback.data()), fallback.size());
+
+            base   = fallback.data();
+            length = fallback.size();
+#endif
+            return Error::None;
+        }
+
+        MappedFile::~MappedFile()
+        {
+#if defined(READELF_HAS_MMAP)
+            if(base != nullptr)
+                ::munmap(const_cast<uint8_t*>(base), length);
+#endif
+        }
+
+        void
+        MappedFile::advise(size_t offset, size_t size, AccessHint hint) const
+        {
+#if defined(READELF_HAS_MMAP)
+            if(base == nullptr || offset >= length)
+                return;
+
+            if(size > length - offset)
+                size = length - offset;
+
+            // madvise() wants a page aligned start address.
+            static const size_t page_size = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+            size_t aligned = offset & ~(page_size - 1);
+
+            ::madvise(const_cast<uint8_t*>(base) + aligned, size + (offset - aligned), to_madvise(hint));
+#else
+            (void)offset; (void)size; (void)hint;
+#endif
+        }
+
+        // Reads pieces of a file with pread(), for callers that only need a few pages of it.
+        class FileReader
+        {
+        public:
+            explicit FileReader(const std::string& filename)
+            {
+#if defined(READELF_HAS_MMAP)
+                // O_NONBLOCK keeps a FIFO from blocking the open, its pread() then simply fails.
+                fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC | O_NOCTTY | O_NONBLOCK);
+#else
+                stream.open(filename, std::ios::binary | std::ios::in);
+#endif
+            }
+
+            ~FileReader()
+            {
+#if defined(READELF_HAS_MMAP)
+                if(fd >= 0)
+                    ::close(fd);
+#endif
+            }
+
+            FileReader(const FileReader&) = delete;
+            FileReader& operator=(const FileReader&) = delete;
+
+            bool
+            is_open() const
+            {
+#if defined(READELF_HAS_MMAP)
+                return fd >= 0;
+#else
+                return stream.is_open();
+#endif
+            }
+
+            // Returns the number of bytes read, short at the end of the file, SIZE_MAX on error.
+            size_t
+            read(uint64_t offset, void* buffer, size_t size)
+            {
+#if defined(READELF_HAS_MMAP)
+                size_t total = 0;
+
+                while(total < size)
+                {
+                    ssize_t n = ::pread(fd, static_cast<uint8_t*>(buffer) + total, size - total, off_t(offset + total));
+                    if(n < 0)
+                        return SIZE_MAX;
+                    if(n == 0)
+                        break;
+
+                    total += static_cast<size_t>(n);
+                }
+
+                return total;
+#else
+                stream.clear();
+                stream.seekg(std::streamoff(offset));
+                stream.read(static_cast<char*>(buffer), std::streamsize(size));
+                return stream.bad() ? SIZE_MAX : static_cast<size_t>(stream.gcount());
+#endif
+            }
+
+            // Reads exactly size bytes or nothing.
+            bool
+            read_exact(uint64_t offset, std::vector<uint8_t>& buffer, size_t size)
+            {
+                buffer.resize(size);
+                return read(offset, buffer.data(), size) == size;
+            }
+
+        private:
+#if defined(READELF_HAS_MMAP)
+            int fd = -1;
+#else
+            std::ifstream stream;
+#endif
+        };
+    }
+
+    // ------------------------------------------------------------------------------------------------
+
     static inline
     bool 
-    validate_elf_magic(uint8_t (&magic)[4]) 
+    validate_elf_magic(const uint8_t* magic) 
     {
         return magic[0] == 0x7FU &&
                magic[1] == 0x45U && // E
@@ -25,85 +237,3342 @@ namespace ELF
 
     // ------------------------------------------------------------------------------------------------
 
-    void 
-    Reader::read_file_header()
+    namespace details {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        static constexpr Endianness HostEndian = Endianness::Big;
+#else
+        static constexpr Endianness HostEndian = Endianness::Little;
+#endif
+
+        // A run of `count` consecutive fields that are `width` bytes wide each.
+        struct FieldRun
+        {
+            uint8_t width;
+            uint8_t count;
+        };
+
+        // Field widths of every on-disk layout, in declaration order.
+        template<typename Raw> struct FieldLayout;
+
+        template<> struct FieldLayout<Elf32::FileHeader>    { static constexpr FieldRun runs[] = { {1, 16}, {2, 2}, {4, 5}, {2, 6} }; };
+        template<> struct FieldLayout<Elf64::FileHeader>    { static constexpr FieldRun runs[] = { {1, 16}, {2, 2}, {4, 1}, {8, 3}, {4, 1}, {2, 6} }; };
+        template<> struct FieldLayout<Elf32::ProgramHeader> { static constexpr FieldRun runs[] = { {4, 8} }; };
+        template<> struct FieldLayout<Elf64::ProgramHeader> { static constexpr FieldRun runs[] = { {4, 2}, {8, 6} }; };
+        template<> struct FieldLayout<Elf32::SectionHeader> { static constexpr FieldRun runs[] = { {4, 10} }; };
+        template<> struct FieldLayout<Elf64::SectionHeader> { static constexpr FieldRun runs[] = { {4, 2}, {8, 4}, {4, 2}, {8, 2} }; };
+        template<> struct FieldLayout<Elf32::Symbol>        { static constexpr FieldRun runs[] = { {4, 3}, {1, 2}, {2, 1} }; };
+        template<> struct FieldLayout<Elf64::Symbol>        { static constexpr FieldRun runs[] = { {4, 1}, {1, 2}, {2, 1}, {8, 2} }; };
+        template<> struct FieldLayout<Elf32::Rel>           { static constexpr FieldRun runs[] = { {4, 2} }; };
+        template<> struct FieldLayout<Elf32::Rela>          { static constexpr FieldRun runs[] = { {4, 3} }; };
+        template<> struct FieldLayout<Elf64::Rel>           { static constexpr FieldRun runs[] = { {8, 2} }; };
+        template<> struct FieldLayout<Elf64::Rela>          { static constexpr FieldRun runs[] = { {8, 3} }; };
+        template<> struct FieldLayout<Elf32::Dyn>           { static constexpr FieldRun runs[] = { {4, 2} }; };
+        template<> struct FieldLayout<Elf64::Dyn>           { static constexpr FieldRun runs[] = { {8, 2} }; };
+        template<> struct FieldLayout<Elf32::Chdr>          { static constexpr FieldRun runs[] = { {4, 3} }; };
+        template<> struct FieldLayout<Elf64::Chdr>          { static constexpr FieldRun runs[] = { {4, 2}, {8, 2} }; };
+
+        // Byte permutation which reverses every field of a layout in place.
+        template<typename Raw>
+        struct SwapMask
+        {
+            uint8_t index[sizeof(Raw)] = {};
+
+            constexpr SwapMask()
+            {
+                size_t offset = 0;
+
+                for(const FieldRun& run : FieldLayout<Raw>::runs)
+                {
+                    for(size_t field = 0; field < run.count; field++, offset += run.width)
+                    {
+                        for(size_t byte = 0; byte < run.width; byte++)
+                            index[offset + byte] = static_cast<uint8_t>(offset + run.width - 1 - byte);
+                    }
+                }
+            }
+
+            // Every byte stays within its 16 byte lane, which lets a lane be swapped with one shuffle.
+            constexpr bool lane_local() const
+            {
+                for(size_t i = 0; i < sizeof(Raw); i++)
+                {
+                    if(index[i] / 16 != i / 16)
+                        return false;
+                }
+
+                return true;
+            }
+        };
+
+        // Byte-swaps `count` entries spaced `entsize` apart into a packed array of Raw.
+        template<typename Raw>
+        static void
+        swap_entries(const uint8_t* src, size_t count, size_t entsize, uint8_t* dst)
+        {
+            static constexpr SwapMask<Raw> mask;
+            static_assert(mask.lane_local(), "Fields of an ELF structure cross a 16 byte lane.");
+
+            constexpr size_t size = sizeof(Raw);
+
+#if defined(__SSSE3__)
+            constexpr size_t lanes = size / 16;
+
+            __m128i shuffles[lanes];
+            for(size_t lane = 0; lane < lanes; lane++)
+            {
+                __m128i lane_mask = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mask.index + lane * 16));
+                shuffles[lane] = _mm_sub_epi8(lane_mask, _mm_set1_epi8(static_cast<char>(lane * 16)));
+            }
+#endif
+
+            for(size_t i = 0; i < count; i++, src += entsize, dst += size)
+            {
+                size_t byte = 0;
+
+#if defined(__SSSE3__)
+                for(size_t lane = 0; lane < lanes; lane++, byte += 16)
+                {
+                    __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + byte));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + byte), _mm_shuffle_epi8(in, shuffles[lane]));
+                }
+#endif
+
+                for(; byte < size; byte++)
+                    dst[byte] = src[mask.index[byte]];
+            }
+        }
+
+        // ------------------------------------------------------------------------------------------------
+
+        template<typename Raw>
+        static inline
+        void
+        convert(const Raw& raw, FileHeader& dst)
+        {
+            std::memcpy(dst.magic, raw.ident, sizeof(dst.magic));
+            dst.bits     = raw.ident[4];
+            dst.endian   = static_cast<Endianness>(raw.ident[5]);
+            dst.version1 = raw.ident[6];
+            dst.osabi    = static_cast<ABIType>(raw.ident[7]);
+            dst.abiver   = raw.ident[8];
+            std::memcpy(dst.unused, raw.ident + 9, sizeof(dst.unused));
+
+            dst.type      = static_cast<ObjectFileType>(raw.type);
+            dst.machine   = static_cast<InstructionSetArchitectureType>(raw.machine);
+            dst.version2  = raw.version;
+            dst.entry     = raw.entry;
+            dst.phoff     = raw.phoff;
+            dst.shoff     = raw.shoff;
+            dst.flags     = raw.flags;
+            dst.ehsize    = raw.ehsize;
+            dst.phentsize = raw.phentsize;
+            dst.phnum     = raw.phnum;
+            dst.shentsize = raw.shentsize;
+            dst.shnum     = raw.shnum;
+            dst.shstrndx  = raw.shstrndx;
+        }
+
+        template<typename Raw>
+        static inline
+        void
+        convert(const Raw& raw, ProgramHeader& dst)
+        {
+            dst.type   = static_cast<SegmentType>(raw.type);
+            dst.flags  = raw.flags;
+            dst.offset = raw.offset;
+            dst.vaddr  = raw.vaddr;
+            dst.paddr  = raw.paddr;
+            dst.filesz = raw.filesz;
+            dst.memsz  = raw.memsz;
+            dst.align  = raw.align;
+        }
+
+        template<typename Raw>
+        static inline
+        void
+        convert(const Raw& raw, SectionHeader& dst)
+        {
+            dst.name      = raw.name;
+            dst.type      = static_cast<SectionType>(raw.type);
+            dst.flags     = static_cast<SectionAttribute>(raw.flags);
+            dst.addr      = raw.addr;
+            dst.offset    = raw.offset;
+            dst.size      = raw.size;
+            dst.link      = raw.link;
+            dst.info      = raw.info;
+            dst.addralign = raw.addralign;
+            dst.entsize   = raw.entsize;
+        }
+
+        template<typename Raw>
+        static inline
+        void
+        convert(const Raw& raw, Symbol& dst)
+        {
+            dst.value = raw.value;
+            dst.size  = raw.size;
+            dst.name  = raw.name;
+            dst.shndx = raw.shndx;
+            dst.info  = raw.info;
+            dst.other = raw.other;
+        }
+
+        template<typename Raw>
+        static inline
+        void
+        convert(const Raw& raw, DynamicEntry& dst)
+        {
+            // d_tag is signed, widening sign-extends it.
+            dst.tag   = static_cast<DynamicTag>(int64_t(raw.tag));
+            dst.value = raw.value;
+        }
+
+        template<typename Raw>
+        static inline
+        void
+        convert(const Raw& raw, CompressionHeader& dst)
+        {
+            dst.type      = static_cast<CompressionType>(raw.type);
+            dst.size      = raw.size;
+            dst.addralign = raw.addralign;
+        }
+
+        // Calls fn(raw, i) for a table of Raw entries. Instantiated per (class, endianness),
+        // a native file is a straight copy and a foreign one is swapped a block at a time first.
+        template<typename Raw, Endianness E, typename Fn>
+        static inline
+        void
+        for_each_entry(const uint8_t* src, size_t count, size_t entsize, Fn&& fn)
+        {
+            if constexpr (E == HostEndian)
+            {
+                for (size_t i = 0; i < count; i++, src += entsize)
+                {
+                    Raw raw;
+                    std::memcpy(&raw, src, sizeof(Raw));
+                    fn(raw, i);
+                }
+            }
+            else
+            {
+                constexpr size_t block = 64;
+                alignas(16) uint8_t swapped[block * sizeof(Raw)];
+
+                for (size_t first = 0; first < count; first += block)
+                {
+                    size_t n = (count - first < block) ? count - first : block;
+                    swap_entries<Raw>(src + first * entsize, n, entsize, swapped);
+
+                    for (size_t i = 0; i < n; i++)
+                    {
+                        Raw raw;
+                        std::memcpy(&raw, swapped + i * sizeof(Raw), sizeof(Raw));
+                        fn(raw, first + i);
+                    }
+                }
+            }
+        }
+
+        template<typename Raw, Endianness E, typename Out>
+        static void
+        decode_table(const uint8_t* src, size_t count, size_t entsize, Out* dst)
+        {
+            for_each_entry<Raw, E>(src, count, entsize, [dst](const Raw& raw, size_t i) {
+                convert(raw, dst[i]);
+            });
+        }
+
+        template<typename Raw, Endianness E>
+        static void
+        decode_symbols(const uint8_t* src, size_t count, size_t entsize, SymbolTable& dst)
+        {
+            dst.value.resize(count);
+            dst.size.resize(count);
+            dst.name.resize(count);
+            dst.shndx.resize(count);
+            dst.info.resize(count);
+            dst.other.resize(count);
+
+            for_each_entry<Raw, E>(src, count, entsize, [&dst](const Raw& raw, size_t i) {
+                dst.value[i] = raw.value;
+                dst.size[i]  = raw.size;
+                dst.name[i]  = raw.name;
+                dst.shndx[i] = raw.shndx;
+                dst.info[i]  = raw.info;
+                dst.other[i] = raw.other;
+            });
+        }
+
+        template<typename Raw>
+        static inline
+        auto
+        addend_of(const Raw& raw, int) -> decltype(int64_t(raw.addend))
+        {
+            return raw.addend;
+        }
+
+        template<typename Raw>
+        static inline
+        int64_t
+        addend_of(const Raw&, long)
+        {
+            return 0; // REL entries keep theirs at the relocated place.
+        }
+
+        // Decodes relocations a block at a time: the entries are copied out first, then r_info
+        // is split with plain shifts and masks the compiler vectorizes, and the types are counted
+        // while the block is still in cache.
+        template<typename Class, typename Raw, Endianness E>
+        static void
+        decode_relocations(const uint8_t* src, size_t count, size_t entsize, RelocationTable& dst)
+        {
+            using XWord = typename Class::XWord;
+
+            dst.offset.resize(count);
+            dst.type.resize(count);
+            dst.symbol.resize(count);
+            dst.addend.resize(count);
+
+            constexpr size_t block = 256;
+            XWord info[block];
+
+            uint64_t small_counts[256] = {};
+            std::vector<uint32_t> large_types;
+
+            for (size_t first = 0; first < count; first += block)
+            {
+                size_t n = (count - first < block) ? count - first : block;
+
+                uint64_t* offset = dst.offset.data() + first;
+                int64_t*  addend = dst.addend.data() + first;
+                uint32_t* type   = dst.type.data() + first;
+                uint32_t* symbol = dst.symbol.data() + first;
+
+                for_each_entry<Raw, E>(src + first * entsize, n, entsize, [&](const Raw& raw, size_t i) {
+                    offset[i] = raw.offset;
+                    info[i]   = raw.info;
+                    addend[i] = addend_of(raw, 0);
+                });
+
+                for (size_t i = 0; i < n; i++)
+                {
+                    symbol[i] = static_cast<uint32_t>(info[i] >> Class::relocation_symbol_shift);
+                    type[i]   = static_cast<uint32_t>(info[i] & Class::relocation_type_mask);
+                }
+
+                for (size_t i = 0; i < n; i++)
+                {
+                    if(type[i] < 256)
+                        small_counts[type[i]]++;
+                    else
+                        large_types.push_back(type[i]);
+                }
+            }
+
+            size_t used = 256;
+            while(used != 0 && small_counts[used - 1] == 0)
+                used--;
+
+            dst.type_counts.assign(small_counts, small_counts + used);
+
+            // Types past 255 are rare, sorting them once beats keeping a map.
+            std::sort(large_types.begin(), large_types.end());
+            dst.large_type_counts.clear();
+
+            for (uint32_t large : large_types)
+            {
+                if(dst.large_type_counts.empty() || dst.large_type_counts.back().first != large)
+                    dst.large_type_counts.emplace_back(large, 0);
+
+                dst.large_type_counts.back().second++;
+            }
+        }
+
+        template<typename Raw, Endianness E, typename Out>
+        static void
+        decode_one(const uint8_t* src, Out& dst)
+        {
+            decode_table<Raw, E>(src, 1, 0, &dst);
+        }
+
+        template<typename Class, Endianness E>
+        static constexpr
+        Decoder
+        make_decoder()
+        {
+            return Decoder {
+                Class::file_class,
+                E,
+                sizeof(typename Class::FileHeader),
+                sizeof(typename Class::ProgramHeader),
+                sizeof(typename Class::SectionHeader),
+                sizeof(typename Class::Symbol),
+                sizeof(typename Class::Rel),
+                sizeof(typename Class::Rela),
+                sizeof(typename Class::Dyn),
+                sizeof(typename Class::Chdr),
+                &decode_one<typename Class::FileHeader, E, FileHeader>,
+                &decode_table<typename Class::ProgramHeader, E, ProgramHeader>,
+                &decode_table<typename Class::SectionHeader, E, SectionHeader>,
+                &decode_symbols<typename Class::Symbol, E>,
+                &decode_one<typename Class::Symbol, E, Symbol>,
+                &decode_relocations<Class, typename Class::Rel, E>,
+                &decode_relocations<Class, typename Class::Rela, E>,
+                &decode_table<typename Class::Dyn, E, DynamicEntry>,
+                &decode_one<typename Class::Chdr, E, CompressionHeader>
+            };
+        }
+
+        static constexpr Decoder decoder32le = make_decoder<Elf32, Endianness::Little>();
+        static constexpr Decoder decoder32be = make_decoder<Elf32, Endianness::Big>();
+        static constexpr Decoder decoder64le = make_decoder<Elf64, Endianness::Little>();
+        static constexpr Decoder decoder64be = make_decoder<Elf64, Endianness::Big>();
+
+        static inline
+        const Decoder*
+        find_decoder(uint8_t bits, uint8_t endian)
+        {
+            bool big = static_cast<Endianness>(endian) == Endianness::Big;
+
+            if(!big && static_cast<Endianness>(endian) != Endianness::Little)
+                return nullptr;
+
+            switch(static_cast<FileClass>(bits))
+            {
+            case FileClass::ELF32: return big ? &decoder32be : &decoder32le;
+            case FileClass::ELF64: return big ? &decoder64be : &decoder64le;
+            default:               return nullptr;
+            }
+        }
+
+        // ------------------------------------------------------------------------------------------------
+
+        template<typename T>
+        static inline
+        T
+        byte_swap(T value)
+        {
+            T swapped = 0;
+
+            for (size_t i = 0; i < sizeof(T); i++, value >>= 8)
+                swapped = static_cast<T>((swapped << 8) | (value & 0xFFU));
+
+            return swapped;
+        }
+
+        // Reads a single value stored in the file's byte order.
+        template<typename T>
+        static inline
+        T
+        load(const uint8_t* src, Endianness endian)
+        {
+            T value;
+            std::memcpy(&value, src, sizeof(T));
+
+            return (endian == HostEndian) ? value : byte_swap(value);
+        }
+    }
+
+    // ------------------------------------------------------------------------------------------------
+
+    // Every check probe() and the reader make on a file header.
+    static inline
+    Error
+    validate_file_header(ByteView bytes, const details::Decoder*& decoder, FileHeader& header)
     {
-        if(data.size() < sizeof(FileHeader))
-            throw std::runtime_error("File header does not have an expected size.");
+        if(bytes.size() < details::IdentSize)
+            return Error::TooSmall;
+
+        if(!validate_elf_magic(bytes.data()))
+            return Error::NotELF;
+
+        // The class and byte order in e_ident decide how everything that follows is read.
+        decoder = details::find_decoder(bytes[4], bytes[5]);
+        if(decoder == nullptr)
+        {
+            bool known_class = bytes[4] == static_cast<uint8_t>(FileClass::ELF32) || 
+                               bytes[4] == static_cast<uint8_t>(FileClass::ELF64);
+
+            return known_class ? Error::UnsupportedByteOrder : Error::UnsupportedClass;
+        }
+
+        if(bytes.size() < decoder->file_header_size)
+            return Error::TooSmall;
+
+        decoder->file_header(bytes.data(), header);
+
+        if(header.version1 != 1 || header.version2 != 1)
+            return Error::UnsupportedVersion;
 
-        std::memcpy(&file_header, data.data(), sizeof(FileHeader));
+        if(header.ehsize < decoder->file_header_size ||
+           (header.phnum != 0 && header.phentsize < decoder->program_header_size) ||
+           (header.shnum != 0 && header.shentsize < decoder->section_header_size))
+            return Error::BadHeaderSize;
 
-        if(!validate_elf_magic(file_header.magic))
-            throw std::runtime_error("File is not an ELF file.");
+        return Error::None;
     }
 
+    static inline
     void
-    Reader::read_program_headers()
+    throw_if(Error error)
     {
-        auto phnum     = file_header.phnum;
-        auto phoff     = file_header.phoff;
-        auto phentsize = file_header.phentsize;
+        if(error != Error::None)
+            throw std::runtime_error(to_string(error));
+    }
 
-        if(phoff + (phnum * sizeof(ProgramHeader)) > data.size())
-            throw std::runtime_error("Program headers does not have an expected size.");
+    // Files with too many sections or segments for the file header keep the counts in section 0.
+    static inline
+    bool
+    uses_section_zero(const FileHeader& header)
+    {
+        return header.shoff != 0 &&
+               (header.shnum == 0 ||
+                header.shstrndx == static_cast<uint16_t>(SectionIndex::XINDEX) ||
+                header.phnum == details::ExtendedPhnum);
+    }
+
+    // Resolves the table sizes, fetch(offset, size) returns the raw bytes of section 0 or nullptr.
+    template<typename Fetch>
+    static inline
+    Error
+    resolve_table_counts(const FileHeader& header, const details::Decoder* decoder, Fetch&& fetch, details::TableCounts& counts)
+    {
+        counts.phnum    = header.phnum;
+        counts.shnum    = header.shnum;
+        counts.shstrndx = header.shstrndx;
 
-        const uint8_t* p_header = data.data() + phoff;
+        if(!uses_section_zero(header))
+            return Error::None;
 
-        for (size_t i = 0; i < phnum; i++)
-        {
-            ProgramHeader ph;
-            std::memcpy(&ph, p_header, sizeof(ProgramHeader));
+        if(header.shentsize < decoder->section_header_size)
+            return Error::BadHeaderSize;
 
-            program_headers.push_back(ph);
+        const uint8_t* raw = fetch(header.shoff, decoder->section_header_size);
+        if(raw == nullptr)
+            return Error::BadSectionHeaders;
 
-            p_header += phentsize;
-        }
+        SectionHeader zero;
+        decoder->section_headers(raw, 1, 0, &zero);
+
+        if(header.shnum == 0)
+            counts.shnum = zero.size;
+        if(header.shstrndx == static_cast<uint16_t>(SectionIndex::XINDEX))
+            counts.shstrndx = zero.link;
+        if(header.phnum == details::ExtendedPhnum)
+            counts.phnum = zero.info;
+
+        return Error::None;
+    }
+
+    // Same over a file that isn't mapped.
+    static inline
+    Error
+    resolve_table_counts(const FileHeader& header, const details::Decoder* decoder, details::FileReader& file, details::TableCounts& counts)
+    {
+        std::vector<uint8_t> bytes;
+
+        return resolve_table_counts(header, decoder, [&file, &bytes](uint64_t offset, size_t size) -> const uint8_t* {
+            return file.read_exact(offset, bytes, size) ? bytes.data() : nullptr;
+        }, counts);
+    }
+
+    Error
+    Reader::read_file_header()
+    {
+        if(Error error = validate_file_header(data, decoder, file_header); error != Error::None)
+            return error;
+
+        return resolve_table_counts(file_header, decoder, [this](uint64_t offset, size_t size) -> const uint8_t* {
+            return offset <= data.size() && size <= data.size() - offset ? data.data() + offset : nullptr;
+        }, counts);
+    }
+
+    Error
+    Reader::program_header_table(const uint8_t*& table) const
+    {
+        auto phnum     = counts.phnum;
+        auto phoff     = file_header.phoff;
+        auto phentsize = file_header.phentsize;
+
+        // Divided rather than multiplied, the counts taken from section 0 can be anything.
+        if(phoff > data.size() || (phnum != 0 && (data.size() - phoff) / phentsize < phnum))
+            return Error::BadProgramHeaders;
+
+        table = data.data() + phoff;
+        return Error::None;
     }
 
-    void 
-    Reader::read_section_headers()
+    Error
+    Reader::section_header_table(const uint8_t*& table) const
     {
-        auto shnum     = file_header.shnum;
+        auto shnum     = counts.shnum;
         auto shoff     = file_header.shoff;
         auto shentsize = file_header.shentsize;
 
-        const uint8_t* p_header = data.data() + shoff;
+        if(shoff > data.size() || (shnum != 0 && (data.size() - shoff) / shentsize < shnum))
+            return Error::BadSectionHeaders;
+
+        table = data.data() + shoff;
+        return Error::None;
+    }
+
+    Error
+    Reader::read_program_headers() const
+    {
+        const uint8_t* p_header = nullptr;
+        if(Error error = program_header_table(p_header); error != Error::None)
+            return error;
 
-        if(shoff + (shnum * sizeof(SectionHeader)) > data.size())
-            throw std::runtime_error("Section headers does not have an expected size.");
+        program_headers.resize(counts.phnum);
+        decoder->program_headers(p_header, counts.phnum, file_header.phentsize, program_headers.data());
 
-        for (size_t i = 0; i < shnum; i++)
-        {
-            SectionHeader sh;
-            std::memcpy(&sh, p_header, sizeof(SectionHeader));
+        program_headers_loaded = true;
+        return Error::None;
+    }
+
+    Error
+    Reader::read_section_headers() const
+    {
+        const uint8_t* p_header = nullptr;
+        if(Error error = section_header_table(p_header); error != Error::None)
+            return error;
+
+        section_headers.resize(counts.shnum);
+        decoder->section_headers(p_header, counts.shnum, file_header.shentsize, section_headers.data());
+
+        section_headers_loaded = true;
+        return Error::None;
+    }
+
+    // ------------------------------------------------------------------------------------------------
+
+    const std::vector<ProgramHeader>&
+    Reader::get_program_headers() const
+    {
+        if(!program_headers_loaded)
+            throw_if(read_program_headers());
+
+        return program_headers;
+    }
+
+    const std::vector<SectionHeader>&
+    Reader::get_section_headers() const
+    {
+        if(!section_headers_loaded)
+            throw_if(read_section_headers());
+
+        return section_headers;
+    }
+
+    ProgramHeader
+    Reader::get_program_header(size_t index) const
+    {
+        if(index >= counts.phnum)
+            throw std::out_of_range("Program header index is out of range.");
+
+        if(program_headers_loaded)
+            return program_headers[index];
+
+        const uint8_t* table = nullptr;
+        throw_if(program_header_table(table));
+
+        ProgramHeader ph;
+        decoder->program_headers(table + index * file_header.phentsize, 1, 0, &ph);
+        return ph;
+    }
+
+    SectionHeader
+    Reader::get_section_header(size_t index) const
+    {
+        if(index >= counts.shnum)
+            throw std::out_of_range("Section header index is out of range.");
+
+        if(section_headers_loaded)
+            return section_headers[index];
+
+        const uint8_t* table = nullptr;
+        throw_if(section_header_table(table));
+
+        SectionHeader sh;
+        decoder->section_headers(table + index * file_header.shentsize, 1, 0, &sh);
+        return sh;
+    }
+
+    ByteView
+    Reader::get_section_data(const SectionHeader& section) const
+    {
+        if(section.type == SectionType::NOBITS)
+            return ByteView();
+
+        if(section.offset > data.size() || section.size > data.size() - section.offset)
+            throw std::runtime_error("Section data is out of the file bounds.");
+
+        return data.subview(section.offset, section.size);
+    }
+
+    ByteView
+    Reader::get_segment_data(const ProgramHeader& segment) const
+    {
+        if(segment.offset > data.size() || segment.filesz > data.size() - segment.offset)
+            throw std::runtime_error("Segment data is out of the file bounds.");
 
-            section_headers.push_back(sh);
+        return data.subview(segment.offset, segment.filesz);
+    }
 
-            p_header += shentsize;
+    const ProgramHeader*
+    Reader::find_segment(SegmentType type) const
+    {
+        for (const ProgramHeader& segment : get_program_headers())
+        {
+            if(segment.type == type)
+                return &segment;
         }
+
+        return nullptr;
     }
 
     // ------------------------------------------------------------------------------------------------
 
-    Reader::Reader(const std::string& filename)
+    std::vector<uint32_t>
+    SymbolTable::select(SymbolType wanted, uint64_t min_size) const
     {
-        std::ifstream ifs(filename, std::ios::binary | std::ios::in);
+        std::vector<uint32_t> indices(count());
+        size_t found = 0;
+
+        // Branch-free compaction, every index is written and only kept when it matches.
+        const uint8_t  type_bits = static_cast<uint8_t>(wanted);
+        const uint8_t* p_info    = info.data();
+        const uint64_t* p_size   = size.data();
 
-        if(ifs.is_open())
+        for (size_t i = 0; i < indices.size(); i++)
         {
-            std::copy(std::istreambuf_iterator<char>(ifs), 
-                      std::istreambuf_iterator<char>(), 
-                      std::back_inserter(data));
+            indices[found] = static_cast<uint32_t>(i);
+            found += ((p_info[i] & 0xFU) == type_bits) & (p_size[i] > min_size);
+        }
 
-            ifs.close();
+        indices.resize(found);
+        return indices;
+    }
 
-            read_file_header();
-            read_program_headers();
-            read_section_headers();
+    // Contents of the SYMTAB_SHNDX section holding the real section indices of the symbols
+    // of the given table whose st_shndx is SHN_XINDEX, empty when there is none.
+    static inline
+    ByteView
+    find_extended_indices(const Reader& reader, size_t section_index)
+    {
+        for (const SectionHeader& section : reader.get_section_headers())
+        {
+            if(section.type == SectionType::SYMTAB_SHNDX && section.link == section_index)
+                return reader.get_section_data(section);
         }
-        else
-            throw std::runtime_error("File couldn't be opened.");
+
+        return ByteView();
     }
 
-    Reader::~Reader() = default;
+    SymbolTable
+    Reader::read_symbol_table(size_t section_index) const
+    {
+        SectionHeader section = get_section_header(section_index);
+
+        if(section.type != SectionType::SYMTAB && section.type != SectionType::DYNSYM)
+            throw std::runtime_error("Section is not a symbol table.");
+
+        size_t entsize = section.entsize ? section.entsize : decoder->symbol_size;
+        if(entsize < decoder->symbol_size)
+            throw std::runtime_error("Symbol table does not have an expected entry size.");
+
+        ByteView bytes = get_section_data(section);
+
+        SymbolTable table;
+        table.section = static_cast<uint32_t>(section_index);
+        table.strtab  = section.link;
+
+        size_t count = bytes.size() / entsize;
+        if(count != 0 && bytes.size() - (count - 1) * entsize < decoder->symbol_size)
+            count--;
+
+        decoder->symbols(bytes.data(), count, entsize, table);
+
+        const uint32_t xindex = static_cast<uint32_t>(SectionIndex::XINDEX);
+        if(std::find(table.shndx.begin(), table.shndx.end(), xindex) != table.shndx.end())
+        {
+            ByteView extended = find_extended_indices(*this, section_index);
+            size_t   limit    = std::min(count, extended.size() / sizeof(uint32_t));
+
+            for (size_t i = 0; i < limit; i++)
+            {
+                if(table.shndx[i] == xindex)
+                    table.shndx[i] = details::load<uint32_t>(extended.data() + i * sizeof(uint32_t), decoder->endian);
+            }
+        }
+
+        return table;
+    }
+
+    RelocationTable
+    Reader::read_relocations(size_t section_index) const
+    {
+        SectionHeader section = get_section_header(section_index);
+
+        if(section.type != SectionType::REL && section.type != SectionType::RELA)
+            throw std::runtime_error("Section is not a relocation table.");
+
+        bool   rela     = section.type == SectionType::RELA;
+        size_t raw_size = rela ? decoder->rela_size : decoder->rel_size;
+        size_t entsize  = section.entsize ? section.entsize : raw_size;
+
+        if(entsize < raw_size)
+            throw std::runtime_error("Relocation table does not have an expected entry size.");
+
+        ByteView bytes = get_section_data(section);
+
+        RelocationTable table;
+        table.section = static_cast<uint32_t>(section_index);
+        table.symtab  = section.link;
+        table.target  = section.info;
+        table.rela    = rela;
+
+        size_t count = bytes.size() / entsize;
+        if(count != 0 && bytes.size() - (count - 1) * entsize < raw_size)
+            count--;
+
+        (rela ? decoder->relas : decoder->rels)(bytes.data(), count, entsize, table);
+        return table;
+    }
+
+    uint64_t
+    RelocationTable::count_of(uint32_t type) const
+    {
+        if(type < type_counts.size())
+            return type_counts[type];
+
+        auto it = std::lower_bound(large_type_counts.begin(), large_type_counts.end(), type, [](const auto& entry, uint32_t value) {
+            return entry.first < value;
+        });
+
+        return (it != large_type_counts.end() && it->first == type) ? it->second : 0;
+    }
+
+    static inline
+    std::shared_ptr<const SymbolTable>
+    load_symbol_table(const Reader& reader, SectionType type)
+    {
+        const auto& sections = reader.get_section_headers();
+
+        for (size_t i = 0; i < sections.size(); i++)
+        {
+            if(sections[i].type == type)
+                return std::make_shared<const SymbolTable>(reader.read_symbol_table(i));
+        }
+
+        return std::make_shared<const SymbolTable>();
+    }
+
+    const SymbolTable&
+    Reader::get_symbol_table() const
+    {
+        if(!symbol_table)
+            symbol_table = load_symbol_table(*this, SectionType::SYMTAB);
+
+        return *symbol_table;
+    }
+
+    const SymbolTable&
+    Reader::get_dynamic_symbol_table() const
+    {
+        if(!dynamic_symbol_table)
+            dynamic_symbol_table = load_symbol_table(*this, SectionType::DYNSYM);
+
+        return *dynamic_symbol_table;
+    }
+
+    // ------------------------------------------------------------------------------------------------
+
+    std::string_view
+    Reader::get_string(size_t strtab_index, uint32_t offset) const
+    {
+        const auto& sections = get_section_headers();
+
+        if(strtab_index >= sections.size())
+            throw std::out_of_range("String table index is out of range.");
+
+        ByteView strtab = get_section_data(sections[strtab_index]);
+
+        if(offset >= strtab.size())
+            throw std::out_of_range("String offset is out of the string table.");
+
+        const char* first = reinterpret_cast<const char*>(strtab.data()) + offset;
+        const void* nul   = std::memchr(first, '\0', strtab.size() - offset);
+
+        if(nul == nullptr)
+            throw std::out_of_range("String is not terminated inside the string table.");
+
+        return std::string_view(first, static_cast<const char*>(nul) - first);
+    }
+
+    std::string_view
+    Reader::get_section_name(const SectionHeader& section) const
+    {
+        return get_string(counts.shstrndx, section.name);
+    }
+
+    std::string_view
+    Reader::get_symbol_name(const SymbolTable& table, size_t symbol) const
+    {
+        return get_string(table.strtab, table.name.at(symbol));
+    }
+
+    const SectionHeader*
+    Reader::find_section(std::string_view name) const
+    {
+        const auto& sections = get_section_headers();
+
+        if(!section_names_loaded)
+        {
+            ByteView strtab;
+
+            // Without a readable name table no section can be found by name.
+            if(counts.shstrndx < sections.size())
+            {
+                try
+                {
+                    strtab = get_section_data(sections[counts.shstrndx]);
+                }
+                catch(const std::exception&)
+                {
+                }
+            }
+
+            section_names.reserve(sections.size());
+
+            // The first section wins when several share a name. Sections whose name is out of
+            // the table are left out rather than failing every lookup.
+            for (size_t i = 0; i < sections.size(); i++)
+            {
+                uint32_t offset = sections[i].name;
+                if(offset >= strtab.size())
+                    continue;
+
+                const char* first = reinterpret_cast<const char*>(strtab.data()) + offset;
+                const void* nul   = std::memchr(first, '\0', strtab.size() - offset);
+
+                if(nul != nullptr)
+                    section_names.emplace(std::string_view(first, static_cast<const char*>(nul) - first), static_cast<uint32_t>(i));
+            }
+
+            section_names_loaded = true;
+        }
+
+        auto it = section_names.find(name);
+        return (it != section_names.end()) ? &sections[it->second] : nullptr;
+    }
+
+    // ------------------------------------------------------------------------------------------------
+
+    namespace details {
+        // Hash function of DT_GNU_HASH tables.
+        static inline
+        uint32_t
+        gnu_hash(std::string_view name)
+        {
+            uint32_t h = 5381;
+
+            for (unsigned char c : name)
+                h = (h << 5) + h + c;
+
+            return h;
+        }
+
+        // Hash function of SysV DT_HASH tables.
+        static inline
+        uint32_t
+        sysv_hash(std::string_view name)
+        {
+            uint32_t h = 0;
+
+            for (unsigned char c : name)
+            {
+                h = (h << 4) + c;
+                h ^= (h >> 24) & 0xF0U;
+            }
+
+            return h & 0x0FFFFFFFU;
+        }
+
+        // Open addressing name index over one symbol table, for files without hash tables
+        // and for the symbols they don't export.
+        struct SymbolIndex
+        {
+            struct Slot
+            {
+                std::string_view name;
+                uint32_t         hash;
+                uint32_t         index; // symbol index + 1, 0 marks an empty slot.
+            };
+
+            std::shared_ptr<const SymbolTable> table;
+            std::vector<Slot> slots;
+            uint32_t section = 0;
+
+            const Slot*
+            find(std::string_view name, uint32_t hash) const
+            {
+                if(slots.empty())
+                    return nullptr;
+
+                size_t mask = slots.size() - 1;
+
+                for (size_t i = hash & mask; slots[i].index != 0; i = (i + 1) & mask)
+                {
+                    if(slots[i].hash == hash && slots[i].name == name)
+                        return &slots[i];
+                }
+
+                return nullptr;
+            }
+        };
+
+        static inline
+        std::shared_ptr<const SymbolIndex>
+        build_symbol_index(const Reader& reader, std::shared_ptr<const SymbolTable> table)
+        {
+            auto index   = std::make_shared<SymbolIndex>();
+            index->table = table;
+
+            if(table->empty())
+                return index;
+
+            index->section = table->section;
+
+            // At most half full, a miss ends at the first empty slot.
+            size_t capacity = 16;
+            while(capacity < table->count() * 2)
+                capacity <<= 1;
+
+            index->slots.resize(capacity, SymbolIndex::Slot { std::string_view(), 0, 0 });
+            size_t mask = capacity - 1;
+
+            for (size_t i = 0; i < table->count(); i++)
+            {
+                if(table->shndx[i] == static_cast<uint32_t>(SectionIndex::UNDEF))
+                    continue;
+
+                std::string_view name = reader.get_symbol_name(*table, i);
+                if(name.empty())
+                    continue;
+
+                uint32_t hash = gnu_hash(name);
+                size_t slot   = hash & mask;
+
+                while(index->slots[slot].index != 0 && 
+                      !(index->slots[slot].hash == hash && index->slots[slot].name == name))
+                    slot = (slot + 1) & mask;
+
+                auto& entry = index->slots[slot];
+
+                // A global definition shadows local ones of the same name.
+                if(entry.index == 0 || 
+                   (table->binding(entry.index - 1) == SymbolBinding::LOCAL && table->binding(i) != SymbolBinding::LOCAL))
+                    entry = SymbolIndex::Slot { name, hash, static_cast<uint32_t>(i + 1) };
+            }
+
+            return index;
+        }
+    }
+
+    Symbol
+    Reader::get_symbol(size_t section_index, size_t symbol) const
+    {
+        const SectionHeader& section = get_section_headers().at(section_index);
+
+        if(section.type != SectionType::SYMTAB && section.type != SectionType::DYNSYM)
+            throw std::runtime_error("Section is not a symbol table.");
+
+        size_t entsize = section.entsize ? section.entsize : decoder->symbol_size;
+        if(entsize < decoder->symbol_size)
+            throw std::runtime_error("Symbol table does not have an expected entry size.");
+
+        ByteView bytes = get_section_data(section);
+        if(symbol >= bytes.size() / entsize)
+            throw std::out_of_range("Symbol index is out of range.");
+
+        Symbol sym;
+        decoder->symbol(bytes.data() + symbol * entsize, sym);
+
+        if(sym.shndx == static_cast<uint32_t>(SectionIndex::XINDEX))
+        {
+            ByteView extended = find_extended_indices(*this, section_index);
+            if((symbol + 1) * sizeof(uint32_t) <= extended.size())
+                sym.shndx = details::load<uint32_t>(extended.data() + symbol * sizeof(uint32_t), decoder->endian);
+        }
+
+        return sym;
+    }
+
+    bool
+    Reader::symbol_matches(std::string_view name, uint32_t section, uint32_t index, SymbolLookup& found) const
+    {
+        Symbol sym = get_symbol(section, index);
+
+        if(sym.shndx == static_cast<uint32_t>(SectionIndex::UNDEF))
+            return false;
+
+        if(get_string(get_section_headers()[section].link, sym.name) != name)
+            return false;
+
+        found = SymbolLookup { section, index, sym };
+        return true;
+    }
+
+    SymbolLookup
+    Reader::lookup_gnu_hash(std::string_view name, const SectionHeader& hash) const
+    {
+        ByteView bytes    = get_section_data(hash);
+        Endianness endian = decoder->endian;
+
+        if(bytes.size() < 16)
+            throw std::runtime_error("GNU hash table does not have an expected size.");
+
+        uint32_t nbuckets    = details::load<uint32_t>(bytes.data() + 0, endian);
+        uint32_t symoffset   = details::load<uint32_t>(bytes.data() + 4, endian);
+        uint32_t bloom_size  = details::load<uint32_t>(bytes.data() + 8, endian);
+        uint32_t bloom_shift = details::load<uint32_t>(bytes.data() + 12, endian);
+
+        // Bloom filter words are as wide as the file's class.
+        size_t word_size = (decoder->file_class == FileClass::ELF64) ? 8 : 4;
+        size_t word_bits = word_size * 8;
+
+        // A shift as wide as the hash would be undefined, no linker writes one.
+        if(nbuckets == 0 || bloom_size == 0 || bloom_shift >= 32 ||
+           (bytes.size() - 16) / word_size < bloom_size ||
+           (bytes.size() - 16 - size_t(bloom_size) * word_size) / 4 < nbuckets)
+            throw std::runtime_error("GNU hash table does not have an expected size.");
+
+        const uint8_t* bloom   = bytes.data() + 16;
+        const uint8_t* buckets = bloom + size_t(bloom_size) * word_size;
+        const uint8_t* chains  = buckets + size_t(nbuckets) * 4;
+        const uint8_t* end     = bytes.data() + bytes.size();
+
+        uint32_t h1 = details::gnu_hash(name);
+
+        const uint8_t* p_word = bloom + ((h1 / word_bits) % bloom_size) * word_size;
+        uint64_t word = (word_size == 8) ? details::load<uint64_t>(p_word, endian) 
+                                         : details::load<uint32_t>(p_word, endian);
+        uint64_t mask = (uint64_t(1) << (h1 % word_bits)) | (uint64_t(1) << ((h1 >> bloom_shift) % word_bits));
+
+        if((word & mask) != mask)
+            return SymbolLookup();
+
+        uint32_t symix = details::load<uint32_t>(buckets + (h1 % nbuckets) * 4, endian);
+        if(symix < symoffset)
+            return SymbolLookup();
+
+        SymbolLookup found;
+
+        for (;; symix++)
+        {
+            const uint8_t* p_chain = chains + size_t(symix - symoffset) * 4;
+            if(p_chain + 4 > end)
+                break;
+
+            uint32_t h2 = details::load<uint32_t>(p_chain, endian);
+
+            if((h1 | 1) == (h2 | 1) && symbol_matches(name, hash.link, symix, found))
+                return found;
+
+            // The low bit marks the end of a bucket's chain.
+            if(h2 & 1)
+                break;
+        }
+
+        return SymbolLookup();
+    }
+
+    SymbolLookup
+    Reader::lookup_sysv_hash(std::string_view name, const SectionHeader& hash) const
+    {
+        ByteView bytes    = get_section_data(hash);
+        Endianness endian = decoder->endian;
+
+        if(bytes.size() < 8)
+            throw std::runtime_error("Hash table does not have an expected size.");
+
+        uint32_t nbucket = details::load<uint32_t>(bytes.data() + 0, endian);
+        uint32_t nchain  = details::load<uint32_t>(bytes.data() + 4, endian);
+
+        if(nbucket == 0 || (bytes.size() - 8) / 4 < size_t(nbucket) + nchain)
+            throw std::runtime_error("Hash table does not have an expected size.");
+
+        const uint8_t* buckets = bytes.data() + 8;
+        const uint8_t* chains  = buckets + size_t(nbucket) * 4;
+
+        SymbolLookup found;
+        uint32_t symix = details::load<uint32_t>(buckets + (details::sysv_hash(name) % nbucket) * 4, endian);
+
+        // Bounded by nchain so that a cyclic chain in a broken file still terminates.
+        for (uint32_t steps = 0; symix != 0 && symix < nchain && steps < nchain; steps++)
+        {
+            if(symbol_matches(name, hash.link, symix, found))
+                return found;
+
+            symix = details::load<uint32_t>(chains + size_t(symix) * 4, endian);
+        }
+
+        return SymbolLookup();
+    }
+
+    SymbolLookup
+    Reader::lookup_symbol(std::string_view name) const
+    {
+        const auto& sections = get_section_headers();
+
+        if(!hash_sections_loaded)
+        {
+            for (size_t i = 0; i < sections.size(); i++)
+            {
+                if(sections[i].type == SectionType::GNU_HASH && gnu_hash_section == 0)
+                    gnu_hash_section = static_cast<uint32_t>(i);
+                else if(sections[i].type == SectionType::HASH && sysv_hash_section == 0)
+                    sysv_hash_section = static_cast<uint32_t>(i);
+            }
+
+            hash_sections_loaded = true;
+        }
+
+        SymbolLookup found;
+
+        // GNU_HASH comes with a bloom filter, prefer it when both are present.
+        if(gnu_hash_section != 0)
+            found = lookup_gnu_hash(name, sections[gnu_hash_section]);
+        else if(sysv_hash_section != 0)
+            found = lookup_sysv_hash(name, sections[sysv_hash_section]);
+
+        if(found)
+            return found;
+
+        if(!symbol_index)
+        {
+            // Hash tables only cover DYNSYM, the index takes what they don't.
+            bool hashed = gnu_hash_section != 0 || sysv_hash_section != 0;
+
+            get_symbol_table();
+            get_dynamic_symbol_table();
+
+            if(!symbol_table->empty())
+                symbol_index = details::build_symbol_index(*this, symbol_table);
+            else if(!hashed)
+                symbol_index = details::build_symbol_index(*this, dynamic_symbol_table);
+            else
+                symbol_index = details::build_symbol_index(*this, std::make_shared<const SymbolTable>());
+        }
+
+        uint32_t hash = details::gnu_hash(name);
+        const details::SymbolIndex::Slot* slot = symbol_index->find(name, hash);
+
+        if(slot == nullptr)
+            return SymbolLookup();
+
+        size_t i = slot->index - 1;
+        const SymbolTable& table = *symbol_index->table;
+
+        found.section = symbol_index->section;
+        found.index   = static_cast<uint32_t>(i);
+        found.symbol  = Symbol { table.value[i], table.size[i], table.name[i], table.shndx[i], table.info[i], table.other[i] };
+        return found;
+    }
+
+    // ------------------------------------------------------------------------------------------------
+
+    namespace details {
+        // Sorted intervals of the function symbols and allocated sections.
+        struct AddressIndex
+        {
+            std::shared_ptr<const SymbolTable> table;
+
+            // Functions sorted by start address, one entry per distinct start.
+            std::vector<uint64_t> starts;
+            std::vector<uint64_t> ends;
+            std::vector<uint32_t> symbols;
+
+            // The starts again in Eytzinger order (1-based), with the sorted rank of each node.
+            std::vector<uint64_t> tree;
+            std::vector<uint32_t> ranks;
+
+            // Allocated sections sorted by address.
+            std::vector<uint64_t> section_starts;
+            std::vector<uint64_t> section_ends;
+            std::vector<uint32_t> sections;
+
+            // Position of the last function starting at or before address, SIZE_MAX when there is none.
+            size_t
+            predecessor(uint64_t address) const
+            {
+                size_t n = tree.size() - 1;
+                size_t k = 1;
+
+                while(k <= n)
+                {
+#if defined(__GNUC__)
+                    // Four levels down the 16 descendants share a cache line or two.
+                    __builtin_prefetch(tree.data() + (k * 16 < tree.size() ? k * 16 : 0));
+#endif
+                    k = 2 * k + (tree[k] <= address);
+                }
+
+                // Undo the trailing right turns and the last left one, k is then the first start above address.
+                while(k & 1)
+                    k >>= 1;
+                k >>= 1;
+
+                return (k == 0) ? n - 1 : size_t(ranks[k]) - 1;
+            }
+
+            size_t
+            section_predecessor(uint64_t address) const
+            {
+                auto it = std::upper_bound(section_starts.begin(), section_starts.end(), address);
+                return size_t(it - section_starts.begin()) - 1;
+            }
+
+            size_t
+            fill_tree(size_t i, size_t k)
+            {
+                if(k < tree.size())
+                {
+                    i = fill_tree(i, 2 * k);
+                    tree[k]  = starts[i];
+                    ranks[k] = static_cast<uint32_t>(i);
+                    i = fill_tree(i + 1, 2 * k + 1);
+                }
+
+                return i;
+            }
+        };
+
+        static inline
+        std::shared_ptr<const AddressIndex>
+        build_address_index(const std::vector<SectionHeader>& section_headers, std::shared_ptr<const SymbolTable> table)
+        {
+            auto index   = std::make_shared<AddressIndex>();
+            index->table = table;
+
+            std::vector<uint32_t> order;
+            order.reserve(table->count());
+
+            for (size_t i = 0; i < table->count(); i++)
+            {
+                SymbolType type = table->type(i);
+
+                if((type == SymbolType::FUNC || type == SymbolType::IFUNC) &&
+                   table->shndx[i] != static_cast<uint32_t>(SectionIndex::UNDEF))
+                    order.push_back(static_cast<uint32_t>(i));
+            }
+
+            // Among aliases of one address prefer a global symbol, then the larger one.
+            std::sort(order.begin(), order.end(), [&table](uint32_t a, uint32_t b) {
+                if(table->value[a] != table->value[b])
+                    return table->value[a] < table->value[b];
+
+                bool a_local = table->binding(a) == SymbolBinding::LOCAL;
+                bool b_local = table->binding(b) == SymbolBinding::LOCAL;
+                if(a_local != b_local)
+                    return b_local;
+
+                return table->size[a] > table->size[b];
+            });
+
+            for (uint32_t i : order)
+            {
+                if(!index->starts.empty() && index->starts.back() == table->value[i])
+                    continue;
+
+                index->starts.push_back(table->value[i]);
+                index->ends.push_back(table->value[i] + table->size[i]);
+                index->symbols.push_back(i);
+            }
+
+            // Symbols without a size run up to the next function.
+            for (size_t i = 0; i < index->starts.size(); i++)
+            {
+                if(index->ends[i] == index->starts[i])
+                    index->ends[i] = (i + 1 < index->starts.size()) ? index->starts[i + 1] : index->starts[i] + 1;
+            }
+
+            index->tree.resize(index->starts.size() + 1);
+            index->ranks.resize(index->starts.size() + 1);
+            index->fill_tree(0, 1);
+
+            std::vector<uint32_t> allocated;
+            for (size_t i = 0; i < section_headers.size(); i++)
+            {
+                const SectionHeader& section = section_headers[i];
+                uint64_t flags = static_cast<uint64_t>(section.flags);
+
+                // .tbss overlaps whatever follows it, TLS sections have no fixed address anyway.
+                if((flags & static_cast<uint64_t>(SectionAttribute::ALLOC)) && 
+                   !(flags & static_cast<uint64_t>(SectionAttribute::TLS)) && section.size != 0)
+                    allocated.push_back(static_cast<uint32_t>(i));
+            }
+
+            std::sort(allocated.begin(), allocated.end(), [&section_headers](uint32_t a, uint32_t b) {
+                return section_headers[a].addr < section_headers[b].addr;
+            });
+
+            for (uint32_t i : allocated)
+            {
+                index->section_starts.push_back(section_headers[i].addr);
+                index->section_ends.push_back(section_headers[i].addr + section_headers[i].size);
+                index->sections.push_back(i);
+            }
+
+            return index;
+        }
+
+        static inline
+        AddressLookup
+        make_address_lookup(const AddressIndex& index, uint64_t address, size_t function, size_t section)
+        {
+            AddressLookup found;
+
+            if(section != SIZE_MAX && address < index.section_ends[section])
+                found.section = index.sections[section];
+
+            if(function != SIZE_MAX && address < index.ends[function])
+            {
+                const SymbolTable& table = *index.table;
+                uint32_t i = index.symbols[function];
+
+                found.function.section = table.section;
+                found.function.index   = i;
+                found.function.symbol  = Symbol { table.value[i], table.size[i], table.name[i], table.shndx[i], table.info[i], table.other[i] };
+                found.offset           = address - table.value[i];
+            }
+
+            return found;
+        }
+    }
+
+    const details::AddressIndex&
+    Reader::get_address_index() const
+    {
+        if(!address_index)
+        {
+            get_symbol_table();
+            get_dynamic_symbol_table();
+
+            address_index = details::build_address_index(get_section_headers(), 
+                                                         symbol_table->empty() ? dynamic_symbol_table : symbol_table);
+        }
+
+        return *address_index;
+    }
+
+    AddressLookup
+    Reader::symbolize(uint64_t address) const
+    {
+        const details::AddressIndex& index = get_address_index();
+
+        return details::make_address_lookup(index, address, index.predecessor(address), index.section_predecessor(address));
+    }
+
+    std::vector<AddressLookup>
+    Reader::symbolize(const std::vector<uint64_t>& addresses) const
+    {
+        const details::AddressIndex& index = get_address_index();
+        std::vector<AddressLookup> results(addresses.size());
+
+        size_t function = SIZE_MAX;
+        size_t section  = SIZE_MAX;
+
+        for (size_t i = 0; i < addresses.size(); i++)
+        {
+            uint64_t address = addresses[i];
+
+            if(i == 0 || address < addresses[i - 1])
+            {
+                // Out of order, search again from scratch.
+                function = index.predecessor(address);
+                section  = index.section_predecessor(address);
+            }
+            else
+            {
+                // SIZE_MAX + 1 wraps to the first entry.
+                while(function + 1 < index.starts.size() && index.starts[function + 1] <= address)
+                    function++;
+
+                while(section + 1 < index.section_starts.size() && index.section_starts[section + 1] <= address)
+                    section++;
+            }
+
+            results[i] = details::make_address_lookup(index, address, function, section);
+        }
+
+        return results;
+    }
+
+    // ------------------------------------------------------------------------------------------------
+
+    NoteRange::iterator::iterator(ByteView bytes, Endianness endian, size_t alignment)
+        : bytes(bytes), endian(endian), alignment(alignment)
+    {
+        parse();
+    }
+
+    void
+    NoteRange::iterator::parse()
+    {
+        // namesz, descsz and type are 4-byte words in both classes.
+        static constexpr size_t HeaderSize = 12;
+
+        auto align = [this](size_t offset) { return (offset + alignment - 1) & ~(alignment - 1); };
+
+        current = nullptr;
+
+        if(next > bytes.size() || bytes.size() - next < HeaderSize)
+            return;
+
+        const uint8_t* header = bytes.data() + next;
+        uint32_t namesz = details::load<uint32_t>(header, endian);
+        uint32_t descsz = details::load<uint32_t>(header + 4, endian);
+
+        size_t name_offset = next + HeaderSize;
+        if(namesz > bytes.size() - name_offset)
+            return;
+
+        size_t desc_offset = align(name_offset + namesz);
+        if(desc_offset > bytes.size() || descsz > bytes.size() - desc_offset)
+            return;
+
+        // The name counts its terminator, which isn't part of the view.
+        const char* name = reinterpret_cast<const char*>(bytes.data() + name_offset);
+        note.name = std::string_view(name, (namesz && name[namesz - 1] == '\0') ? namesz - 1 : namesz);
+        note.type = details::load<uint32_t>(header + 8, endian);
+        note.desc = bytes.subview(desc_offset, descsz);
+
+        current = header;
+        next    = align(desc_offset + descsz);
+    }
+
+    NoteRange
+    Reader::get_notes(const ProgramHeader& segment) const
+    {
+        return NoteRange(get_segment_data(segment), decoder->endian, segment.align);
+    }
+
+    NoteRange
+    Reader::get_notes(const SectionHeader& section) const
+    {
+        return NoteRange(get_section_data(section), decoder->endian, section.addralign);
+    }
+
+    std::vector<Note>
+    Reader::get_notes() const
+    {
+        std::vector<Note> notes;
+
+        for (const ProgramHeader& segment : get_program_headers())
+        {
+            if(segment.type == SegmentType::NOTE)
+            {
+                NoteRange range = get_notes(segment);
+                notes.insert(notes.end(), range.begin(), range.end());
+            }
+        }
+
+        if(!notes.empty())
+            return notes;
+
+        for (const SectionHeader& section : get_section_headers())
+        {
+            if(section.type == SectionType::NOTE)
+            {
+                NoteRange range = get_notes(section);
+                notes.insert(notes.end(), range.begin(), range.end());
+            }
+        }
+
+        return notes;
+    }
+
+    static inline
+    bool
+    is_build_id(const Note& note)
+    {
+        return note.name == "GNU" && note.type == static_cast<uint32_t>(NoteType::GNU_BUILD_ID);
+    }
+
+    ByteView
+    Reader::get_build_id() const
+    {
+        for (const Note& note : get_notes())
+        {
+            if(is_build_id(note))
+                return note.desc;
+        }
+
+        return ByteView();
+    }
+
+    std::vector<uint8_t>
+    Reader::read_build_id(const std::string& filename)
+    {
+        // Note segments are a few hundred bytes, anything past this is not worth reading.
+        static constexpr uint64_t MaxNoteSize = 1 << 20;
+        // Header tables of millions of entries are not where notes are looked for either.
+        static constexpr uint64_t MaxTableSize = 1 << 28;
+
+        details::FileReader file(filename);
+        if(!file.is_open())
+            return {};
+
+        uint8_t head[ProbeSize];
+        size_t  length = file.read(0, head, sizeof(head));
+
+        const details::Decoder* decoder = nullptr;
+        FileHeader header;
+
+        if(length == SIZE_MAX || validate_file_header(ByteView(head, length), decoder, header) != Error::None)
+            return {};
+
+        details::TableCounts counts;
+        if(resolve_table_counts(header, decoder, file, counts) != Error::None)
+            return {};
+
+        std::vector<uint8_t> table;
+        std::vector<uint8_t> bytes;
+
+        // Looks for the build-ID in the note blocks given as (offset, size, alignment).
+        auto search = [&file, &bytes, decoder](uint64_t offset, uint64_t size, uint64_t alignment) {
+            if(size > MaxNoteSize || !file.read_exact(offset, bytes, size_t(size)))
+                return false;
+
+            for (const Note& note : NoteRange(ByteView(bytes.data(), bytes.size()), decoder->endian, alignment))
+            {
+                if(is_build_id(note))
+                {
+                    bytes.assign(note.desc.begin(), note.desc.end());
+                    return true;
+                }
+            }
+
+            return false;
+        };
+
+        bool has_segments = false;
+
+        uint64_t phsize = uint64_t(counts.phnum) * header.phentsize;
+        uint64_t shsize = uint64_t(counts.shnum) * header.shentsize;
+
+        if(counts.phnum && phsize <= MaxTableSize && file.read_exact(header.phoff, table, size_t(phsize)))
+        {
+            std::vector<ProgramHeader> segments(counts.phnum);
+            decoder->program_headers(table.data(), counts.phnum, header.phentsize, segments.data());
+
+            for (const ProgramHeader& segment : segments)
+            {
+                if(segment.type != SegmentType::NOTE)
+                    continue;
+
+                has_segments = true;
+                if(search(segment.offset, segment.filesz, segment.align))
+                    return bytes;
+            }
+        }
+
+        if(!has_segments && counts.shnum && shsize <= MaxTableSize && file.read_exact(header.shoff, table, size_t(shsize)))
+        {
+            std::vector<SectionHeader> sections(counts.shnum);
+            decoder->section_headers(table.data(), counts.shnum, header.shentsize, sections.data());
+
+            for (const SectionHeader& section : sections)
+            {
+                if(section.type == SectionType::NOTE && search(section.offset, section.size, section.addralign))
+                    return bytes;
+            }
+        }
+
+        return {};
+    }
+
+    // ------------------------------------------------------------------------------------------------
+
+    namespace details {
+        // PT_LOAD segments sorted by virtual address, for translating addresses to file offsets.
+        struct SegmentMap
+        {
+            std::vector<uint64_t> starts;
+            std::vector<uint64_t> sizes;   // p_filesz, the part backed by the file.
+            std::vector<uint64_t> offsets;
+
+            SegmentMap() = default;
+
+            explicit SegmentMap(const std::vector<ProgramHeader>& segments)
+            {
+                std::vector<const ProgramHeader*> loads;
+
+                for (const ProgramHeader& segment : segments)
+                {
+                    if(segment.type == SegmentType::LOAD && segment.filesz != 0)
+                        loads.push_back(&segment);
+                }
+
+                std::sort(loads.begin(), loads.end(), [](const ProgramHeader* a, const ProgramHeader* b) {
+                    return a->vaddr < b->vaddr;
+                });
+
+                for (const ProgramHeader* segment : loads)
+                {
+                    starts.push_back(segment->vaddr);
+                    sizes.push_back(segment->filesz);
+                    offsets.push_back(segment->offset);
+                }
+            }
+
+            // available receives the number of file-backed bytes from address to the segment end.
+            std::optional<uint64_t>
+            translate(uint64_t address, uint64_t* available = nullptr) const
+            {
+                auto it = std::upper_bound(starts.begin(), starts.end(), address);
+                if(it == starts.begin())
+                    return std::nullopt;
+
+                size_t i = size_t(it - starts.begin()) - 1;
+                if(address - starts[i] >= sizes[i])
+                    return std::nullopt;
+
+                if(available != nullptr)
+                    *available = sizes[i] - (address - starts[i]);
+
+                return offsets[i] + (address - starts[i]);
+            }
+        };
+
+        // Entries of the dynamic section with the position of the first entry of every tag.
+        struct DynamicIndex
+        {
+            static constexpr size_t DirectTags = 64;
+
+            std::vector<DynamicEntry> entries;
+
+            // Standard tags are looked up in an array, OS and processor specific ones in a map.
+            int32_t direct[DirectTags];
+            std::unordered_map<int64_t, uint32_t> others;
+
+            ByteView strtab;
+
+            const DynamicEntry*
+            find(DynamicTag tag) const
+            {
+                int64_t value = static_cast<int64_t>(tag);
+
+                if(value >= 0 && value < int64_t(DirectTags))
+                    return (direct[value] >= 0) ? &entries[direct[value]] : nullptr;
+
+                auto it = others.find(value);
+                return (it != others.end()) ? &entries[it->second] : nullptr;
+            }
+        };
+    }
+
+    const details::SegmentMap&
+    Reader::get_segment_map() const
+    {
+        if(!segment_map)
+        {
+            auto map = std::make_shared<details::SegmentMap>(get_program_headers());
+            segment_map = map;
+        }
+
+        return *segment_map;
+    }
+
+    std::optional<uint64_t>
+    Reader::virtual_to_offset(uint64_t address) const
+    {
+        return get_segment_map().translate(address);
+    }
+
+    const details::DynamicIndex&
+    Reader::get_dynamic_index() const
+    {
+        if(dynamic_index)
+            return *dynamic_index;
+
+        auto index = std::make_shared<details::DynamicIndex>();
+        std::fill(std::begin(index->direct), std::end(index->direct), -1);
+
+        // PT_DYNAMIC is what the loader uses, the section is only a fallback.
+        ByteView bytes;
+        bool found = false;
+
+        for (const ProgramHeader& segment : get_program_headers())
+        {
+            if(segment.type == SegmentType::DYNAMIC)
+            {
+                bytes = get_segment_data(segment);
+                found = true;
+                break;
+            }
+        }
+
+        const SectionHeader* section = nullptr;
+
+        for (const SectionHeader& candidate : get_section_headers())
+        {
+            if(candidate.type == SectionType::DYNAMIC)
+            {
+                section = &candidate;
+                break;
+            }
+        }
+
+        if(!found && section != nullptr)
+            bytes = get_section_data(*section);
+
+        size_t count = bytes.size() / decoder->dyn_size;
+        index->entries.resize(count);
+        decoder->dynamic(bytes.data(), count, decoder->dyn_size, index->entries.data());
+
+        for (size_t i = 0; i < count; i++)
+        {
+            if(index->entries[i].tag == DynamicTag::NONE)
+            {
+                index->entries.resize(i);
+                break;
+            }
+        }
+
+        for (size_t i = index->entries.size(); i-- > 0;)
+        {
+            int64_t tag = static_cast<int64_t>(index->entries[i].tag);
+
+            // Walking backwards leaves the first entry of each tag in the index.
+            if(tag >= 0 && tag < int64_t(details::DynamicIndex::DirectTags))
+                index->direct[tag] = static_cast<int32_t>(i);
+            else
+                index->others[tag] = static_cast<uint32_t>(i);
+        }
+
+        // DT_STRTAB is an address, the DYNAMIC section's link covers files without segments.
+        const DynamicEntry* strtab = index->find(DynamicTag::STRTAB);
+        const DynamicEntry* strsz  = index->find(DynamicTag::STRSZ);
+
+        std::optional<uint64_t> offset = strtab ? get_segment_map().translate(strtab->value) : std::nullopt;
+
+        if(offset && strsz && *offset <= data.size())
+            index->strtab = data.subview(*offset, strsz->value);
+        else if(section != nullptr && section->link < get_section_headers().size())
+            index->strtab = get_section_data(get_section_headers()[section->link]);
+
+        dynamic_index = index;
+        return *dynamic_index;
+    }
+
+    const std::vector<DynamicEntry>&
+    Reader::get_dynamic_entries() const
+    {
+        return get_dynamic_index().entries;
+    }
+
+    const DynamicEntry*
+    Reader::find_dynamic_entry(DynamicTag tag) const
+    {
+        return get_dynamic_index().find(tag);
+    }
+
+    std::string_view
+    Reader::get_dynamic_string(uint64_t offset) const
+    {
+        ByteView strtab = get_dynamic_index().strtab;
+
+        if(offset >= strtab.size())
+            throw std::out_of_range("String offset is out of the dynamic string table.");
+
+        const char* first = reinterpret_cast<const char*>(strtab.data()) + offset;
+        const void* nul   = std::memchr(first, '\0', strtab.size() - offset);
+
+        if(nul == nullptr)
+            throw std::out_of_range("String is not terminated inside the dynamic string table.");
+
+        return std::string_view(first, static_cast<const char*>(nul) - first);
+    }
+
+    std::string_view
+    Reader::get_dynamic_string_entry(DynamicTag tag) const
+    {
+        const DynamicEntry* entry = find_dynamic_entry(tag);
+        return entry ? get_dynamic_string(entry->value) : std::string_view();
+    }
+
+    std::vector<std::string_view>
+    Reader::get_needed_libraries() const
+    {
+        std::vector<std::string_view> needed;
+
+        for (const DynamicEntry& entry : get_dynamic_entries())
+        {
+            if(entry.tag == DynamicTag::NEEDED)
+                needed.push_back(get_dynamic_string(entry.value));
+        }
+
+        return needed;
+    }
+
+    std::string_view
+    Reader::get_soname() const
+    {
+        return get_dynamic_string_entry(DynamicTag::SONAME);
+    }
+
+    std::string_view
+    Reader::get_rpath() const
+    {
+        return get_dynamic_string_entry(DynamicTag::RPATH);
+    }
+
+    std::string_view
+    Reader::get_runpath() const
+    {
+        return get_dynamic_string_entry(DynamicTag::RUNPATH);
+    }
+
+    // ------------------------------------------------------------------------------------------------
+
+    const char*
+    to_string(Error error)
+    {
+        switch(error)
+        {
+        case Error::None:                 return "No error.";
+        case Error::OpenFailed:           return "File couldn't be opened.";
+        case Error::MapFailed:            return "File couldn't be mapped.";
+        case Error::TooSmall:             return "File header does not have an expected size.";
+        case Error::NotELF:               return "File is not an ELF file.";
+        case Error::UnsupportedClass:     return "File has an unsupported ELF class.";
+        case Error::UnsupportedByteOrder: return "File has an unsupported byte order.";
+        case Error::UnsupportedVersion:   return "File has an unsupported ELF version.";
+        case Error::BadHeaderSize:        return "File header has unexpected header sizes.";
+        case Error::BadProgramHeaders:    return "Program headers does not have an expected size.";
+        case Error::BadSectionHeaders:    return "Section headers does not have an expected size.";
+        case Error::NotCore:              return "File is not a core dump.";
+        case Error::BadNotes:             return "Note segments are out of the file bounds.";
+        case Error::NotArchive:           return "File is not an ar archive.";
+        case Error::BadArchive:           return "Archive member headers are malformed.";
+        }
+
+        return "Unknown error.";
+    }
+
+    static inline
+    ProbeResult
+    rejected(Error error)
+    {
+        ProbeResult result {};
+        result.error = error;
+        return result;
+    }
+
+    ProbeResult
+    Reader::probe(ByteView bytes)
+    {
+        const details::Decoder* decoder = nullptr;
+        FileHeader header;
+
+        if(Error error = validate_file_header(bytes, decoder, header); error != Error::None)
+            return rejected(error);
+
+        ProbeResult result {};
+        result.file_class = decoder->file_class;
+        result.endian     = decoder->endian;
+        result.type       = header.type;
+        result.machine    = header.machine;
+        result.phnum      = header.phnum;
+        result.shnum      = header.shnum;
+        return result;
+    }
+
+    ProbeResult
+    Reader::probe(const std::string& filename)
+    {
+        details::FileReader file(filename);
+        if(!file.is_open())
+            return rejected(Error::OpenFailed);
+
+        uint8_t buffer[ProbeSize];
+        size_t  length = file.read(0, buffer, sizeof(buffer));
+
+        if(length == SIZE_MAX)
+            return rejected(Error::OpenFailed);
+
+        return probe(ByteView(buffer, length));
+    }
+
+    // ------------------------------------------------------------------------------------------------
+
+    Error
+    Reader::load(LoadMode mode)
+    {
+        if(Error error = read_file_header(); error != Error::None)
+            return error;
+
+        if(mode == LoadMode::Lazy)
+            return Error::None;
+
+        if(mapping)
+        {
+            // Fault in the header tables up front, whatever the hint for the rest of the file is.
+            // The data is a slice of the mapping for archive members.
+            size_t base = static_cast<size_t>(data.data() - mapping->view().data());
+            mapping->advise(base + file_header.phoff, counts.phnum * file_header.phentsize, AccessHint::WillNeed);
+            mapping->advise(base + file_header.shoff, counts.shnum * file_header.shentsize, AccessHint::WillNeed);
+        }
+
+        if(Error error = read_program_headers(); error != Error::None)
+            return error;
+
+        return read_section_headers();
+    }
+
+    OpenResult
+    Reader::open(const std::string& filename, AccessHint hint, LoadMode mode)
+    {
+        details::MappedFile file;
+
+        if(Error error = file.map(filename, hint); error != Error::None)
+            return error;
+
+        // Reject from the mapping itself, a failure allocates nothing.
+        const details::Decoder* decoder = nullptr;
+        FileHeader header;
+
+        if(Error error = validate_file_header(file.view(), decoder, header); error != Error::None)
+            return error;
+
+        Reader reader;
+        reader.mapping = std::make_shared<const details::MappedFile>(std::move(file));
+        reader.data    = reader.mapping->view();
+
+        if(Error error = reader.load(mode); error != Error::None)
+            return error;
+
+        return OpenResult(std::move(reader));
+    }
+
+    OpenResult
+    Reader::open(ByteView bytes, LoadMode mode)
+    {
+        Reader reader;
+        reader.data = bytes;
+
+        if(Error error = reader.load(mode); error != Error::None)
+            return error;
+
+        return OpenResult(std::move(reader));
+    }
+
+    OpenResult
+    Reader::open(std::shared_ptr<const details::MappedFile> mapping, ByteView bytes, LoadMode mode)
+    {
+        Reader reader;
+        reader.mapping = std::move(mapping);
+        reader.data    = bytes;
+
+        if(Error error = reader.load(mode); error != Error::None)
+            return error;
+
+        return OpenResult(std::move(reader));
+    }
+
+    Reader::Reader(const std::string& filename, AccessHint hint, LoadMode mode)
+    {
+        OpenResult result = open(filename, hint, mode);
+        throw_if(result.error());
+
+        *this = std::move(result.value());
+    }
+
+    Reader::Reader(ByteView bytes, LoadMode mode)
+        : data(bytes)
+    {
+        throw_if(load(mode));
+    }
+
+    Reader::Reader(std::shared_ptr<const details::MappedFile> mapping, ByteView bytes, LoadMode mode)
+        : mapping(std::move(mapping)), data(bytes)
+    {
+        throw_if(load(mode));
+    }
+
+    Reader::~Reader() = default;
+
+    // ------------------------------------------------------------------------------------------------
+
+    namespace details {
+        struct IndexRange
+        {
+            uint64_t offset;
+            uint64_t count;
+        };
+
+        // Open addressing slot of a persisted name index, index is the entry + 1, 0 when empty.
+        struct IndexSlot
+        {
+            uint32_t hash;
+            uint32_t index;
+        };
+
+        // Start of every cache entry. Ranges are offsets from the start of the entry, so the
+        // entry can be mapped anywhere.
+        struct IndexHeader
+        {
+            static constexpr char     Magic[8]  = { 'E', 'L', 'F', 'I', 'D', 'X', 0, 0 };
+            static constexpr uint32_t Version   = 1;
+            static constexpr uint32_t ByteOrder = 0x01020304U;
+
+            char       magic[8];
+            uint32_t   version;
+            uint32_t   byte_order;
+            uint32_t   record_sizes[4]; // FileHeader, ProgramHeader, SectionHeader, Symbol
+
+            uint64_t   device;
+            uint64_t   inode;
+            int64_t    mtime;
+            int64_t    mtime_nsec;
+            uint64_t   size;
+
+            FileHeader file_header;
+            uint32_t   symbol_section;
+            uint32_t   padding;
+
+            IndexRange path;
+            IndexRange program_headers;
+            IndexRange section_headers;
+            IndexRange section_slots;
+            IndexRange section_strings;
+            IndexRange symbols;
+            IndexRange symbol_strings;
+            IndexRange symbol_slots;
+            IndexRange function_starts;
+            IndexRange function_ends;
+            IndexRange function_symbols;
+            IndexRange section_starts;
+            IndexRange section_ends;
+            IndexRange sections;
+        };
+
+        static constexpr uint32_t IndexRecordSizes[4] = {
+            sizeof(FileHeader), sizeof(ProgramHeader), sizeof(SectionHeader), sizeof(Symbol)
+        };
+
+        // Identity of the indexed file, false when it can't be read.
+        static inline
+        bool
+        stat_key(const std::string& path, IndexHeader& key)
+        {
+#if defined(READELF_HAS_MMAP)
+            struct stat info;
+            if(::stat(path.c_str(), &info) != 0)
+                return false;
+
+            key.device     = uint64_t(info.st_dev);
+            key.inode      = uint64_t(info.st_ino);
+            key.mtime      = int64_t(info.st_mtim.tv_sec);
+            key.mtime_nsec = int64_t(info.st_mtim.tv_nsec);
+            key.size       = uint64_t(info.st_size);
+            return true;
+#else
+            // Without inodes there is no reliable key, the cache always misses.
+            (void)path; (void)key;
+            return false;
+#endif
+        }
+
+        // Appends 8-byte aligned arrays behind a reserved header.
+        class IndexWriter
+        {
+        public:
+            IndexWriter() : bytes(sizeof(IndexHeader), 0) {}
+
+            template<typename T>
+            IndexRange
+            append(const T* data, size_t count)
+            {
+                static_assert(std::is_trivially_copyable<T>::value, "Index records are copied as bytes.");
+
+                bytes.resize((bytes.size() + 7) & ~size_t(7), 0);
+
+                IndexRange range { bytes.size(), count };
+                const uint8_t* first = reinterpret_cast<const uint8_t*>(data);
+                bytes.insert(bytes.end(), first, first + count * sizeof(T));
+                return range;
+            }
+
+            template<typename T>
+            IndexRange
+            append(const std::vector<T>& values)
+            {
+                return append(values.data(), values.size());
+            }
+
+            IndexRange
+            append(ByteView view)
+            {
+                return append(view.data(), view.size());
+            }
+
+            std::vector<uint8_t> bytes;
+        };
+
+        static inline
+        std::vector<IndexSlot>
+        build_section_slots(const Reader& reader, const std::vector<SectionHeader>& sections)
+        {
+            size_t capacity = 16;
+            while(capacity < sections.size() * 2)
+                capacity <<= 1;
+
+            std::vector<IndexSlot> slots(capacity, IndexSlot { 0, 0 });
+            std::vector<std::string_view> names(capacity);
+            size_t mask = capacity - 1;
+
+            for (size_t i = 0; i < sections.size(); i++)
+            {
+                std::string_view name = reader.get_section_name(sections[i]);
+                uint32_t hash = gnu_hash(name);
+                size_t   slot = hash & mask;
+
+                while(slots[slot].index != 0 && !(slots[slot].hash == hash && names[slot] == name))
+                    slot = (slot + 1) & mask;
+
+                // The first section wins when several share a name, as in find_section().
+                if(slots[slot].index == 0)
+                {
+                    slots[slot] = IndexSlot { hash, static_cast<uint32_t>(i + 1) };
+                    names[slot] = name;
+                }
+            }
+
+            return slots;
+        }
+    }
+
+    IndexCache::IndexCache(std::string directory)
+        : directory(std::move(directory))
+    {
+    }
+
+    std::string
+    IndexCache::entry_path(const std::string& path) const
+    {
+        // FNV-1a of the path, the key itself is checked against the entry header.
+        uint64_t hash = 0xCBF29CE484222325ULL;
+        for (char c : path)
+            hash = (hash ^ uint8_t(c)) * 0x100000001B3ULL;
+
+        static const char digits[] = "0123456789abcdef";
+        std::string name(16, '0');
+
+        for (size_t i = 0; i < 16; i++)
+            name[15 - i] = digits[(hash >> (4 * i)) & 0xF];
+
+        return directory + "/" + name + ".idx";
+    }
+
+    namespace details {
+        // Writes bytes to a new file next to path that no other thread or process can be
+        // writing, returns its name or an empty string on failure.
+        static
+        std::string
+        write_temp_file(const std::string& path, const std::vector<uint8_t>& bytes)
+        {
+#if defined(READELF_HAS_MMAP)
+            // mkstemp() creates the file with O_EXCL under a name nobody else holds.
+            std::string temp = path + ".tmp.XXXXXX";
+            int fd = ::mkstemp(temp.data());
+            if(fd < 0)
+                return std::string();
+
+            const uint8_t* data = bytes.data();
+            size_t         left = bytes.size();
+
+            while(left != 0)
+            {
+                ssize_t written = ::write(fd, data, left);
+                if(written < 0 && errno == EINTR)
+                    continue;
+
+                if(written <= 0)
+                    break;
+
+                data += written;
+                left -= size_t(written);
+            }
+
+            if(::close(fd) != 0 || left != 0)
+            {
+                ::unlink(temp.c_str());
+                return std::string();
+            }
+#else
+            static std::atomic<uint64_t> counter { 0 };
+
+            std::string temp = path + ".tmp." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()))
+                                    + "." + std::to_string(counter++);
+
+            std::ofstream ofs(temp, std::ios::binary | std::ios::out | std::ios::trunc);
+            ofs.write(reinterpret_cast<const char*>(bytes.data()), std::streamsize(bytes.size()));
+            ofs.close();
+
+            if(!ofs)
+            {
+                std::error_code ec;
+                std::filesystem::remove(temp, ec);
+                return std::string();
+            }
+#endif
+            return temp;
+        }
+    }
+
+    bool
+    IndexCache::store(const std::string& path, const Reader& reader) const
+    {
+        details::IndexHeader header {};
+        if(!details::stat_key(path, header))
+            return false;
+
+        std::memcpy(header.magic, details::IndexHeader::Magic, sizeof(header.magic));
+        std::memcpy(header.record_sizes, details::IndexRecordSizes, sizeof(header.record_sizes));
+        header.version     = details::IndexHeader::Version;
+        header.byte_order  = details::IndexHeader::ByteOrder;
+        header.file_header = reader.get_file_header();
+
+        details::IndexWriter writer;
+
+        try
+        {
+            const auto& sections = reader.get_section_headers();
+            const details::AddressIndex& address = reader.get_address_index();
+            const SymbolTable& table = *address.table;
+
+            header.path            = writer.append(path.data(), path.size());
+            header.program_headers = writer.append(reader.get_program_headers());
+            header.section_headers = writer.append(sections);
+
+            if(reader.counts.shstrndx < sections.size())
+            {
+                header.section_slots   = writer.append(details::build_section_slots(reader, sections));
+                header.section_strings = writer.append(reader.get_section_data(sections[reader.counts.shstrndx]));
+            }
+
+            if(!table.empty())
+            {
+                std::vector<Symbol> symbols(table.count());
+                for (size_t i = 0; i < symbols.size(); i++)
+                    symbols[i] = Symbol { table.value[i], table.size[i], table.name[i], table.shndx[i], table.info[i], table.other[i] };
+
+                // The name index over the same table as the address index.
+                auto index = details::build_symbol_index(reader, address.table);
+                std::vector<details::IndexSlot> slots(index->slots.size());
+                for (size_t i = 0; i < slots.size(); i++)
+                    slots[i] = details::IndexSlot { index->slots[i].hash, index->slots[i].index };
+
+                header.symbol_section = table.section;
+                header.symbols        = writer.append(symbols);
+                header.symbol_strings = writer.append(reader.get_section_data(sections.at(table.strtab)));
+                header.symbol_slots   = writer.append(slots);
+            }
+
+            header.function_starts  = writer.append(address.starts);
+            header.function_ends    = writer.append(address.ends);
+            header.function_symbols = writer.append(address.symbols);
+            header.section_starts   = writer.append(address.section_starts);
+            header.section_ends     = writer.append(address.section_ends);
+            header.sections         = writer.append(address.sections);
+        }
+        catch(const std::exception&)
+        {
+            return false;
+        }
+
+        std::memcpy(writer.bytes.data(), &header, sizeof(header));
+
+        std::error_code ec;
+        std::filesystem::create_directories(directory, ec);
+
+        // Write aside and rename over, readers never see a partial entry.
+        std::string entry = entry_path(path);
+        std::string temp  = details::write_temp_file(entry, writer.bytes);
+
+        if(temp.empty())
+            return false;
+
+        std::filesystem::rename(temp, entry, ec);
+        if(ec)
+        {
+            std::filesystem::remove(temp, ec);
+            return false;
+        }
+
+        return true;
+    }
+
+    std::optional<CachedIndex>
+    IndexCache::find(const std::string& path) const
+    {
+        details::IndexHeader key {};
+        if(!details::stat_key(path, key))
+            return std::nullopt;
+
+        CachedIndex index;
+        if(index.file.map(entry_path(path), AccessHint::Random) != Error::None)
+            return std::nullopt;
+
+        ByteView bytes = index.file.view();
+        if(bytes.size() < sizeof(details::IndexHeader))
+            return std::nullopt;
+
+        const auto* header = reinterpret_cast<const details::IndexHeader*>(bytes.data());
+
+        if(std::memcmp(header->magic, details::IndexHeader::Magic, sizeof(header->magic)) != 0 ||
+           header->version != details::IndexHeader::Version ||
+           header->byte_order != details::IndexHeader::ByteOrder ||
+           std::memcmp(header->record_sizes, details::IndexRecordSizes, sizeof(header->record_sizes)) != 0)
+            return std::nullopt;
+
+        if(header->device != key.device || header->inode != key.inode || header->size != key.size ||
+           header->mtime != key.mtime || header->mtime_nsec != key.mtime_nsec)
+            return std::nullopt;
+
+        // Every range has to lie inside the entry, entries are then only bounds checked on use.
+        const std::pair<const details::IndexRange*, size_t> ranges[] = {
+            { &header->path,             1                     },
+            { &header->program_headers,  sizeof(ProgramHeader) },
+            { &header->section_headers,  sizeof(SectionHeader) },
+            { &header->section_slots,    sizeof(details::IndexSlot) },
+            { &header->section_strings,  1                     },
+            { &header->symbols,          sizeof(Symbol)        },
+            { &header->symbol_strings,   1                     },
+            { &header->symbol_slots,     sizeof(details::IndexSlot) },
+            { &header->function_starts,  sizeof(uint64_t)      },
+            { &header->function_ends,    sizeof(uint64_t)      },
+            { &header->function_symbols, sizeof(uint32_t)      },
+            { &header->section_starts,   sizeof(uint64_t)      },
+            { &header->section_ends,     sizeof(uint64_t)      },
+            { &header->sections,         sizeof(uint32_t)      },
+        };
+
+        for (const auto& range : ranges)
+        {
+            if(range.first->offset % 8 != 0 || range.first->offset > bytes.size() ||
+               range.first->count > (bytes.size() - range.first->offset) / range.second)
+                return std::nullopt;
+        }
+
+        auto power_of_two = [](uint64_t n) { return (n & (n - 1)) == 0; };
+
+        if(!power_of_two(header->section_slots.count) || !power_of_two(header->symbol_slots.count) ||
+           header->function_ends.count != header->function_starts.count ||
+           header->function_symbols.count != header->function_starts.count ||
+           header->section_ends.count != header->section_starts.count ||
+           header->sections.count != header->section_starts.count)
+            return std::nullopt;
+
+        // Two paths may share an entry name, the stored one settles it.
+        if(std::string_view(reinterpret_cast<const char*>(bytes.data() + header->path.offset), header->path.count) != path)
+            return std::nullopt;
+
+        index.header = header;
+        return std::optional<CachedIndex>(std::move(index));
+    }
+
+    std::optional<CachedIndex>
+    IndexCache::open(const std::string& path) const
+    {
+        if(auto index = find(path))
+            return index;
+
+        OpenResult reader = Reader::open(path, AccessHint::Normal, LoadMode::Eager);
+        if(!reader || !store(path, reader.value()))
+            return std::nullopt;
+
+        return find(path);
+    }
+
+    // ------------------------------------------------------------------------------------------------
+
+    template<typename T>
+    ArrayView<T>
+    CachedIndex::array(uint64_t offset, uint64_t count) const
+    {
+        return ArrayView<T>(reinterpret_cast<const T*>(file.view().data() + offset), size_t(count));
+    }
+
+    std::string_view
+    CachedIndex::string(uint64_t offset, uint64_t size, uint32_t at) const
+    {
+        if(at >= size)
+            return std::string_view();
+
+        const char* first = reinterpret_cast<const char*>(file.view().data() + offset) + at;
+        const void* nul   = std::memchr(first, '\0', size - at);
+        return nul ? std::string_view(first, static_cast<const char*>(nul) - first) : std::string_view();
+    }
+
+    const FileHeader&
+    CachedIndex::get_file_header() const
+    {
+        return header->file_header;
+    }
+
+    ArrayView<ProgramHeader>
+    CachedIndex::get_program_headers() const
+    {
+        return array<ProgramHeader>(header->program_headers.offset, header->program_headers.count);
+    }
+
+    ArrayView<SectionHeader>
+    CachedIndex::get_section_headers() const
+    {
+        return array<SectionHeader>(header->section_headers.offset, header->section_headers.count);
+    }
+
+    std::string_view
+    CachedIndex::get_section_name(const SectionHeader& section) const
+    {
+        return string(header->section_strings.offset, header->section_strings.count, section.name);
+    }
+
+    std::string_view
+    CachedIndex::get_symbol_name(const Symbol& symbol) const
+    {
+        return string(header->symbol_strings.offset, header->symbol_strings.count, symbol.name);
+    }
+
+    const SectionHeader*
+    CachedIndex::find_section(std::string_view name) const
+    {
+        auto slots    = array<details::IndexSlot>(header->section_slots.offset, header->section_slots.count);
+        auto sections = get_section_headers();
+
+        if(slots.empty())
+            return nullptr;
+
+        uint32_t hash = details::gnu_hash(name);
+        size_t   mask = slots.size() - 1;
+
+        for (size_t i = hash & mask, probes = 0; slots[i].index != 0 && probes < slots.size(); i = (i + 1) & mask, probes++)
+        {
+            size_t section = slots[i].index - 1;
+
+            if(slots[i].hash == hash && section < sections.size() && get_section_name(sections[section]) == name)
+                return &sections[section];
+        }
+
+        return nullptr;
+    }
+
+    SymbolLookup
+    CachedIndex::lookup_symbol(std::string_view name) const
+    {
+        auto slots   = array<details::IndexSlot>(header->symbol_slots.offset, header->symbol_slots.count);
+        auto symbols = array<Symbol>(header->symbols.offset, header->symbols.count);
+
+        if(slots.empty())
+            return SymbolLookup();
+
+        uint32_t hash = details::gnu_hash(name);
+        size_t   mask = slots.size() - 1;
+
+        for (size_t i = hash & mask, probes = 0; slots[i].index != 0 && probes < slots.size(); i = (i + 1) & mask, probes++)
+        {
+            size_t symbol = slots[i].index - 1;
+
+            if(slots[i].hash == hash && symbol < symbols.size() && get_symbol_name(symbols[symbol]) == name)
+            {
+                SymbolLookup found;
+                found.section = header->symbol_section;
+                found.index   = static_cast<uint32_t>(symbol);
+                found.symbol  = symbols[symbol];
+                return found;
+            }
+        }
+
+        return SymbolLookup();
+    }
+
+    AddressLookup
+    CachedIndex::symbolize(uint64_t address) const
+    {
+        auto starts   = array<uint64_t>(header->function_starts.offset, header->function_starts.count);
+        auto ends     = array<uint64_t>(header->function_ends.offset, header->function_ends.count);
+        auto indices  = array<uint32_t>(header->function_symbols.offset, header->function_symbols.count);
+        auto symbols  = array<Symbol>(header->symbols.offset, header->symbols.count);
+
+        auto section_starts = array<uint64_t>(header->section_starts.offset, header->section_starts.count);
+        auto section_ends   = array<uint64_t>(header->section_ends.offset, header->section_ends.count);
+        auto sections       = array<uint32_t>(header->sections.offset, header->sections.count);
+
+        AddressLookup found;
+
+        size_t section = size_t(std::upper_bound(section_starts.begin(), section_starts.end(), address) - section_starts.begin());
+        if(section != 0 && address < section_ends[section - 1])
+            found.section = sections[section - 1];
+
+        size_t function = size_t(std::upper_bound(starts.begin(), starts.end(), address) - starts.begin());
+        if(function != 0 && address < ends[function - 1] && indices[function - 1] < symbols.size())
+        {
+            uint32_t i = indices[function - 1];
+
+            found.function.section = header->symbol_section;
+            found.function.index   = i;
+            found.function.symbol  = symbols[i];
+            found.offset           = address - symbols[i].value;
+        }
+
+        return found;
+    }
+
+    // ------------------------------------------------------------------------------------------------
+
+    struct DecompressionCache::State
+    {
+        struct Key
+        {
+            const details::MappedFile* mapping;
+            uint64_t                   offset;
+
+            inline bool operator==(const Key& other) const { return mapping == other.mapping && offset == other.offset; }
+        };
+
+        struct KeyHash
+        {
+            inline size_t operator()(const Key& key) const
+            {
+                return std::hash<const void*>()(key.mapping) ^ static_cast<size_t>(key.offset * 0x9E3779B97F4A7C15ULL);
+            }
+        };
+
+        struct Entry
+        {
+            Key                                      key;
+            std::weak_ptr<const details::MappedFile> owner;
+            SectionBuffer                            buffer;
+        };
+
+        mutable std::mutex mutex;
+        size_t capacity   = DefaultCapacity;
+        size_t size_limit = DefaultSizeLimit;
+        size_t bytes      = 0;
+
+        // Most recently used first.
+        std::list<Entry> entries;
+        std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+
+        void
+        erase(std::list<Entry>::iterator it)
+        {
+            bytes -= it->buffer.size();
+            index.erase(it->key);
+            entries.erase(it);
+        }
+
+        void
+        evict(size_t limit)
+        {
+            while(bytes > limit && !entries.empty())
+                erase(std::prev(entries.end()));
+        }
+    };
+
+    DecompressionCache::DecompressionCache() : state(std::make_unique<State>()) {}
+    DecompressionCache::~DecompressionCache() = default;
+
+    DecompressionCache&
+    DecompressionCache::instance()
+    {
+        static DecompressionCache cache;
+        return cache;
+    }
+
+    void
+    DecompressionCache::set_capacity(size_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->capacity = bytes;
+        state->evict(bytes);
+    }
+
+    size_t
+    DecompressionCache::get_capacity() const
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        return state->capacity;
+    }
+
+    void
+    DecompressionCache::set_size_limit(size_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->size_limit = bytes;
+    }
+
+    size_t
+    DecompressionCache::get_size_limit() const
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        return state->size_limit;
+    }
+
+    size_t
+    DecompressionCache::size() const
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        return state->bytes;
+    }
+
+    size_t
+    DecompressionCache::count() const
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        return state->entries.size();
+    }
+
+    void
+    DecompressionCache::clear()
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->evict(0);
+    }
+
+    bool
+    DecompressionCache::find(const std::shared_ptr<const details::MappedFile>& mapping, uint64_t offset, SectionBuffer& buffer)
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+
+        auto it = state->index.find(State::Key { mapping.get(), offset });
+        if(it == state->index.end())
+            return false;
+
+        // The caller holds its mapping, so a live owner at the same address is that mapping.
+        // A dead one was replaced by a new mapping at a reused address.
+        if(it->second->owner.expired())
+        {
+            state->erase(it->second);
+            return false;
+        }
+
+        state->entries.splice(state->entries.begin(), state->entries, it->second);
+        buffer = it->second->buffer;
+        return true;
+    }
+
+    SectionBuffer
+    DecompressionCache::insert(const std::shared_ptr<const details::MappedFile>& mapping, uint64_t offset, SectionBuffer buffer)
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        State::Key key { mapping.get(), offset };
+
+        if(auto it = state->index.find(key); it != state->index.end())
+        {
+            // Decompressed by another thread in the meantime, everyone shares the first buffer.
+            if(!it->second->owner.expired())
+                return it->second->buffer;
+
+            state->erase(it->second);
+        }
+
+        if(buffer.size() > state->capacity)
+            return buffer;
+
+        state->evict(state->capacity - buffer.size());
+        state->entries.push_front(State::Entry { key, mapping, buffer });
+        state->index.emplace(key, state->entries.begin());
+        state->bytes += buffer.size();
+
+        return buffer;
+    }
+
+    // ------------------------------------------------------------------------------------------------
+
+    namespace details {
+        // Legacy GNU .zdebug sections: "ZLIB", the big-endian uncompressed size, a zlib stream.
+        static constexpr size_t ZdebugHeaderSize = 12;
+
+        // Neither format can expand data beyond these ratios, a larger ch_size is a corrupt
+        // header. A zstd RLE block turns 4 bytes into at most 128 KiB.
+        static constexpr uint64_t MaxDeflateRatio = 1032;
+        static constexpr uint64_t MaxZstdRatio    = 32768;
+
+        static inline
+        bool
+        has_compressed_flag(const SectionHeader& section)
+        {
+            return static_cast<uint64_t>(section.flags) & static_cast<uint64_t>(SectionAttribute::COMPRESSED);
+        }
+
+        static inline
+        bool
+        has_zdebug_header(ByteView bytes)
+        {
+            return bytes.size() >= ZdebugHeaderSize && std::memcmp(bytes.data(), "ZLIB", 4) == 0;
+        }
+
+#if defined(READELF_HAS_ZLIB)
+        static inline
+        bool
+        inflate_zlib(ByteView src, uint8_t* dst, size_t size)
+        {
+            z_stream stream {};
+            if(inflateInit(&stream) != Z_OK)
+                return false;
+
+            // avail_in and avail_out are 32-bit, larger sections go through in pieces.
+            const uint8_t* in       = src.data();
+            size_t         in_left  = src.size();
+            uint8_t*       out      = dst;
+            size_t         out_left = size;
+            int            status   = Z_OK;
+
+            // inflate() refuses a null output even when there is nothing to write.
+            uint8_t unused = 0;
+            stream.next_out = size ? dst : &unused;
+
+            while(status == Z_OK)
+            {
+                if(stream.avail_in == 0 && in_left != 0)
+                {
+                    size_t piece = std::min<size_t>(in_left, UINT_MAX);
+                    stream.next_in  = const_cast<Bytef*>(in);
+                    stream.avail_in = static_cast<uInt>(piece);
+                    in += piece, in_left -= piece;
+                }
+
+                if(stream.avail_out == 0 && out_left != 0)
+                {
+                    size_t piece = std::min<size_t>(out_left, UINT_MAX);
+                    stream.next_out  = out;
+                    stream.avail_out = static_cast<uInt>(piece);
+                    out += piece, out_left -= piece;
+                }
+
+                status = inflate(&stream, Z_NO_FLUSH);
+            }
+
+            bool complete = status == Z_STREAM_END && stream.avail_out == 0 && out_left == 0;
+            inflateEnd(&stream);
+
+            return complete;
+        }
+#endif
+
+#if defined(READELF_HAS_ZSTD)
+        // Frames that record their size are independent, each goes to a worker and writes its
+        // own slice of the output. Anything else is decompressed in one call.
+        static inline
+        bool
+        inflate_zstd(ByteView src, uint8_t* dst, size_t size, ThreadPool* pool)
+        {
+            struct Frame
+            {
+                size_t input;
+                size_t input_size;
+                size_t output;
+                size_t output_size;
+            };
+
+            std::vector<Frame> frames;
+            size_t input  = 0;
+            size_t output = 0;
+
+            while(pool != nullptr && input < src.size())
+            {
+                size_t length = ZSTD_findFrameCompressedSize(src.data() + input, src.size() - input);
+                if(ZSTD_isError(length))
+                    return false;
+
+                unsigned long long content = ZSTD_getFrameContentSize(src.data() + input, length);
+                if(content == ZSTD_CONTENTSIZE_ERROR || content == ZSTD_CONTENTSIZE_UNKNOWN || content > size - output)
+                {
+                    frames.clear();
+                    break;
+                }
+
+                frames.push_back(Frame { input, length, output, size_t(content) });
+                input  += length;
+                output += size_t(content);
+            }
+
+            if(frames.size() < 2 || output != size)
+            {
+                size_t written = ZSTD_decompress(dst, size, src.data(), src.size());
+                return !ZSTD_isError(written) && written == size;
+            }
+
+            std::atomic<bool> failed { false };
+            ThreadPool::TaskGroup group;
+
+            for (const Frame& frame : frames)
+            {
+                pool->submit(group, [&src, dst, &frame, &failed] {
+                    size_t written = ZSTD_decompress(dst + frame.output, frame.output_size, src.data() + frame.input, frame.input_size);
+                    if(ZSTD_isError(written) || written != frame.output_size)
+                        failed = true;
+                });
+            }
+
+            pool->wait(group);
+            return !failed;
+        }
+#endif
+
+        static inline
+        void
+        decompress(CompressionType type, ByteView src, uint8_t* dst, size_t size, ThreadPool* pool)
+        {
+            bool complete = false;
+            (void)src; (void)dst; (void)size; (void)pool; // unused without either library.
+
+            switch(type)
+            {
+#if defined(READELF_HAS_ZLIB)
+            case CompressionType::ZLIB:
+                complete = inflate_zlib(src, dst, size);
+                break;
+#endif
+#if defined(READELF_HAS_ZSTD)
+            case CompressionType::ZSTD:
+                complete = inflate_zstd(src, dst, size, pool);
+                break;
+#endif
+            default:
+                throw std::runtime_error("Section compression is not supported by this build.");
+            }
+
+            if(!complete)
+                throw std::runtime_error("Compressed section couldn't be decompressed.");
+        }
+    }
+
+    bool
+    Reader::supports_compression(CompressionType type)
+    {
+        switch(type)
+        {
+#if defined(READELF_HAS_ZLIB)
+        case CompressionType::ZLIB: return true;
+#endif
+#if defined(READELF_HAS_ZSTD)
+        case CompressionType::ZSTD: return true;
+#endif
+        default:                    return false;
+        }
+    }
+
+    bool
+    Reader::is_compressed(const SectionHeader& section) const
+    {
+        if(section.type == SectionType::NOBITS)
+            return false;
+
+        if(details::has_compressed_flag(section))
+            return true;
+
+        return details::has_zdebug_header(get_section_data(section)) && get_section_name(section).substr(0, 8) == ".zdebug_";
+    }
+
+    std::optional<CompressionHeader>
+    Reader::get_compression_header(const SectionHeader& section) const
+    {
+        if(!is_compressed(section))
+            return std::nullopt;
+
+        ByteView bytes = get_section_data(section);
+        CompressionHeader header;
+
+        if(details::has_compressed_flag(section))
+        {
+            if(bytes.size() < decoder->chdr_size)
+                throw std::runtime_error("Compressed section is smaller than its header.");
+
+            decoder->compression(bytes.data(), header);
+        }
+        else
+        {
+            header.type      = CompressionType::ZLIB;
+            header.size      = details::load<uint64_t>(bytes.data() + 4, Endianness::Big);
+            header.addralign = 1;
+        }
+
+        return header;
+    }
+
+    SectionBuffer
+    Reader::get_uncompressed_data(const SectionHeader& section, ThreadPool* pool) const
+    {
+        std::optional<CompressionHeader> header = get_compression_header(section);
+        if(!header)
+            return SectionBuffer(get_section_data(section));
+
+        ByteView bytes = get_section_data(section);
+
+        // Keyed by the offset in the whole mapping, archive members share one.
+        uint64_t offset = mapping ? uint64_t(bytes.data() - mapping->view().data()) : 0;
+
+        SectionBuffer cached;
+        if(mapping && DecompressionCache::instance().find(mapping, offset, cached))
+            return cached;
+
+        if(!supports_compression(header->type))
+            throw std::runtime_error("Section compression is not supported by this build.");
+
+        size_t   skip = details::has_compressed_flag(section) ? decoder->chdr_size : details::ZdebugHeaderSize;
+        ByteView payload(bytes.data() + skip, bytes.size() - skip);
+
+        // Checked before allocating, the size comes straight from the file.
+        uint64_t ratio = header->type == CompressionType::ZSTD ? details::MaxZstdRatio : details::MaxDeflateRatio;
+        if(header->size / ratio > payload.size())
+            throw std::runtime_error("Compressed section has an impossible uncompressed size.");
+
+        if(header->size > DecompressionCache::instance().get_size_limit())
+            throw std::runtime_error("Compressed section is larger than the decompression size limit.");
+
+        // Left uninitialized, the decompressor writes every byte and zeroing first costs more than it.
+        size_t size = size_t(header->size);
+        std::shared_ptr<uint8_t[]> buffer(new uint8_t[size ? size : 1]);
+        details::decompress(header->type, payload, buffer.get(), size, pool);
+
+        SectionBuffer result(std::move(buffer), size);
+        if(mapping)
+            result = DecompressionCache::instance().insert(mapping, offset, std::move(result));
+
+        return result;
+    }
+
+    void
+    Reader::decompress_sections(ThreadPool& pool) const
+    {
+        // Nothing would keep the buffers of a reader over caller-owned memory.
+        if(!mapping)
+            return;
+
+        const auto& sections = get_section_headers();
+        ThreadPool::TaskGroup group;
+
+        for (const SectionHeader& section : sections)
+        {
+            if(!is_compressed(section))
+                continue;
+
+            pool.submit(group, [this, &section, &pool] {
+                try
+                {
+                    get_uncompressed_data(section, &pool);
+                }
+                catch(const std::exception&)
+                {
+                    // Reported again when the section is asked for.
+                }
+            });
+        }
+
+        pool.wait(group);
+    }
+
+    // ------------------------------------------------------------------------------------------------
+
+    struct CoreFile::State
+    {
+        // Notes and header tables past these sizes are taken as a corrupt header rather than read.
+        static constexpr uint64_t MaxNoteSize  = 256ULL << 20;
+        static constexpr uint64_t MaxTableSize = 1 << 28;
+
+        mutable details::FileReader file;
+        const details::Decoder*   decoder = nullptr;
+        FileHeader                header;
+        std::vector<ProgramHeader> segments;
+        details::SegmentMap       memory;
+
+        std::vector<std::vector<uint8_t>> notes; // the views below point into these.
+        std::vector<CoreThread>  threads;
+        std::vector<CoreMapping> mappings;
+        std::vector<AuxvEntry>   auxv;
+
+        // Least recently used page at the back.
+        struct Page
+        {
+            uint64_t             offset;
+            std::vector<uint8_t> bytes;
+        };
+
+        mutable std::mutex mutex;
+        mutable std::list<Page> pages;
+        mutable std::unordered_map<uint64_t, std::list<Page>::iterator> page_index;
+        size_t capacity;
+
+        State(const std::string& filename, size_t capacity)
+            : file(filename), capacity(capacity ? capacity : 1) {}
+
+        uint64_t
+        word(const uint8_t* src) const
+        {
+            return (decoder->file_class == FileClass::ELF64) ? details::load<uint64_t>(src, decoder->endian)
+                                                             : details::load<uint32_t>(src, decoder->endian);
+        }
+
+        void parse_prstatus(ByteView desc);
+        void parse_file(ByteView desc);
+        void parse_auxv(ByteView desc);
+
+        // Page at a page aligned file offset, read on a miss. Called with the mutex held.
+        const std::vector<uint8_t>* page(uint64_t offset) const;
+    };
+
+    void
+    CoreFile::State::parse_prstatus(ByteView desc)
+    {
+        // The common elf_prstatus prefix: siginfo (12), pr_cursig (2 + 2 padding), pr_sigpend,
+        // pr_sighold (a word each), four pids (4 each), four timevals (two words each).
+        size_t word_size  = (decoder->file_class == FileClass::ELF64) ? 8 : 4;
+        size_t pid_offset = 16 + 2 * word_size;
+        size_t reg_offset = pid_offset + 16 + 8 * word_size;
+
+        if(desc.size() < reg_offset)
+            return;
+
+        CoreThread thread;
+        thread.pid       = details::load<uint32_t>(desc.data() + pid_offset, decoder->endian);
+        thread.signal    = details::load<uint16_t>(desc.data() + 12, decoder->endian);
+        thread.registers = desc.subview(reg_offset);
+
+        // pr_fpvalid trails the registers, padded to a word.
+        size_t trailer = (word_size == 8) ? 8 : 4;
+        if(thread.registers.size() >= trailer)
+            thread.registers = thread.registers.subview(0, thread.registers.size() - trailer);
+
+        threads.push_back(thread);
+    }
+
+    void
+    CoreFile::State::parse_file(ByteView desc)
+    {
+        // count, page size, count (start, end, page offset) triples, then count paths.
+        size_t word_size = (decoder->file_class == FileClass::ELF64) ? 8 : 4;
+
+        if(desc.size() < 2 * word_size)
+            return;
+
+        uint64_t count     = word(desc.data());
+        uint64_t page_size = word(desc.data() + word_size);
+
+        if(count > (desc.size() - 2 * word_size) / (3 * word_size))
+            return;
+
+        const uint8_t* entry = desc.data() + 2 * word_size;
+        size_t names = 2 * word_size + size_t(count) * 3 * word_size;
+
+        for (uint64_t i = 0; i < count; i++, entry += 3 * word_size)
+        {
+            std::string_view path;
+
+            if(names < desc.size())
+            {
+                const char* first = reinterpret_cast<const char*>(desc.data()) + names;
+                const void* nul   = std::memchr(first, '\0', desc.size() - names);
+
+                size_t length = nul ? size_t(static_cast<const char*>(nul) - first) : desc.size() - names;
+                path   = std::string_view(first, length);
+                names += length + 1;
+            }
+
+            mappings.push_back(CoreMapping { word(entry), word(entry + word_size), word(entry + 2 * word_size) * page_size, path });
+        }
+    }
+
+    void
+    CoreFile::State::parse_auxv(ByteView desc)
+    {
+        size_t word_size = (decoder->file_class == FileClass::ELF64) ? 8 : 4;
+
+        for (size_t offset = 0; offset + 2 * word_size <= desc.size(); offset += 2 * word_size)
+        {
+            AuxvEntry entry { word(desc.data() + offset), word(desc.data() + offset + word_size) };
+
+            // AT_NULL ends the vector.
+            if(entry.type == 0)
+                break;
+
+            auxv.push_back(entry);
+        }
+    }
+
+    const std::vector<uint8_t>*
+    CoreFile::State::page(uint64_t offset) const
+    {
+        auto it = page_index.find(offset);
+
+        if(it != page_index.end())
+        {
+            pages.splice(pages.begin(), pages, it->second);
+            return &it->second->bytes;
+        }
+
+        // Recycle the least recently used page's buffer once the cache is full.
+        Page fresh;
+
+        if(pages.size() >= capacity)
+        {
+            fresh = std::move(pages.back());
+            page_index.erase(fresh.offset);
+            pages.pop_back();
+        }
+
+        fresh.offset = offset;
+        fresh.bytes.resize(PageSize);
+
+        size_t length = file.read(offset, fresh.bytes.data(), PageSize);
+        if(length == SIZE_MAX)
+            return nullptr;
+
+        fresh.bytes.resize(length);
+
+        pages.push_front(std::move(fresh));
+        page_index[offset] = pages.begin();
+        return &pages.front().bytes;
+    }
+
+    CoreFile::CoreFile(const std::string& filename, size_t cache_pages)
+        : state(std::make_unique<State>(filename, cache_pages))
+    {
+        State& core = *state;
+
+        if(!core.file.is_open())
+            throw_if(Error::OpenFailed);
+
+        uint8_t head[Reader::ProbeSize];
+        size_t  length = core.file.read(0, head, sizeof(head));
+
+        if(length == SIZE_MAX)
+            throw_if(Error::OpenFailed);
+
+        throw_if(validate_file_header(ByteView(head, length), core.decoder, core.header));
+
+        if(core.header.type != ObjectFileType::CORE)
+            throw_if(Error::NotCore);
+
+        // Cores of processes with 65535 mappings or more use PN_XNUM.
+        details::TableCounts counts;
+        throw_if(resolve_table_counts(core.header, core.decoder, core.file, counts));
+
+        // Under PN_XNUM the count comes from section 0, which is as easy to forge as e_phnum.
+        uint64_t phsize = uint64_t(counts.phnum) * core.header.phentsize;
+
+        std::vector<uint8_t> table;
+        if(phsize > State::MaxTableSize || !core.file.read_exact(core.header.phoff, table, size_t(phsize)))
+            throw_if(Error::BadProgramHeaders);
+
+        core.segments.resize(counts.phnum);
+        core.decoder->program_headers(table.data(), counts.phnum, core.header.phentsize, core.segments.data());
+
+        core.memory = details::SegmentMap(core.segments);
+
+        for (const ProgramHeader& segment : core.segments)
+        {
+            if(segment.type != SegmentType::NOTE)
+                continue;
+
+            std::vector<uint8_t> bytes;
+            if(segment.filesz > State::MaxNoteSize || !core.file.read_exact(segment.offset, bytes, size_t(segment.filesz)))
+                throw_if(Error::BadNotes);
+
+            core.notes.push_back(std::move(bytes));
+            const std::vector<uint8_t>& stored = core.notes.back();
+
+            for (const Note& note : NoteRange(ByteView(stored.data(), stored.size()), core.decoder->endian, segment.align))
+            {
+                if(note.name != "CORE")
+                    continue;
+
+                switch(static_cast<NoteType>(note.type))
+                {
+                case NoteType::CORE_PRSTATUS: core.parse_prstatus(note.desc); break;
+                case NoteType::CORE_FILE:     core.parse_file(note.desc);     break;
+                case NoteType::CORE_AUXV:     core.parse_auxv(note.desc);     break;
+                default:                                                      break;
+                }
+            }
+        }
+    }
+
+    CoreFile::~CoreFile() = default;
+    CoreFile::CoreFile(CoreFile&&) noexcept = default;
+    CoreFile& CoreFile::operator=(CoreFile&&) noexcept = default;
+
+    const FileHeader&
+    CoreFile::get_file_header() const
+    {
+        return state->header;
+    }
+
+    const std::vector<ProgramHeader>&
+    CoreFile::get_program_headers() const
+    {
+        return state->segments;
+    }
+
+    const std::vector<CoreThread>&
+    CoreFile::get_threads() const
+    {
+        return state->threads;
+    }
+
+    const std::vector<CoreMapping>&
+    CoreFile::get_file_mappings() const
+    {
+        return state->mappings;
+    }
+
+    const std::vector<AuxvEntry>&
+    CoreFile::get_auxv() const
+    {
+        return state->auxv;
+    }
+
+    size_t
+    CoreFile::read_memory(uint64_t address, void* buffer, size_t size) const
+    {
+        uint8_t* dst  = static_cast<uint8_t*>(buffer);
+        size_t   done = 0;
+
+        std::lock_guard<std::mutex> lock(state->mutex);
+
+        while(done < size)
+        {
+            uint64_t available = 0;
+            std::optional<uint64_t> offset = state->memory.translate(address + done, &available);
+
+            if(!offset)
+                break;
+
+            uint64_t base = *offset & ~uint64_t(PageSize - 1);
+            const std::vector<uint8_t>* page = state->page(base);
+
+            size_t in_page = size_t(*offset - base);
+            if(page == nullptr || in_page >= page->size())
+                break;
+
+            size_t count = std::min({ size - done, page->size() - in_page, size_t(std::min<uint64_t>(available, SIZE_MAX)) });
+            std::memcpy(dst + done, page->data() + in_page, count);
+            done += count;
+        }
+
+        return done;
+    }
+
+    size_t
+    CoreFile::get_cached_page_count() const
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        return state->pages.size();
+    }
 }
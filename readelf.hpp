@@ -27,30 +27,157 @@
 #pragma once
 
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <array>
 #include <memory>
 #include <vector>
+#include <iterator>
+#include <optional>
 #include <type_traits>
 #include <climits>
 #include <cstdint>
+#include <cstddef>
 
 // ------------------------------------------------------------------------------------------------
 
 namespace ELF
 {
+    // ------------------------------------------------------------------------------------------------
+
+    // Non-owning view over a contiguous range of bytes, a minimal std::span<const uint8_t>.
+    class ByteView
+    {
+    public:
+        constexpr ByteView() noexcept = default;
+        constexpr ByteView(const uint8_t* ptr, size_t len) noexcept
+            : ptr(ptr), len(len) {}
+
+        constexpr const uint8_t* data()  const noexcept { return ptr; }
+        constexpr size_t         size()  const noexcept { return len; }
+        constexpr bool           empty() const noexcept { return len == 0; }
+
+        constexpr const uint8_t* begin() const noexcept { return ptr; }
+        constexpr const uint8_t* end()   const noexcept { return ptr + len; }
+
+        constexpr uint8_t operator[](size_t i) const noexcept { return ptr[i]; }
+
+        // Returns the bytes in [offset, offset + count), clamped to the end of the view.
+        constexpr ByteView subview(size_t offset, size_t count = SIZE_MAX) const noexcept
+        {
+            if(offset > len)
+                return ByteView();
+
+            return ByteView(ptr + offset, (count > len - offset) ? len - offset : count);
+        }
+
+    private:
+        const uint8_t* ptr = nullptr;
+        size_t         len = 0;
+    };
+
+    // Same for an array of records, as read in place from a mapped index.
+    template<typename T>
+    class ArrayView
+    {
+    public:
+        constexpr ArrayView() noexcept = default;
+        constexpr ArrayView(const T* ptr, size_t len) noexcept
+            : ptr(ptr), len(len) {}
+
+        constexpr const T* data()  const noexcept { return ptr; }
+        constexpr size_t   size()  const noexcept { return len; }
+        constexpr bool     empty() const noexcept { return len == 0; }
+
+        constexpr const T* begin() const noexcept { return ptr; }
+        constexpr const T* end()   const noexcept { return ptr + len; }
+
+        constexpr const T& operator[](size_t i) const noexcept { return ptr[i]; }
+
+    private:
+        const T* ptr = nullptr;
+        size_t   len = 0;
+    };
+
+    // Hints passed to madvise() for the pages of a mapped file.
+    enum class AccessHint
+        : uint8_t
+    {
+        Normal,
+        Random,
+        Sequential,
+        WillNeed
+    };
+
+    // Controls when the program and section header tables are decoded.
+    enum class LoadMode
+        : uint8_t
+    {
+        Eager, // both tables are decoded by the constructor.
+        Lazy   // only the file header is, the tables are decoded on first access.
+               // Opening a file still allocates its shared mapping.
+    };
+
+    // Why a file was rejected.
+    enum class Error
+        : uint8_t
+    {
+        None,
+        OpenFailed,
+        MapFailed,
+        TooSmall,
+        NotELF,
+        UnsupportedClass,
+        UnsupportedByteOrder,
+        UnsupportedVersion,
+        BadHeaderSize,
+        BadProgramHeaders,
+        BadSectionHeaders,
+        NotCore,
+        BadNotes,
+        NotArchive,
+        BadArchive
+    };
+
+    const char* to_string(Error error);
+
     namespace details {
-        static constexpr size_t SysBits = (CHAR_BIT * sizeof(void*));
+        // Read-only mapping of a whole file, released on destruction.
+        class MappedFile
+        {
+        public:
+            MappedFile() = default;
+            MappedFile(MappedFile&& other) noexcept;
+            ~MappedFile();
+
+            MappedFile(const MappedFile&) = delete;
+            MappedFile& operator=(const MappedFile&) = delete;
+
+            // Maps the whole file read-only.
+            Error map(const std::string& filename, AccessHint hint);
 
-        template<typename T32, typename T64>
-        using BitsBasedType = 
-            typename std::conditional<SysBits == 32, T32, T64>::type;
+            inline ByteView view() const { return ByteView(base, length); }
 
-        class EmptyClass {};
-        using ZeroAllocType = EmptyClass[0]; // sizeof(ZeroAllocType) = 0.
+            // Applies a hint to the pages covering [offset, offset + size).
+            void advise(size_t offset, size_t size, AccessHint hint) const;
+
+        private:
+            const uint8_t*       base   = nullptr;
+            size_t               length = 0;
+            std::vector<uint8_t> fallback; // used where mmap is unavailable.
+        };
     }
 
     // ------------------------------------------------------------------------------------------------
 
+    // Identifies the file class, stored in FileHeader::bits.
+    enum class FileClass
+        : uint8_t
+    {
+        ELF32 = 1,
+        ELF64 = 2
+    };
+
     enum class Endianness
         : uint8_t
     {
@@ -177,11 +304,28 @@ namespace ELF
         PHDR    = 0x00000006U,
         TLS     = 0x00000007U,
         LOOS    = 0x60000000U,
+
+        GNU_EH_FRAME = 0x6474E550U, // .eh_frame_hdr, the FDE search table.
+        GNU_STACK    = 0x6474E551U,
+        GNU_RELRO    = 0x6474E552U,
+        GNU_PROPERTY = 0x6474E553U,
+
         HIOS    = 0x6FFFFFFFU,
         LOPROC  = 0x70000000U,
         HIPROC  = 0x7FFFFFFFU
     };
 
+    // Permissions of a segment, p_flags.
+    enum class SegmentFlag
+        : uint32_t
+    {
+        EXECUTE  = 0x1U,
+        WRITE    = 0x2U,
+        READ     = 0x4U,
+        MASKOS   = 0x0FF00000U,
+        MASKPROC = 0xF0000000U
+    };
+
     // ------------------------------------------------------------------------------------------------
 
     // Identifies the type of the section header.
@@ -205,12 +349,16 @@ namespace ELF
         PREINIT_ARRAY = 0x10U,
         GROUP         = 0x11U,
         SYMTAB_SHNDX  = 0x12U,
-        NUM           = 0x13U
+        NUM           = 0x13U,
+        GNU_HASH      = 0x6FFFFFF6U,
+        GNU_VERDEF    = 0x6FFFFFFDU,
+        GNU_VERNEED   = 0x6FFFFFFEU,
+        GNU_VERSYM    = 0x6FFFFFFFU
     };
 
     // 	Identifies the attributes of the section.
     enum class SectionAttribute
-        : details::BitsBasedType<uint32_t, uint64_t>
+        : uint64_t
     {
         WRITE            = 0x1U,
         ALLOC            = 0x2U,
@@ -222,88 +370,1029 @@ namespace ELF
         OS_NONCONFORMING = 0x100U,
         GROUP            = 0x200U,
         TLS              = 0x400U,
+        COMPRESSED       = 0x800U,
         MASKOS           = 0x0FF00000U,
         MASKPROC         = 0xF0000000U,
         ORDERED          = 0x4000000U,
         EXCLUDE          = 0x8000000U
     };
 
+    // Reserved section indices.
+    enum class SectionIndex
+        : uint16_t
+    {
+        UNDEF     = 0x0000U,
+        LORESERVE = 0xFF00U,
+        ABS       = 0xFFF1U,
+        COMMON    = 0xFFF2U,
+        XINDEX    = 0xFFFFU
+    };
+
+    // ------------------------------------------------------------------------------------------------
+
+    // Identifies the type of a dynamic section entry.
+    enum class DynamicTag
+        : int64_t
+    {
+        NONE            = 0,
+        NEEDED          = 1,
+        PLTRELSZ        = 2,
+        PLTGOT          = 3,
+        HASH            = 4,
+        STRTAB          = 5,
+        SYMTAB          = 6,
+        RELA            = 7,
+        RELASZ          = 8,
+        RELAENT         = 9,
+        STRSZ           = 10,
+        SYMENT          = 11,
+        INIT            = 12,
+        FINI            = 13,
+        SONAME          = 14,
+        RPATH           = 15,
+        SYMBOLIC        = 16,
+        REL             = 17,
+        RELSZ           = 18,
+        RELENT          = 19,
+        PLTREL          = 20,
+        DEBUG           = 21,
+        TEXTREL         = 22,
+        JMPREL          = 23,
+        BIND_NOW        = 24,
+        INIT_ARRAY      = 25,
+        FINI_ARRAY      = 26,
+        INIT_ARRAYSZ    = 27,
+        FINI_ARRAYSZ    = 28,
+        RUNPATH         = 29,
+        FLAGS           = 30,
+        PREINIT_ARRAY   = 32,
+        PREINIT_ARRAYSZ = 33,
+        SYMTAB_SHNDX    = 34,
+        LOOS            = 0x6000000D,
+        HIOS            = 0x6FFFF000,
+        GNU_HASH        = 0x6FFFFEF5,
+        VERSYM          = 0x6FFFFFF0,
+        RELACOUNT       = 0x6FFFFFF9,
+        RELCOUNT        = 0x6FFFFFFA,
+        FLAGS_1         = 0x6FFFFFFB,
+        VERDEF          = 0x6FFFFFFC,
+        VERDEFNUM       = 0x6FFFFFFD,
+        VERNEED         = 0x6FFFFFFE,
+        VERNEEDNUM      = 0x6FFFFFFF,
+        LOPROC          = 0x70000000,
+        HIPROC          = 0x7FFFFFFF
+    };
+
+    // Bits of the DT_FLAGS entry.
+    enum class DynamicFlag
+        : uint64_t
+    {
+        ORIGIN     = 0x01U,
+        SYMBOLIC   = 0x02U,
+        TEXTREL    = 0x04U,
+        BIND_NOW   = 0x08U,
+        STATIC_TLS = 0x10U
+    };
+
+    // ------------------------------------------------------------------------------------------------
+
+    // Identifies the binding of a symbol, the high nibble of st_info.
+    enum class SymbolBinding
+        : uint8_t
+    {
+        LOCAL  = 0x0U,
+        GLOBAL = 0x1U,
+        WEAK   = 0x2U,
+        LOOS   = 0xAU,
+        HIOS   = 0xCU,
+        LOPROC = 0xDU,
+        HIPROC = 0xFU
+    };
+
+    // Identifies the type of a symbol, the low nibble of st_info.
+    enum class SymbolType
+        : uint8_t
+    {
+        NOTYPE  = 0x0U,
+        OBJECT  = 0x1U,
+        FUNC    = 0x2U,
+        SECTION = 0x3U,
+        FILE    = 0x4U,
+        COMMON  = 0x5U,
+        TLS     = 0x6U,
+        LOOS    = 0xAU,
+        IFUNC   = 0xAU, // GNU indirect function.
+        HIOS    = 0xCU,
+        LOPROC  = 0xDU,
+        HIPROC  = 0xFU
+    };
+
     // ------------------------------------------------------------------------------------------------
 
+    // The headers below are decoded from either class into the same layout,
+    // addresses and offsets are widened to 64 bits.
+
     struct FileHeader
     {          
-        uint8_t                                    magic[4];          
-        uint8_t                                    bits; // class
-        Endianness                                 endian;
-        uint8_t                                    version1;
-        ABIType                                    osabi;
-        uint8_t                                    abiver;
-        uint8_t                                    unused[7];
-        ObjectFileType                             type;
-        InstructionSetArchitectureType             machine;
-        uint32_t                                   version2;
-        details::BitsBasedType<uint32_t, uint64_t> entry;
-        details::BitsBasedType<uint32_t, uint64_t> phoff;
-        details::BitsBasedType<uint32_t, uint64_t> shoff;
-        uint32_t                                   flags;
-        uint16_t                                   ehsize;
-        uint16_t                                   phentsize;
-        uint16_t                                   phnum;
-        uint16_t                                   shentsize;
-        uint16_t                                   shnum;
-        uint16_t                                   shstrndx;
+        uint8_t                        magic[4];          
+        uint8_t                        bits; // class
+        Endianness                     endian;
+        uint8_t                        version1;
+        ABIType                        osabi;
+        uint8_t                        abiver;
+        uint8_t                        unused[7];
+        ObjectFileType                 type;
+        InstructionSetArchitectureType machine;
+        uint32_t                       version2;
+        uint64_t                       entry;
+        uint64_t                       phoff;
+        uint64_t                       shoff;
+        uint32_t                       flags;
+        uint16_t                       ehsize;
+        uint16_t                       phentsize;
+        uint16_t                       phnum;
+        uint16_t                       shentsize;
+        uint16_t                       shnum;
+        uint16_t                       shstrndx;
     };
 
     struct ProgramHeader
     {
-        SegmentType                                              type;
-        details::BitsBasedType<details::ZeroAllocType, uint32_t> flags64; // flags for 64bit
-        details::BitsBasedType<uint32_t, uint64_t>               offset;
-        details::BitsBasedType<uint32_t, uint64_t>               vaddr;
-        details::BitsBasedType<uint32_t, uint64_t>               paddr;
-        details::BitsBasedType<uint32_t, uint64_t>               filesz;
-        details::BitsBasedType<uint32_t, uint64_t>               memsz;
-        details::BitsBasedType<uint32_t, details::ZeroAllocType> flags32; // flags for 32bit
-        details::BitsBasedType<uint32_t, uint64_t>               align;
+        SegmentType type;
+        uint32_t    flags;
+        uint64_t    offset;
+        uint64_t    vaddr;
+        uint64_t    paddr;
+        uint64_t    filesz;
+        uint64_t    memsz;
+        uint64_t    align;
     };
 
     struct SectionHeader
     {
-        uint32_t                                   name;
-        SectionType                                type;
-        SectionAttribute                           flags;
-        details::BitsBasedType<uint32_t, uint64_t> addr;
-        details::BitsBasedType<uint32_t, uint64_t> offset;
-        details::BitsBasedType<uint32_t, uint64_t> size;
-        uint32_t                                   link;
-        uint32_t                                   info;
-        details::BitsBasedType<uint32_t, uint64_t> addralign;
-        details::BitsBasedType<uint32_t, uint64_t> entsize;
+        uint32_t         name;
+        SectionType      type;
+        SectionAttribute flags;
+        uint64_t         addr;
+        uint64_t         offset;
+        uint64_t         size;
+        uint32_t         link;
+        uint32_t         info;
+        uint64_t         addralign;
+        uint64_t         entsize;
+    };
+
+    // A single decoded symbol.
+    struct Symbol
+    {
+        uint64_t value;
+        uint64_t size;
+        uint32_t name;
+        uint32_t shndx;
+        uint8_t  info;
+        uint8_t  other;
+    };
+
+    // Result of a symbol lookup, section is the symbol table the symbol was found in.
+    struct SymbolLookup
+    {
+        uint32_t section = 0; // 0 when nothing was found.
+        uint32_t index   = 0;
+        Symbol   symbol  = {};
+
+        inline explicit operator bool() const { return section != 0; }
+    };
+
+    // Result of symbolizing an address.
+    struct AddressLookup
+    {
+        uint32_t     section  = 0; // allocated section containing the address, 0 when none does.
+        SymbolLookup function = {}; // function containing the address, empty when none does.
+        uint64_t     offset   = 0; // distance from the start of the function.
+    };
+
+    // Symbols of one table stored column by column, so that a scan over a single
+    // field only touches that field. Names are offsets into the linked string table.
+    struct SymbolTable
+    {
+        std::vector<uint64_t> value;
+        std::vector<uint64_t> size;
+        std::vector<uint32_t> name;
+        std::vector<uint32_t> shndx;
+        std::vector<uint8_t>  info;
+        std::vector<uint8_t>  other;
+
+        uint32_t section = 0; // index of the symbol table section.
+        uint32_t strtab  = 0; // index of the linked string table section.
+
+        inline size_t count() const { return value.size(); }
+        inline bool   empty() const { return value.empty(); }
+
+        inline SymbolBinding binding(size_t i) const { return static_cast<SymbolBinding>(info[i] >> 4); }
+        inline SymbolType    type(size_t i)    const { return static_cast<SymbolType>(info[i] & 0xFU); }
+
+        // Indices of the symbols of the given type whose size is above min_size.
+        std::vector<uint32_t> select(SymbolType type, uint64_t min_size = 0) const;
+    };
+
+    struct DynamicEntry
+    {
+        DynamicTag tag;
+        uint64_t   value;
+    };
+
+    // Types of the notes named "GNU" and of those named "CORE", which reuse the same numbers.
+    enum class NoteType
+        : uint32_t
+    {
+        GNU_ABI_TAG         = 1,
+        GNU_HWCAP           = 2,
+        GNU_BUILD_ID        = 3,
+        GNU_GOLD_VERSION    = 4,
+        GNU_PROPERTY_TYPE_0 = 5,
+
+        CORE_PRSTATUS       = 1,
+        CORE_FPREGSET       = 2,
+        CORE_PRPSINFO       = 3,
+        CORE_AUXV           = 6,
+        CORE_FILE           = 0x46494C45U,
+        CORE_SIGINFO        = 0x53494749U
+    };
+
+    struct Note
+    {
+        std::string_view name;
+        uint32_t         type;
+        ByteView         desc;
+    };
+
+    // Walks the notes of one PT_NOTE segment or NOTE section, whose entries are aligned to
+    // 4 or 8 bytes. A truncated note ends the walk.
+    class NoteRange
+    {
+    public:
+        class iterator
+        {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type        = Note;
+            using difference_type   = std::ptrdiff_t;
+            using pointer           = const Note*;
+            using reference         = const Note&;
+
+            iterator() = default;
+
+            inline const Note& operator*()  const { return note; }
+            inline const Note* operator->() const { return &note; }
+
+            inline iterator& operator++() { parse(); return *this; }
+            inline iterator  operator++(int) { iterator old = *this; parse(); return old; }
+
+            inline bool operator==(const iterator& other) const { return current == other.current; }
+            inline bool operator!=(const iterator& other) const { return current != other.current; }
+
+        private:
+            friend class NoteRange;
+
+            iterator(ByteView bytes, Endianness endian, size_t alignment);
+
+            // Decodes the note at next, or turns into the end iterator.
+            void parse();
+
+            ByteView       bytes;
+            Endianness     endian    = Endianness::Little;
+            size_t         alignment = 4;
+            size_t         next      = 0;
+            const uint8_t* current   = nullptr;
+            Note           note {};
+        };
+
+        NoteRange() = default;
+        NoteRange(ByteView bytes, Endianness endian, size_t alignment)
+            : bytes(bytes), endian(endian), alignment((alignment == 8) ? 8 : 4) {}
+
+        inline iterator begin() const { return iterator(bytes, endian, alignment); }
+        inline iterator end()   const { return iterator(); }
+
+    private:
+        ByteView   bytes;
+        Endianness endian    = Endianness::Little;
+        size_t     alignment = 4;
+    };
+
+    // Relocations of one REL or RELA section stored column by column.
+    struct RelocationTable
+    {
+        std::vector<uint64_t> offset;
+        std::vector<uint32_t> type;
+        std::vector<uint32_t> symbol;
+        std::vector<int64_t>  addend; // 0 in REL sections, the addend is then stored at the target.
+
+        // Number of relocations of every type below 256, indexed by type. Larger types are
+        // (type, count) pairs sorted by type, so a stray r_info can't size a table.
+        std::vector<uint64_t>                      type_counts;
+        std::vector<std::pair<uint32_t, uint64_t>> large_type_counts;
+
+        uint32_t section = 0; // index of the relocation section.
+        uint32_t symtab  = 0; // index of the symbol table the symbols refer to.
+        uint32_t target  = 0; // index of the section being relocated.
+        bool     rela    = false;
+
+        inline size_t count() const { return offset.size(); }
+        inline bool   empty() const { return offset.empty(); }
+
+        uint64_t count_of(uint32_t type) const;
+    };
+
+    // ch_type of a compression header.
+    enum class CompressionType
+        : uint32_t
+    {
+        ZLIB   = 1,
+        ZSTD   = 2,
+        LOOS   = 0x60000000U,
+        HIOS   = 0x6FFFFFFFU,
+        LOPROC = 0x70000000U,
+        HIPROC = 0x7FFFFFFFU
+    };
+
+    // Elf_Chdr at the start of an SHF_COMPRESSED section, decoded from either class.
+    struct CompressionHeader
+    {
+        CompressionType type;
+        uint64_t        size;      // of the uncompressed data.
+        uint64_t        addralign;
+    };
+
+    // Uncompressed contents of a section: a view of the file, or a decompressed buffer which
+    // stays alive for as long as this does, whatever the cache evicts in the meantime.
+    class SectionBuffer
+    {
+    public:
+        SectionBuffer() = default;
+        explicit SectionBuffer(ByteView view) : view(view) {}
+        SectionBuffer(std::shared_ptr<const uint8_t[]> buffer, size_t size)
+            : owner(std::move(buffer)), view(owner.get(), size) {}
+
+        inline ByteView       bytes() const { return view; }
+        inline const uint8_t* data()  const { return view.data(); }
+        inline size_t         size()  const { return view.size(); }
+        inline bool           empty() const { return view.size() == 0; }
+
+        // True when the contents were decompressed rather than read in place.
+        inline bool is_decompressed() const { return owner != nullptr; }
+
+    private:
+        std::shared_ptr<const uint8_t[]> owner;
+        ByteView view;
     };
 
     // ------------------------------------------------------------------------------------------------
 
+    namespace details {
+        static constexpr size_t IdentSize = 16;
+
+        struct SymbolIndex;
+        struct AddressIndex;
+        struct DynamicIndex;
+        struct SegmentMap;
+        struct IndexHeader;
+
+        // On-disk layouts of a 32 bit ELF file.
+        struct Elf32
+        {
+            using Addr  = uint32_t;
+            using Off   = uint32_t;
+            using XWord = uint32_t;
+
+            static constexpr FileClass file_class = FileClass::ELF32;
+
+            // r_info packs the symbol index above the relocation type.
+            static constexpr unsigned relocation_symbol_shift = 8;
+            static constexpr XWord    relocation_type_mask    = 0xFFU;
+
+            struct FileHeader
+            {
+                uint8_t  ident[IdentSize];
+                uint16_t type;
+                uint16_t machine;
+                uint32_t version;
+                Addr     entry;
+                Off      phoff;
+                Off      shoff;
+                uint32_t flags;
+                uint16_t ehsize;
+                uint16_t phentsize;
+                uint16_t phnum;
+                uint16_t shentsize;
+                uint16_t shnum;
+                uint16_t shstrndx;
+            };
+
+            struct ProgramHeader
+            {
+                uint32_t type;
+                Off      offset;
+                Addr     vaddr;
+                Addr     paddr;
+                uint32_t filesz;
+                uint32_t memsz;
+                uint32_t flags;
+                uint32_t align;
+            };
+
+            struct SectionHeader
+            {
+                uint32_t name;
+                uint32_t type;
+                XWord    flags;
+                Addr     addr;
+                Off      offset;
+                XWord    size;
+                uint32_t link;
+                uint32_t info;
+                XWord    addralign;
+                XWord    entsize;
+            };
+
+            struct Symbol
+            {
+                uint32_t name;
+                Addr     value;
+                uint32_t size;
+                uint8_t  info;
+                uint8_t  other;
+                uint16_t shndx;
+            };
+
+            struct Rel
+            {
+                Addr  offset;
+                XWord info;
+            };
+
+            struct Rela
+            {
+                Addr    offset;
+                XWord   info;
+                int32_t addend;
+            };
+
+            struct Dyn
+            {
+                int32_t  tag;
+                uint32_t value;
+            };
+
+            struct Chdr
+            {
+                uint32_t type;
+                uint32_t size;
+                uint32_t addralign;
+            };
+        };
+
+        // On-disk layouts of a 64 bit ELF file, flags moved next to the type in program headers.
+        struct Elf64
+        {
+            using Addr  = uint64_t;
+            using Off   = uint64_t;
+            using XWord = uint64_t;
+
+            static constexpr FileClass file_class = FileClass::ELF64;
+
+            // r_info packs the symbol index above the relocation type.
+            static constexpr unsigned relocation_symbol_shift = 32;
+            static constexpr XWord    relocation_type_mask    = 0xFFFFFFFFU;
+
+            struct FileHeader
+            {
+                uint8_t  ident[IdentSize];
+                uint16_t type;
+                uint16_t machine;
+                uint32_t version;
+                Addr     entry;
+                Off      phoff;
+                Off      shoff;
+                uint32_t flags;
+                uint16_t ehsize;
+                uint16_t phentsize;
+                uint16_t phnum;
+                uint16_t shentsize;
+                uint16_t shnum;
+                uint16_t shstrndx;
+            };
+
+            struct ProgramHeader
+            {
+                uint32_t type;
+                uint32_t flags;
+                Off      offset;
+                Addr     vaddr;
+                Addr     paddr;
+                XWord    filesz;
+                XWord    memsz;
+                XWord    align;
+            };
+
+            struct SectionHeader
+            {
+                uint32_t name;
+                uint32_t type;
+                XWord    flags;
+                Addr     addr;
+                Off      offset;
+                XWord    size;
+                uint32_t link;
+                uint32_t info;
+                XWord    addralign;
+                XWord    entsize;
+            };
+
+            struct Symbol
+            {
+                uint32_t name;
+                uint8_t  info;
+                uint8_t  other;
+                uint16_t shndx;
+                Addr     value;
+                XWord    size;
+            };
+
+            struct Rel
+            {
+                Addr  offset;
+                XWord info;
+            };
+
+            struct Rela
+            {
+                Addr    offset;
+                XWord   info;
+                int64_t addend;
+            };
+
+            struct Dyn
+            {
+                int64_t  tag;
+                uint64_t value;
+            };
+
+            struct Chdr
+            {
+                uint32_t type;
+                uint32_t reserved;
+                uint64_t size;
+                uint64_t addralign;
+            };
+        };
+
+        static_assert(sizeof(Elf32::FileHeader)    == 52, "Unexpected ELF32 file header size.");
+        static_assert(sizeof(Elf32::ProgramHeader) == 32, "Unexpected ELF32 program header size.");
+        static_assert(sizeof(Elf32::SectionHeader) == 40, "Unexpected ELF32 section header size.");
+        static_assert(sizeof(Elf64::FileHeader)    == 64, "Unexpected ELF64 file header size.");
+        static_assert(sizeof(Elf64::ProgramHeader) == 56, "Unexpected ELF64 program header size.");
+        static_assert(sizeof(Elf64::SectionHeader) == 64, "Unexpected ELF64 section header size.");
+        static_assert(sizeof(Elf32::Symbol)        == 16, "Unexpected ELF32 symbol size.");
+        static_assert(sizeof(Elf64::Symbol)        == 24, "Unexpected ELF64 symbol size.");
+        static_assert(sizeof(Elf32::Rela)          == 12, "Unexpected ELF32 relocation size.");
+        static_assert(sizeof(Elf64::Rela)          == 24, "Unexpected ELF64 relocation size.");
+        static_assert(sizeof(Elf32::Chdr)          == 12, "Unexpected ELF32 compression header size.");
+        static_assert(sizeof(Elf64::Chdr)          == 24, "Unexpected ELF64 compression header size.");
+
+        // Table decoders of one file class and byte order, picked once when the file header is read.
+        struct Decoder
+        {
+            FileClass  file_class;
+            Endianness endian;
+            size_t    file_header_size;
+            size_t    program_header_size;
+            size_t    section_header_size;
+            size_t    symbol_size;
+            size_t    rel_size;
+            size_t    rela_size;
+            size_t    dyn_size;
+            size_t    chdr_size;
+
+            void (*file_header)    (const uint8_t* src, FileHeader& dst);
+            void (*program_headers)(const uint8_t* src, size_t count, size_t entsize, ProgramHeader* dst);
+            void (*section_headers)(const uint8_t* src, size_t count, size_t entsize, SectionHeader* dst);
+            void (*symbols)        (const uint8_t* src, size_t count, size_t entsize, SymbolTable& dst);
+            void (*symbol)         (const uint8_t* src, Symbol& dst);
+            void (*rels)           (const uint8_t* src, size_t count, size_t entsize, RelocationTable& dst);
+            void (*relas)          (const uint8_t* src, size_t count, size_t entsize, RelocationTable& dst);
+            void (*dynamic)        (const uint8_t* src, size_t count, size_t entsize, DynamicEntry* dst);
+            void (*compression)    (const uint8_t* src, CompressionHeader& dst);
+        };
+
+        // e_phnum value telling that the real count is in sh_info of section 0.
+        static constexpr uint16_t ExtendedPhnum = 0xFFFFU;
+
+        // Table sizes with the overflows into section 0 resolved (e_shnum of 0, SHN_XINDEX, PN_XNUM).
+        struct TableCounts
+        {
+            size_t phnum    = 0;
+            size_t shnum    = 0;
+            size_t shstrndx = 0;
+        };
+    }
+
+    // ------------------------------------------------------------------------------------------------
+
+
+    // Compact summary of a file header, filled by Reader::probe().
+    struct ProbeResult
+    {
+        Error                          error   = Error::None;
+        FileClass                      file_class;
+        Endianness                     endian;
+        ObjectFileType                 type;
+        InstructionSetArchitectureType machine;
+        uint16_t                       phnum; // As stored in the file header, 0xFFFF and 0 when
+        uint16_t                       shnum; // the real counts are kept in section 0.
+
+        inline explicit operator bool() const { return error == Error::None; }
+    };
+
+    // ------------------------------------------------------------------------------------------------
+
+    class OpenResult;
+    class IndexCache;
+    class ThreadPool;
+
     class Reader
     {
     public:
-        Reader(const std::string& filename);
+        // Size of the largest file header, all probe() ever reads.
+        static constexpr size_t ProbeSize = 64;
+
+        // Validates magic, class, byte order, version and header sizes from the first
+        // ProbeSize bytes of a file, read with a single pread(). Never throws.
+        static ProbeResult probe(const std::string& filename);
+        static ProbeResult probe(ByteView bytes);
+
+        // Maps the file read-only, nothing is copied out of it.
+        Reader(const std::string& filename, AccessHint hint = AccessHint::Normal, LoadMode mode = LoadMode::Eager);
+        // Reads from caller-owned memory which has to outlive the reader.
+        Reader(ByteView bytes, LoadMode mode = LoadMode::Eager);
+        // Reads a slice of a mapping the reader shares, such as one member of an archive.
+        Reader(std::shared_ptr<const details::MappedFile> mapping, ByteView bytes, LoadMode mode = LoadMode::Eager);
         ~Reader();
 
+        Reader(const Reader&) = default;
+        Reader(Reader&&) = default;
+        Reader& operator=(const Reader&) = default;
+        Reader& operator=(Reader&&) = default;
+
+        // Same as the constructors, but report a rejected file through the result instead
+        // of throwing. Nothing is allocated for a file that fails the header checks. An
+        // accepted file costs one allocation even when lazy: the shared MappedFile, which
+        // archive members, copies of the Reader and the decompression cache hold on to.
+        static OpenResult open(const std::string& filename, AccessHint hint = AccessHint::Normal, LoadMode mode = LoadMode::Eager);
+        static OpenResult open(ByteView bytes, LoadMode mode = LoadMode::Eager);
+        static OpenResult open(std::shared_ptr<const details::MappedFile> mapping, ByteView bytes, LoadMode mode = LoadMode::Eager);
+
+        inline ByteView get_data() const { return data; }
+
         inline const FileHeader& get_file_header() const { return file_header; }
-        inline const std::vector<ProgramHeader>& get_program_headers() const { return program_headers; }
-        inline const std::vector<SectionHeader>& get_section_headers() const { return section_headers; }
+
+        // The whole tables, decoded on first call in LoadMode::Lazy.
+        const std::vector<ProgramHeader>& get_program_headers() const;
+        const std::vector<SectionHeader>& get_section_headers() const;
+
+        // Real table sizes, also for files with more entries than the file header can count.
+        inline size_t get_program_header_count() const { return counts.phnum; }
+        inline size_t get_section_header_count() const { return counts.shnum; }
+        inline size_t get_section_name_index()   const { return counts.shstrndx; }
+
+        // Decodes a single entry straight from the file without building the table.
+        ProgramHeader get_program_header(size_t index) const;
+        SectionHeader get_section_header(size_t index) const;
+
+        // Contents of a section as stored, empty for NOBITS sections.
+        ByteView get_section_data(const SectionHeader& section) const;
+
+        // SHF_COMPRESSED sections and GNU .zdebug ones, whose header is read as a ZLIB one.
+        bool is_compressed(const SectionHeader& section) const;
+        std::optional<CompressionHeader> get_compression_header(const SectionHeader& section) const;
+
+        // Contents of a section with any compression undone. Decompressed buffers go into the
+        // process-wide DecompressionCache, so only the first access pays for the inflate.
+        // zstd sections of several frames are decompressed frame by frame on the pool, if given.
+        // Throws std::runtime_error for corrupt data or a compression this build can't read.
+        SectionBuffer get_uncompressed_data(const SectionHeader& section, ThreadPool* pool = nullptr) const;
+
+        // Decompresses every compressed section into the cache, one section per pool task.
+        void decompress_sections(ThreadPool& pool) const;
+
+        // Whether this build links the library for the compression type.
+        static bool supports_compression(CompressionType type);
+        // File-backed bytes of a segment, p_filesz long.
+        ByteView get_segment_data(const ProgramHeader& segment) const;
+
+        // First segment of the given type, nullptr when there is none.
+        const ProgramHeader* find_segment(SegmentType type) const;
+
+        // The first SYMTAB and DYNSYM tables, decoded on first call and empty when absent.
+        const SymbolTable& get_symbol_table() const;
+        const SymbolTable& get_dynamic_symbol_table() const;
+
+        // Decodes the symbol table in the given section, with SHN_XINDEX resolved through SYMTAB_SHNDX.
+        SymbolTable read_symbol_table(size_t section_index) const;
+
+        // Decodes the REL or RELA section with the given index, counting relocation types on the way.
+        RelocationTable read_relocations(size_t section_index) const;
+
+        // Notes of one PT_NOTE segment or NOTE section.
+        NoteRange get_notes(const ProgramHeader& segment) const;
+        NoteRange get_notes(const SectionHeader& section) const;
+
+        // Every note of the PT_NOTE segments, or of the NOTE sections in a file without any.
+        std::vector<Note> get_notes() const;
+
+        // Descriptor of the GNU build-ID note, empty when there is none.
+        ByteView get_build_id() const;
+
+        // Same without mapping the file: only the file header, the program header table and
+        // the PT_NOTE segments are read (the section header table and NOTE sections of a file
+        // without segments). Empty when there is no build-ID or the file isn't ELF. Never throws.
+        static std::vector<uint8_t> read_build_id(const std::string& filename);
+
+        // Entries of PT_DYNAMIC (or the DYNAMIC section) up to DT_NULL, empty when there is none.
+        // The entries are scanned once and indexed by tag.
+        const std::vector<DynamicEntry>& get_dynamic_entries() const;
+
+        // First entry with the given tag, nullptr when there is none. Constant time.
+        const DynamicEntry* find_dynamic_entry(DynamicTag tag) const;
+
+        // String at an offset of the DT_STRTAB table.
+        std::string_view get_dynamic_string(uint64_t offset) const;
+
+        std::vector<std::string_view> get_needed_libraries() const;
+        std::string_view get_soname() const;  // empty when absent, as are the two below.
+        std::string_view get_rpath() const;
+        std::string_view get_runpath() const;
+
+        // File offset backing a virtual address of a PT_LOAD segment, nullopt when no
+        // segment maps it from the file.
+        std::optional<uint64_t> virtual_to_offset(uint64_t address) const;
+
+        // Decodes a single symbol straight from the file.
+        Symbol get_symbol(size_t section_index, size_t symbol) const;
+
+        // Finds a defined symbol by name. Exported symbols are found through the file's own
+        // GNU_HASH or HASH table, others through an index over the symbol table built on first miss.
+        SymbolLookup lookup_symbol(std::string_view name) const;
+
+        // Finds the function and section containing an address. The interval index is built on first call.
+        AddressLookup symbolize(uint64_t address) const;
+        // Symbolizes many addresses in one merged pass, fastest when they are sorted ascending.
+        std::vector<AddressLookup> symbolize(const std::vector<uint64_t>& addresses) const;
+
+        // NUL terminated string at offset of the string table in the given section,
+        // viewing the file's bytes. Throws std::out_of_range when it isn't inside the table.
+        std::string_view get_string(size_t strtab_index, uint32_t offset) const;
+
+        std::string_view get_section_name(const SectionHeader& section) const;
+        std::string_view get_symbol_name(const SymbolTable& table, size_t symbol) const;
+
+        // Section with the given name, nullptr when there is none. The name index is built on first call.
+        const SectionHeader* find_section(std::string_view name) const;
     
     private:
-        void read_file_header();
-        void read_program_headers();
-        void read_section_headers();
+        friend class IndexCache;
+
+        Reader() = default;
+
+        Error load(LoadMode mode);
+        Error read_file_header();
+        Error read_program_headers() const;
+        Error read_section_headers() const;
+
+        Error program_header_table(const uint8_t*& table) const;
+        Error section_header_table(const uint8_t*& table) const;
+
+        SymbolLookup lookup_gnu_hash(std::string_view name, const SectionHeader& hash) const;
+        SymbolLookup lookup_sysv_hash(std::string_view name, const SectionHeader& hash) const;
+        bool symbol_matches(std::string_view name, uint32_t section, uint32_t index, SymbolLookup& found) const;
+        const details::AddressIndex& get_address_index() const;
+        const details::DynamicIndex& get_dynamic_index() const;
+        const details::SegmentMap& get_segment_map() const;
+        std::string_view get_dynamic_string_entry(DynamicTag tag) const;
 
     private:
-        std::vector<uint8_t> data;
+        std::shared_ptr<const details::MappedFile> mapping;
+        ByteView data;
 
+        const details::Decoder* decoder = nullptr;
         FileHeader file_header;
-        std::vector<ProgramHeader> program_headers;
-        std::vector<SectionHeader> section_headers;
+        details::TableCounts counts;
+
+        // Filled on demand, the reader is not safe to share between threads before they are loaded.
+        mutable std::vector<ProgramHeader> program_headers;
+        mutable std::vector<SectionHeader> section_headers;
+        mutable bool program_headers_loaded = false;
+        mutable bool section_headers_loaded = false;
+
+        mutable std::shared_ptr<const SymbolTable> symbol_table;
+        mutable std::shared_ptr<const SymbolTable> dynamic_symbol_table;
+
+        mutable std::unordered_map<std::string_view, uint32_t> section_names;
+        mutable bool section_names_loaded = false;
+
+        mutable uint32_t gnu_hash_section  = 0;
+        mutable uint32_t sysv_hash_section = 0;
+        mutable bool hash_sections_loaded  = false;
+        mutable std::shared_ptr<const details::SymbolIndex> symbol_index;
+        mutable std::shared_ptr<const details::AddressIndex> address_index;
+        mutable std::shared_ptr<const details::DynamicIndex> dynamic_index;
+        mutable std::shared_ptr<const details::SegmentMap> segment_map;
+    };
+
+    // Either a Reader or the reason there is none, in the manner of std::expected.
+    class OpenResult
+    {
+    public:
+        OpenResult(Error error) : code(error) {}
+        OpenResult(Reader&& reader) : reader(std::move(reader)), code(Error::None) {}
+
+        inline explicit operator bool() const { return code == Error::None; }
+        inline Error error() const { return code; }
+
+        inline Reader&       value()       { return *reader; }
+        inline const Reader& value() const { return *reader; }
+
+        inline Reader*       operator->()       { return &*reader; }
+        inline const Reader* operator->() const { return &*reader; }
+        inline Reader&       operator*()        { return *reader; }
+        inline const Reader& operator*()  const { return *reader; }
+
+    private:
+        std::optional<Reader> reader;
+        Error                 code;
+    };
+
+    // ------------------------------------------------------------------------------------------------
+
+    // Process-wide LRU of decompressed sections shared by every Reader, bounded by the bytes it
+    // holds. Entries are keyed by mapping and offset and go stale with the mapping, so readers
+    // over caller-owned memory decompress without it. Thread-safe.
+    class DecompressionCache
+    {
+    public:
+        static constexpr size_t DefaultCapacity  = size_t(256) << 20;
+        static constexpr size_t DefaultSizeLimit = size_t(1) << 30;
+
+        static DecompressionCache& instance();
+
+        // Evicts down to the new capacity right away. Buffers above the capacity are
+        // handed out but never kept.
+        void   set_capacity(size_t bytes);
+        size_t get_capacity() const;
+
+        // Largest uncompressed size a single section may claim, larger ones are rejected
+        // before anything is allocated.
+        void   set_size_limit(size_t bytes);
+        size_t get_size_limit() const;
+
+        size_t size() const;  // bytes held.
+        size_t count() const; // buffers held.
+        void   clear();
+
+    private:
+        DecompressionCache();
+        ~DecompressionCache();
+
+        friend class Reader;
+        bool find(const std::shared_ptr<const details::MappedFile>& mapping, uint64_t offset, SectionBuffer& buffer);
+        SectionBuffer insert(const std::shared_ptr<const details::MappedFile>& mapping, uint64_t offset, SectionBuffer buffer);
+
+        struct State;
+        std::unique_ptr<State> state;
+    };
+
+    // ------------------------------------------------------------------------------------------------
+
+    // Metadata of one file read in place from a mapped IndexCache entry: the file header,
+    // the header tables, the section name index, the symbol index and the address index.
+    // Opening one parses and allocates nothing.
+    class CachedIndex
+    {
+    public:
+        CachedIndex(CachedIndex&&) = default;
+
+        const FileHeader& get_file_header() const;
+
+        ArrayView<ProgramHeader> get_program_headers() const;
+        ArrayView<SectionHeader> get_section_headers() const;
+
+        std::string_view get_section_name(const SectionHeader& section) const;
+        const SectionHeader* find_section(std::string_view name) const;
+
+        // The symbols are those of .symtab, or .dynsym when there is no .symtab. symbolize()
+        // matches the Reader's. lookup_symbol() doesn't search GNU_HASH/HASH over .dynsym
+        // first as the Reader does, so for exported symbols it finds the .symtab entry and
+        // reports that section.
+        std::string_view get_symbol_name(const Symbol& symbol) const;
+        SymbolLookup lookup_symbol(std::string_view name) const;
+        AddressLookup symbolize(uint64_t address) const;
+
+    private:
+        friend class IndexCache;
+
+        CachedIndex() = default;
+
+        template<typename T>
+        ArrayView<T> array(uint64_t offset, uint64_t count) const;
+
+        std::string_view string(uint64_t offset, uint64_t size, uint32_t at) const;
+
+    private:
+        details::MappedFile         file;
+        const details::IndexHeader* header = nullptr;
+    };
+
+    // Directory of CachedIndex files, one per indexed file, keyed by path, device, inode,
+    // size and mtime. Entries are host specific and rewritten whenever the file changes.
+    class IndexCache
+    {
+    public:
+        explicit IndexCache(std::string directory);
+
+        // The cached index, built and stored first when it is missing or stale. nullopt when
+        // the file isn't ELF or its tables are malformed.
+        std::optional<CachedIndex> open(const std::string& path) const;
+
+        // The cached index when it is current, nullopt otherwise. Never builds one.
+        std::optional<CachedIndex> find(const std::string& path) const;
+
+        // Writes the index of a reader opened from path, atomically replacing any older entry.
+        bool store(const std::string& path, const Reader& reader) const;
+
+        // Name of the cache entry of a file.
+        std::string entry_path(const std::string& path) const;
+
+    private:
+        std::string directory;
+    };
+
+    // ------------------------------------------------------------------------------------------------
+
+    // One thread of a core dump, from its NT_PRSTATUS note.
+    struct CoreThread
+    {
+        uint32_t pid;
+        uint16_t signal;    // pr_cursig
+        ByteView registers; // pr_reg, laid out as the machine's user_regs_struct.
+    };
+
+    // A file mapped into the crashed process, from the NT_FILE note.
+    struct CoreMapping
+    {
+        uint64_t         start;
+        uint64_t         end;
+        uint64_t         offset; // in bytes into the file.
+        std::string_view path;
+    };
+
+    struct AuxvEntry
+    {
+        uint64_t type;
+        uint64_t value;
+    };
+
+    // Reads a core dump without mapping it: the file header, the program headers and the note
+    // segments are read once, process memory is read on demand through a bounded LRU cache of
+    // file pages. Memory reads are thread-safe.
+    class CoreFile
+    {
+    public:
+        static constexpr size_t PageSize = 4096;
+
+        // Throws std::runtime_error when the file isn't an ELF core dump.
+        explicit CoreFile(const std::string& filename, size_t cache_pages = 1024);
+        ~CoreFile();
+
+        CoreFile(CoreFile&&) noexcept;
+        CoreFile& operator=(CoreFile&&) noexcept;
+
+        const FileHeader& get_file_header() const;
+        const std::vector<ProgramHeader>& get_program_headers() const;
+
+        const std::vector<CoreThread>&  get_threads() const;
+        const std::vector<CoreMapping>& get_file_mappings() const;
+        const std::vector<AuxvEntry>&   get_auxv() const;
+
+        // Copies the dumped memory at [address, address + size) and returns the number of bytes
+        // copied, short where the range leaves the memory present in the file.
+        size_t read_memory(uint64_t address, void* buffer, size_t size) const;
+
+        // Number of file pages cached right now.
+        size_t get_cached_page_count() const;
+
+    private:
+        struct State;
+        std::unique_ptr<State> state;
     };
 }
 
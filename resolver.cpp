@@ -0,0 +1,473 @@
+#include "resolver.hpp"
+#include "threadpool.hpp"
+
+#include <future>
+#include <mutex>
+#include <cstring>
+
+#include <sys/stat.h>
+
+// ------------------------------------------------------------------------------------------------
+
+namespace ELF
+{
+    namespace details {
+        // Identity of a file version, a rewritten or replaced file gets a new one.
+        struct FileKey
+        {
+            dev_t   device;
+            ino_t   inode;
+            int64_t seconds;
+            long    nanoseconds;
+
+            inline bool operator==(const FileKey& other) const
+            {
+                return device == other.device && inode == other.inode &&
+                       seconds == other.seconds && nanoseconds == other.nanoseconds;
+            }
+        };
+
+        struct FileKeyHash
+        {
+            size_t operator()(const FileKey& key) const
+            {
+                uint64_t h = uint64_t(key.inode) * 0x9E3779B97F4A7C15ULL;
+                h ^= uint64_t(key.device) + 0x632BE59BD9B4E019ULL + (h << 6) + (h >> 2);
+                h ^= uint64_t(key.seconds) * 31 + uint64_t(key.nanoseconds);
+                return static_cast<size_t>(h);
+            }
+        };
+    }
+
+    using ReaderFuture = std::shared_future<std::shared_ptr<const Reader>>;
+
+    struct LibraryCache::State
+    {
+        mutable std::mutex mutex;
+
+        // Futures let concurrent queries for the same file wait for one open instead of racing.
+        std::unordered_map<details::FileKey, ReaderFuture, details::FileKeyHash> readers;
+    };
+
+    LibraryCache::LibraryCache() : state(std::make_unique<State>()) {}
+    LibraryCache::~LibraryCache() = default;
+
+    LibraryCache&
+    LibraryCache::instance()
+    {
+        static LibraryCache cache;
+        return cache;
+    }
+
+    static inline
+    std::shared_ptr<const Reader>
+    open_shared(const std::string& path)
+    {
+        if(!Reader::probe(path))
+            return nullptr;
+
+        OpenResult result = Reader::open(path, AccessHint::Random, LoadMode::Eager);
+        if(!result)
+            return nullptr;
+
+        auto reader = std::make_shared<Reader>(std::move(result.value()));
+
+        try
+        {
+            // Fill the lazy caches the resolver reads, shared readers must not load anything.
+            reader->get_dynamic_entries();
+        }
+        catch(const std::exception&)
+        {
+            return nullptr;
+        }
+
+        return reader;
+    }
+
+    std::shared_ptr<const Reader>
+    LibraryCache::get(const std::string& path)
+    {
+        struct stat info;
+        if(::stat(path.c_str(), &info) != 0 || !S_ISREG(info.st_mode))
+            return nullptr;
+
+        details::FileKey key { info.st_dev, info.st_ino, int64_t(info.st_mtim.tv_sec), info.st_mtim.tv_nsec };
+
+        std::promise<std::shared_ptr<const Reader>> promise;
+        ReaderFuture future;
+
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+
+            auto it = state->readers.find(key);
+            if(it != state->readers.end())
+                future = it->second;
+            else
+                state->readers.emplace(key, promise.get_future().share());
+        }
+
+        if(future.valid())
+            return future.get();
+
+        std::shared_ptr<const Reader> reader = open_shared(path);
+        promise.set_value(reader);
+        return reader;
+    }
+
+    size_t
+    LibraryCache::size() const
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        return state->readers.size();
+    }
+
+    void
+    LibraryCache::clear()
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->readers.clear();
+    }
+
+    // ------------------------------------------------------------------------------------------------
+
+    // Reads the name -> path pairs of an ld.so.cache, either the new format alone or after
+    // the old one. Anything malformed leaves the map with whatever was read so far.
+    static inline
+    void
+    load_ld_cache(const std::string& filename, std::unordered_map<std::string, std::vector<std::string>>& entries)
+    {
+        static constexpr char OldMagic[] = "ld.so-1.7.0";
+        static constexpr char NewMagic[] = "glibc-ld.so.cache1.1";
+
+        // struct cache_file pads the 11-byte magic so that nlibs is at 12, and the new header
+        // follows the old entries at the alignment of struct cache_file_new, which is 4.
+        static constexpr size_t OldHeaderSize = 16;
+        static constexpr size_t OldEntrySize  = 12;
+        static constexpr size_t NewHeaderSize = 48;
+        static constexpr size_t NewEntrySize  = 24;
+        static constexpr size_t NewAlignment  = 4;
+
+        details::MappedFile file;
+        if(filename.empty() || file.map(filename, AccessHint::Sequential) != Error::None)
+            return;
+
+        ByteView bytes = file.view();
+
+        auto u32 = [&bytes](size_t offset) {
+            uint32_t value;
+            std::memcpy(&value, bytes.data() + offset, sizeof(value));
+            return value;
+        };
+
+        if(bytes.size() >= OldHeaderSize && std::memcmp(bytes.data(), OldMagic, sizeof(OldMagic) - 1) == 0)
+        {
+            uint64_t skip = OldHeaderSize + uint64_t(u32(12)) * OldEntrySize;
+            skip = (skip + NewAlignment - 1) & ~uint64_t(NewAlignment - 1);
+
+            if(skip > bytes.size())
+                return;
+
+            bytes = bytes.subview(size_t(skip));
+        }
+
+        if(bytes.size() < NewHeaderSize || std::memcmp(bytes.data(), NewMagic, sizeof(NewMagic) - 1) != 0)
+            return;
+
+        size_t count = u32(20);
+        if(count > (bytes.size() - NewHeaderSize) / NewEntrySize)
+            return;
+
+        // String offsets are relative to the new header.
+        auto string_at = [&bytes](uint32_t offset) {
+            if(offset >= bytes.size())
+                return std::string_view();
+
+            const char* first = reinterpret_cast<const char*>(bytes.data()) + offset;
+            const void* nul   = std::memchr(first, '\0', bytes.size() - offset);
+            return nul ? std::string_view(first, static_cast<const char*>(nul) - first) : std::string_view();
+        };
+
+        for (size_t i = 0; i < count; i++)
+        {
+            size_t entry = NewHeaderSize + i * NewEntrySize;
+            std::string_view key   = string_at(u32(entry + 4));
+            std::string_view value = string_at(u32(entry + 8));
+
+            if(!key.empty() && !value.empty())
+                entries[std::string(key)].emplace_back(value);
+        }
+    }
+
+    // Splits a colon separated search path, expanding $ORIGIN and $LIB. An empty element
+    // is the working directory, as for ld.so, but an absent path adds nothing; elements
+    // naming $PLATFORM are dropped.
+    static inline
+    void
+    split_search_path(std::string_view list, const std::string& origin, FileClass file_class, std::vector<std::string>& dirs)
+    {
+        if(list.empty())
+            return;
+
+        while(true)
+        {
+            size_t end = list.find(':');
+            std::string_view element = list.substr(0, end);
+            std::string dir;
+
+            for (size_t i = 0; i < element.size();)
+            {
+                std::string_view rest = element.substr(i);
+
+                auto expand = [&](std::string_view token, std::string_view braced, std::string_view value) {
+                    size_t length = (rest.substr(0, token.size()) == token) ? token.size() :
+                                    (rest.substr(0, braced.size()) == braced) ? braced.size() : 0;
+                    if(length)
+                    {
+                        dir += value;
+                        i += length;
+                    }
+                    return length != 0;
+                };
+
+                if(rest[0] == '$' &&
+                  (expand("$ORIGIN", "${ORIGIN}", origin) ||
+                   expand("$LIB", "${LIB}", (file_class == FileClass::ELF64) ? "lib64" : "lib")))
+                    continue;
+
+                if(rest[0] == '$' && (rest.substr(0, 9) == "$PLATFORM" || rest.substr(0, 11) == "${PLATFORM}"))
+                {
+                    dir.clear();
+                    break;
+                }
+
+                dir += rest[0];
+                i++;
+            }
+
+            if(!dir.empty() || element.empty())
+                dirs.push_back(dir.empty() ? "." : dir);
+
+            if(end == std::string_view::npos)
+                break;
+
+            list.remove_prefix(end + 1);
+        }
+    }
+
+    static inline
+    std::string
+    directory_of(const std::string& path)
+    {
+        size_t slash = path.rfind('/');
+        if(slash == std::string::npos)
+            return ".";
+
+        return (slash == 0) ? "/" : path.substr(0, slash);
+    }
+
+    // ------------------------------------------------------------------------------------------------
+
+    // One DT_NEEDED name to look up on behalf of an object already in the graph.
+    struct DependencyResolver::Request
+    {
+        std::string_view name;
+        size_t           requester;
+    };
+
+    DependencyResolver::DependencyResolver(ResolveOptions options)
+        : options(std::move(options))
+    {
+        load_ld_cache(this->options.cache_file, ld_cache);
+        pool = std::make_unique<ThreadPool>(this->options.threads);
+    }
+
+    DependencyResolver::~DependencyResolver() = default;
+
+    std::shared_ptr<const Reader>
+    DependencyResolver::try_candidate(const std::string& path, const Reader& root) const
+    {
+        std::shared_ptr<const Reader> reader = LibraryCache::instance().get(path);
+
+        // ld.so passes over objects it couldn't load into this process.
+        if(reader && (reader->get_file_header().bits    != root.get_file_header().bits ||
+                      reader->get_file_header().machine != root.get_file_header().machine))
+            return nullptr;
+
+        return reader;
+    }
+
+    std::string
+    DependencyResolver::search(const Request& request, const DependencyGraph& graph, std::shared_ptr<const Reader>& reader) const
+    {
+        const Reader& root = *graph.nodes[0].reader;
+        const Dependency& requester = graph.nodes[request.requester];
+        FileClass file_class = static_cast<FileClass>(root.get_file_header().bits);
+
+        std::string name(request.name);
+
+        if(name.find('/') != std::string::npos)
+        {
+            reader = try_candidate(name, root);
+            return reader ? name : std::string();
+        }
+
+        auto try_dirs = [&](const std::vector<std::string>& dirs) {
+            for (const std::string& dir : dirs)
+            {
+                std::string path = dir + "/" + name;
+
+                if((reader = try_candidate(path, root)))
+                    return path;
+            }
+
+            return std::string();
+        };
+
+        std::vector<std::string> dirs;
+        std::string found;
+
+        // DT_RPATH of the loader chain, only when the requester has no DT_RUNPATH.
+        if(requester.reader->get_runpath().empty())
+        {
+            for (size_t i = request.requester; i != Dependency::None; i = graph.nodes[i].parent)
+            {
+                const Dependency& loader = graph.nodes[i];
+
+                if(loader.reader->get_runpath().empty())
+                    split_search_path(loader.reader->get_rpath(), directory_of(loader.path), file_class, dirs);
+            }
+        }
+
+        for (const std::string& dir : options.library_paths)
+            dirs.push_back(dir);
+
+        split_search_path(requester.reader->get_runpath(), directory_of(requester.path), file_class, dirs);
+
+        if(!(found = try_dirs(dirs)).empty())
+            return found;
+
+        // DF_1_NODEFLIB keeps the requester away from the cache and the default paths.
+        static constexpr uint64_t NoDefaultLibraries = 0x800;
+        const DynamicEntry* flags = requester.reader->find_dynamic_entry(DynamicTag::FLAGS_1);
+
+        if(flags && (flags->value & NoDefaultLibraries))
+            return std::string();
+
+        auto cached = ld_cache.find(name);
+        if(cached != ld_cache.end())
+        {
+            for (const std::string& path : cached->second)
+            {
+                if((reader = try_candidate(path, root)))
+                    return path;
+            }
+        }
+
+        return try_dirs(options.default_paths);
+    }
+
+    DependencyGraph
+    DependencyResolver::resolve(const std::string& path) const
+    {
+        DependencyGraph graph;
+
+        std::shared_ptr<const Reader> root = LibraryCache::instance().get(path);
+        if(!root)
+            throw std::runtime_error("Unable to read the root object as ELF.");
+
+        graph.nodes.push_back(Dependency { path, path, root, Dependency::None, {} });
+
+        // Names already loaded, DT_NEEDED strings and DT_SONAMEs alike, as ld.so matches both.
+        std::unordered_map<std::string_view, size_t> loaded;
+        if(!root->get_soname().empty())
+            loaded.emplace(root->get_soname(), 0);
+
+        size_t level_begin = 0;
+        size_t level_end   = 1;
+
+        while(level_begin < level_end)
+        {
+            // Collect the new names of this level in breadth-first order, the first
+            // requester of a name decides where it's searched for.
+            std::vector<Request> requests;
+            std::unordered_map<std::string_view, size_t> requested;
+
+            for (size_t i = level_begin; i < level_end; i++)
+            {
+                if(!graph.nodes[i].reader)
+                    continue;
+
+                for (std::string_view name : graph.nodes[i].reader->get_needed_libraries())
+                {
+                    if(loaded.count(name) == 0 && requested.count(name) == 0)
+                    {
+                        requested.emplace(name, requests.size());
+                        requests.push_back(Request { name, i });
+                    }
+                }
+            }
+
+            std::vector<std::string> paths(requests.size());
+            std::vector<std::shared_ptr<const Reader>> readers(requests.size());
+
+            ThreadPool::TaskGroup group;
+
+            for (size_t r = 0; r < requests.size(); r++)
+            {
+                pool->submit(group, [this, &requests, &graph, &paths, &readers, r] {
+                    paths[r] = search(requests[r], graph, readers[r]);
+                });
+            }
+
+            pool->wait(group);
+
+            // Two names may lead to one file, which ld.so loads once.
+            std::unordered_map<const Reader*, size_t> by_reader;
+            for (size_t i = 0; i < graph.nodes.size(); i++)
+                by_reader.emplace(graph.nodes[i].reader.get(), i);
+
+            std::vector<size_t> resolved(requests.size());
+
+            for (size_t r = 0; r < requests.size(); r++)
+            {
+                auto same = readers[r] ? by_reader.find(readers[r].get()) : by_reader.end();
+
+                if(same != by_reader.end())
+                {
+                    resolved[r] = same->second;
+                }
+                else
+                {
+                    resolved[r] = graph.nodes.size();
+                    graph.nodes.push_back(Dependency { std::string(requests[r].name), paths[r], readers[r], requests[r].requester, {} });
+
+                    if(readers[r])
+                    {
+                        by_reader.emplace(readers[r].get(), resolved[r]);
+
+                        std::string_view soname = readers[r]->get_soname();
+                        if(!soname.empty())
+                            loaded.emplace(soname, resolved[r]);
+                    }
+                }
+
+                loaded.emplace(requests[r].name, resolved[r]);
+            }
+
+            for (size_t i = level_begin; i < level_end; i++)
+            {
+                if(!graph.nodes[i].reader)
+                    continue;
+
+                for (std::string_view name : graph.nodes[i].reader->get_needed_libraries())
+                    graph.nodes[i].needed.push_back(loaded.at(name));
+            }
+
+            level_begin = level_end;
+            level_end   = graph.nodes.size();
+        }
+
+        return graph;
+    }
+}
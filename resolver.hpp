@@ -0,0 +1,125 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2021 Eviatar
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef RESOLVER_HPP
+#define RESOLVER_HPP
+#pragma once
+
+#include "readelf.hpp"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+// ------------------------------------------------------------------------------------------------
+
+namespace ELF
+{
+    class ThreadPool;
+
+    // Process-wide cache of opened shared objects keyed by (device, inode, mtime), so a file
+    // is mapped and parsed once however many paths or queries lead to it. A replaced file
+    // gets a new key and is opened again.
+    class LibraryCache
+    {
+    public:
+        static LibraryCache& instance();
+
+        // Reader for the file, nullptr when it doesn't exist or isn't ELF. Program headers,
+        // section headers and the dynamic section are loaded before the reader is shared;
+        // anything else is lazily loaded and needs the caller's own synchronization.
+        std::shared_ptr<const Reader> get(const std::string& path);
+
+        size_t size() const;
+        void clear();
+
+    private:
+        LibraryCache();
+        ~LibraryCache();
+
+        struct State;
+        std::unique_ptr<State> state;
+    };
+
+    struct ResolveOptions
+    {
+        size_t threads = 0;                       // 0 uses every hardware thread.
+
+        std::vector<std::string> library_paths;   // searched like LD_LIBRARY_PATH.
+        std::vector<std::string> default_paths = { "/lib64", "/usr/lib64", "/lib", "/usr/lib" };
+        std::string              cache_file    = "/etc/ld.so.cache"; // empty skips the cache.
+    };
+
+    // One object of a dependency graph.
+    struct Dependency
+    {
+        static constexpr size_t None = SIZE_MAX;
+
+        std::string                   name;   // the DT_NEEDED string, the path for the root.
+        std::string                   path;   // empty when it wasn't found.
+        std::shared_ptr<const Reader> reader;
+        size_t                        parent; // object that loaded it first, None for the root.
+        std::vector<size_t>           needed; // one index per DT_NEEDED entry, in order.
+    };
+
+    // nodes[0] is the root, the others follow in the breadth-first order ld.so loads them.
+    struct DependencyGraph
+    {
+        std::vector<Dependency> nodes;
+    };
+
+    // Computes DT_NEEDED closures the way ld.so searches: DT_RPATH of the loader chain,
+    // library_paths, DT_RUNPATH, ld.so.cache and the default paths, skipping objects of another
+    // class or machine. Each level of the graph is resolved in parallel and readers come
+    // from the LibraryCache, so libraries shared between queries are only opened once.
+    class DependencyResolver
+    {
+    public:
+        explicit DependencyResolver(ResolveOptions options = {});
+        ~DependencyResolver();
+
+        DependencyResolver(const DependencyResolver&) = delete;
+        DependencyResolver& operator=(const DependencyResolver&) = delete;
+
+        // Throws std::runtime_error when the root itself can't be read as ELF.
+        DependencyGraph resolve(const std::string& path) const;
+
+    private:
+        struct Request;
+
+        std::string search(const Request& request, const DependencyGraph& graph, std::shared_ptr<const Reader>& reader) const;
+        std::shared_ptr<const Reader> try_candidate(const std::string& path, const Reader& root) const;
+
+    private:
+        ResolveOptions options;
+
+        // ld.so.cache entries by library name, in file order.
+        std::unordered_map<std::string, std::vector<std::string>> ld_cache;
+        std::unique_ptr<ThreadPool> pool;
+    };
+}
+
+#endif // RESOLVER_HPP
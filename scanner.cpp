@@ -0,0 +1,445 @@
+#include "scanner.hpp"
+#include "threadpool.hpp"
+
+#include <filesystem>
+#include <memory>
+#include <cstring>
+
+#if defined(__linux__) && defined(__has_include)
+#   if __has_include(<linux/io_uring.h>)
+#       define READELF_HAS_IO_URING 1
+#       include <linux/io_uring.h>
+#       include <sys/mman.h>
+#       include <sys/syscall.h>
+#       include <sys/uio.h>
+#       include <fcntl.h>
+#       include <unistd.h>
+#       include <cerrno>
+#   endif
+#endif
+
+// ------------------------------------------------------------------------------------------------
+
+namespace ELF
+{
+    static inline
+    size_t
+    resolve_threads(const ScanOptions& options)
+    {
+        size_t threads = options.threads ? options.threads : std::thread::hardware_concurrency();
+        return threads ? threads : 1;
+    }
+
+    size_t
+    scan_worker_count(const ScanOptions& options)
+    {
+        // The calling thread helps out while it waits.
+        return resolve_threads(options) + 1;
+    }
+
+    static inline
+    void
+    scan_one(const ThreadPool& pool, const std::string& path, const ScanVisitor& visitor, const ScanOptions& options)
+    {
+        size_t worker = pool.current_worker();
+
+        // Rejecting from one small read is much cheaper than mapping the file.
+        ProbeResult probe = Reader::probe(path);
+        if(!probe)
+        {
+            visitor(ScanResult { path, nullptr, to_string(probe.error), worker });
+            return;
+        }
+
+        OpenResult reader = Reader::open(path, options.hint, options.mode);
+
+        if(!reader)
+        {
+            visitor(ScanResult { path, nullptr, to_string(reader.error()), worker });
+            return;
+        }
+
+        // Pool tasks must not throw. Visitors must catch what they throw themselves, this only
+        // keeps one that doesn't from taking the process down; the file was visited regardless.
+        try
+        {
+            visitor(ScanResult { path, &reader.value(), nullptr, worker });
+        }
+        catch(...)
+        {
+        }
+    }
+
+    // ------------------------------------------------------------------------------------------------
+
+#if defined(READELF_HAS_IO_URING)
+    namespace details {
+        // Minimal io_uring over the raw system calls, just what batched probing needs.
+        class IoRing
+        {
+        public:
+            explicit IoRing(unsigned entries)
+            {
+                io_uring_params params;
+                std::memset(&params, 0, sizeof(params));
+
+                int fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+                if(fd < 0)
+                    return;
+
+                ring_fd = fd;
+                sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+                cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+                sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+
+                bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+                if(single)
+                    sq_size = cq_size = (sq_size > cq_size) ? sq_size : cq_size;
+
+                sq_ring = map(sq_size, IORING_OFF_SQ_RING);
+                cq_ring = single ? sq_ring : map(cq_size, IORING_OFF_CQ_RING);
+                void* sqe_ring = map(sqes_size, IORING_OFF_SQES);
+
+                if(sq_ring == MAP_FAILED || cq_ring == MAP_FAILED || sqe_ring == MAP_FAILED)
+                {
+                    release(sqe_ring);
+                    return;
+                }
+
+                uint8_t* sq = static_cast<uint8_t*>(sq_ring);
+                uint8_t* cq = static_cast<uint8_t*>(cq_ring);
+
+                sq_tail  = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+                sq_mask  = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+                sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+                cq_head  = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+                cq_tail  = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+                cq_mask  = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+                cqes     = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+                sqes     = static_cast<io_uring_sqe*>(sqe_ring);
+                capacity = params.sq_entries;
+            }
+
+            ~IoRing()
+            {
+                release(sqes ? static_cast<void*>(sqes) : MAP_FAILED);
+            }
+
+            IoRing(const IoRing&) = delete;
+            IoRing& operator=(const IoRing&) = delete;
+
+            inline bool     valid() const { return sqes != nullptr; }
+            inline unsigned size()  const { return capacity; }
+
+            void
+            push(const io_uring_sqe& sqe)
+            {
+                unsigned tail  = *sq_tail;
+                unsigned index = tail & *sq_mask;
+
+                sqes[index]     = sqe;
+                sq_array[index] = index;
+                __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+                unsubmitted++;
+            }
+
+            // Submits everything pushed and calls fn for `expected` completions. When the kernel
+            // refuses, pushed requests it never took are dropped and those in flight are still
+            // waited for and handed to fn, so none outlives the call unless stranded() says so.
+            template<typename Fn>
+            bool
+            complete(unsigned expected, Fn&& fn)
+            {
+                while(expected != 0)
+                {
+                    int n = enter(unsubmitted, expected);
+                    if(n < 0)
+                    {
+                        if(errno == EINTR)
+                            continue;
+
+                        abandoned = !drain(fn);
+                        return false;
+                    }
+
+                    unsubmitted -= static_cast<unsigned>(n);
+                    in_flight   += static_cast<unsigned>(n);
+                    expected    -= reap(expected, fn);
+                }
+
+                return true;
+            }
+
+            // Requests may still be in flight after a failed complete(), their buffers must stay.
+            inline bool stranded() const { return abandoned; }
+
+        private:
+            int
+            enter(unsigned submit, unsigned wait) const
+            {
+                return static_cast<int>(::syscall(__NR_io_uring_enter, ring_fd, submit, wait, IORING_ENTER_GETEVENTS, nullptr, 0));
+            }
+
+            template<typename Fn>
+            unsigned
+            reap(unsigned limit, Fn& fn)
+            {
+                unsigned head = *cq_head;
+                unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+                unsigned count = 0;
+
+                for (; head != tail && count < limit; head++, count++)
+                    fn(cqes[head & *cq_mask]);
+
+                __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+                in_flight -= count;
+                return count;
+            }
+
+            template<typename Fn>
+            bool
+            drain(Fn& fn)
+            {
+                // Nothing reads the submission queue between calls, so unsubmitted entries can be taken back.
+                __atomic_store_n(sq_tail, *sq_tail - unsubmitted, __ATOMIC_RELEASE);
+                unsubmitted = 0;
+
+                while(in_flight != 0)
+                {
+                    if(enter(0, in_flight) < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+                        return false;
+
+                    reap(in_flight, fn);
+                }
+
+                return true;
+            }
+
+            void*
+            map(size_t size, off_t offset) const
+            {
+                return ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, offset);
+            }
+
+            void
+            release(void* sqe_ring)
+            {
+                if(sqe_ring != MAP_FAILED)
+                    ::munmap(sqe_ring, sqes_size);
+
+                if(cq_ring != MAP_FAILED && cq_ring != sq_ring)
+                    ::munmap(cq_ring, cq_size);
+
+                if(sq_ring != MAP_FAILED)
+                    ::munmap(sq_ring, sq_size);
+
+                if(ring_fd >= 0)
+                    ::close(ring_fd);
+
+                sq_ring = cq_ring = MAP_FAILED;
+                sqes    = nullptr;
+                ring_fd = -1;
+            }
+
+        private:
+            int    ring_fd   = -1;
+            void*  sq_ring   = MAP_FAILED;
+            void*  cq_ring   = MAP_FAILED;
+            size_t sq_size   = 0;
+            size_t cq_size   = 0;
+            size_t sqes_size = 0;
+
+            unsigned*     sq_tail  = nullptr;
+            unsigned*     sq_mask  = nullptr;
+            unsigned*     sq_array = nullptr;
+            unsigned*     cq_head  = nullptr;
+            unsigned*     cq_tail  = nullptr;
+            unsigned*     cq_mask  = nullptr;
+            io_uring_cqe* cqes     = nullptr;
+            io_uring_sqe* sqes     = nullptr;
+
+            unsigned capacity    = 0;
+            unsigned unsubmitted = 0;
+            unsigned in_flight   = 0;
+            bool     abandoned   = false;
+        };
+
+        static constexpr int ProbeOpenFlags = O_RDONLY | O_CLOEXEC | O_NOCTTY | O_NONBLOCK;
+
+        // Probes paths[first, first + count) with one batch of opens and one of reads.
+        static bool
+        probe_batch(IoRing& ring, const std::vector<std::string>& paths, size_t first, size_t count, ProbeResult* results)
+        {
+            struct Slot
+            {
+                int     fd = -1;
+                iovec   iov;
+                uint8_t buffer[Reader::ProbeSize];
+            };
+
+            std::unique_ptr<Slot[]> slots(new Slot[count]);
+
+            for (size_t i = 0; i < count; i++)
+            {
+                io_uring_sqe sqe;
+                std::memset(&sqe, 0, sizeof(sqe));
+
+                sqe.opcode     = IORING_OP_OPENAT;
+                sqe.fd         = AT_FDCWD;
+                sqe.addr       = reinterpret_cast<uint64_t>(paths[first + i].c_str());
+                sqe.open_flags = ProbeOpenFlags;
+                sqe.user_data  = i;
+
+                ring.push(sqe);
+            }
+
+            bool ok = ring.complete(static_cast<unsigned>(count), [&](const io_uring_cqe& cqe) {
+                Slot& slot = slots[cqe.user_data];
+                slot.fd = cqe.res;
+
+                // Kernels before 5.6 lack IORING_OP_OPENAT, open those synchronously.
+                if(cqe.res == -EINVAL)
+                    slot.fd = ::open(paths[first + cqe.user_data].c_str(), ProbeOpenFlags);
+            });
+
+            unsigned reads = 0;
+
+            for (size_t i = 0; ok && i < count; i++)
+            {
+                if(slots[i].fd < 0)
+                {
+                    results[i] = ProbeResult {};
+                    results[i].error = Error::OpenFailed;
+                    continue;
+                }
+
+                slots[i].iov = iovec { slots[i].buffer, sizeof(slots[i].buffer) };
+
+                io_uring_sqe sqe;
+                std::memset(&sqe, 0, sizeof(sqe));
+
+                sqe.opcode    = IORING_OP_READV;
+                sqe.fd        = slots[i].fd;
+                sqe.addr      = reinterpret_cast<uint64_t>(&slots[i].iov);
+                sqe.len       = 1;
+                sqe.off       = 0;
+                sqe.user_data = i;
+
+                ring.push(sqe);
+                reads++;
+            }
+
+            ok = ok && ring.complete(reads, [&](const io_uring_cqe& cqe) {
+                Slot& slot = slots[cqe.user_data];
+
+                if(cqe.res < 0)
+                {
+                    results[cqe.user_data] = ProbeResult {};
+                    results[cqe.user_data].error = Error::OpenFailed;
+                }
+                else
+                    results[cqe.user_data] = Reader::probe(ByteView(slot.buffer, static_cast<size_t>(cqe.res)));
+            });
+
+            for (size_t i = 0; i < count; i++)
+            {
+                if(slots[i].fd >= 0)
+                    ::close(slots[i].fd);
+            }
+
+            // The kernel may still write to the buffers of requests it never completed.
+            if(ring.stranded())
+                slots.release();
+
+            return ok;
+        }
+    }
+#endif
+
+    std::vector<ProbeResult>
+    probe_files(const std::vector<std::string>& paths, const ScanOptions& options)
+    {
+        std::vector<ProbeResult> results(paths.size());
+        size_t done = 0;
+
+#if defined(READELF_HAS_IO_URING)
+        details::IoRing ring(256);
+
+        // A ring the kernel refuses mid-way hands the rest to the pool.
+        while(ring.valid() && done < paths.size())
+        {
+            size_t count = paths.size() - done;
+            if(count > ring.size())
+                count = ring.size();
+
+            if(!details::probe_batch(ring, paths, done, count, results.data() + done))
+                break;
+
+            done += count;
+        }
+#endif
+
+        if(done == paths.size())
+            return results;
+
+        ThreadPool pool(resolve_threads(options));
+        ThreadPool::TaskGroup group;
+
+        // A task per few dozen files keeps the queues short, stealing still balances them.
+        constexpr size_t slice = 32;
+
+        for (size_t first = done; first < paths.size(); first += slice)
+        {
+            size_t last = (first + slice < paths.size()) ? first + slice : paths.size();
+
+            pool.submit(group, [&paths, &results, first, last] {
+                for (size_t i = first; i < last; i++)
+                    results[i] = Reader::probe(paths[i]);
+            });
+        }
+
+        pool.wait(group);
+        return results;
+    }
+
+    void
+    scan_files(const std::vector<std::string>& paths, const ScanVisitor& visitor, const ScanOptions& options)
+    {
+        ThreadPool pool(resolve_threads(options));
+        ThreadPool::TaskGroup group;
+
+        for (const std::string& path : paths)
+            pool.submit(group, [&pool, &path, &visitor, &options] { scan_one(pool, path, visitor, options); });
+
+        pool.wait(group);
+    }
+
+    void
+    scan_tree(const std::string& root, const ScanVisitor& visitor, const ScanOptions& options)
+    {
+        namespace fs = std::filesystem;
+
+        ThreadPool pool(resolve_threads(options));
+        ThreadPool::TaskGroup group;
+
+        std::error_code ec;
+        fs::recursive_directory_iterator it(root, fs::directory_options::skip_permission_denied, ec), end;
+
+        for (; !ec && it != end; it.increment(ec))
+        {
+            // Only regular files, a FIFO or a device would block the worker opening it.
+            if(!it->is_regular_file(ec) || it->is_symlink(ec))
+                continue;
+
+            pool.submit(group, [&pool, path = it->path().string(), &visitor, &options] { 
+                scan_one(pool, path, visitor, options); 
+            });
+        }
+
+        // A root that is a file rather than a directory is scanned on its own.
+        if(fs::is_regular_file(root, ec))
+            pool.submit(group, [&pool, &root, &visitor, &options] { scan_one(pool, root, visitor, options); });
+
+        pool.wait(group);
+    }
+}
@@ -0,0 +1,75 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2021 Eviatar
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SCANNER_HPP
+#define SCANNER_HPP
+#pragma once
+
+#include "readelf.hpp"
+
+#include <string>
+#include <vector>
+#include <functional>
+
+// ------------------------------------------------------------------------------------------------
+
+namespace ELF
+{
+    struct ScanOptions
+    {
+        size_t     threads = 0;                  // 0 uses every hardware thread.
+        LoadMode   mode    = LoadMode::Lazy;     // tables are only decoded if the visitor asks.
+        AccessHint hint    = AccessHint::Random;
+    };
+
+    // What the visitor is handed for every file, valid only during the call. Visitors must not
+    // throw: lazily loaded tables throw on malformed files, so catch around reading them.
+    struct ScanResult
+    {
+        const std::string& path;
+        const Reader*      reader; // nullptr when the file couldn't be read as ELF.
+        const char*        error;  // why it couldn't, nullptr otherwise.
+        size_t             worker; // index of the calling thread, below scan_worker_count().
+    };
+
+    using ScanVisitor = std::function<void(const ScanResult&)>;
+
+    // Number of distinct ScanResult::worker values, for keeping one aggregate per worker.
+    size_t scan_worker_count(const ScanOptions& options);
+
+    // Opens every file on a work-stealing pool, one Reader per task, and calls the visitor
+    // from the workers concurrently. Files are probed first, so anything that isn't ELF costs
+    // a single small read. Returns once every file was visited.
+    void scan_files(const std::vector<std::string>& paths, const ScanVisitor& visitor, const ScanOptions& options = {});
+
+    // Probes every file, in the order given. Reads are batched through io_uring where the
+    // kernel allows it, otherwise spread over a thread pool.
+    std::vector<ProbeResult> probe_files(const std::vector<std::string>& paths, const ScanOptions& options = {});
+
+    // Same as scan_files() over every regular file below root. Files are handed out while the tree is still
+    // being walked, symbolic links and unreadable directories are skipped.
+    void scan_tree(const std::string& root, const ScanVisitor& visitor, const ScanOptions& options = {});
+}
+
+#endif // SCANNER_HPP
@@ -0,0 +1,838 @@
+#include "readelf.hpp"
+#include "dwarf.hpp"
+#include "generator.hpp"
+#include "resolver.hpp"
+
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Round-trip checks over synthetic files, run by ctest one test per process:
+//
+//   readelf-test headers|symbols|relocations|lookup|malformed|lines
+//   readelf-test hash <shared library>
+//   readelf-test ldcache <shared library> <its dependency> <scratch directory>
+//   readelf-test json <readelf demo> <scratch directory>
+
+// ------------------------------------------------------------------------------------------------
+
+#define CHECK(condition)                                                                     \
+    do                                                                                       \
+    {                                                                                        \
+        if(!(condition))                                                                     \
+        {                                                                                    \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": " << #condition << std::endl;     \
+            failures++;                                                                      \
+        }                                                                                    \
+    }                                                                                        \
+    while(false)
+
+namespace
+{
+    size_t failures = 0;
+
+    struct Shape
+    {
+        ELF::FileClass  file_class;
+        ELF::Endianness endian;
+        size_t          sections;
+        size_t          segments;
+    };
+
+    // Every class and byte order, each plain and with SHN_XINDEX and PN_XNUM counts.
+    std::vector<Shape>
+    shapes()
+    {
+        std::vector<Shape> all;
+
+        for (ELF::FileClass file_class : { ELF::FileClass::ELF32, ELF::FileClass::ELF64 })
+        {
+            for (ELF::Endianness endian : { ELF::Endianness::Little, ELF::Endianness::Big })
+            {
+                all.push_back(Shape { file_class, endian, 12, 3 });
+                all.push_back(Shape { file_class, endian, 70000, 70000 });
+            }
+        }
+
+        return all;
+    }
+
+    ELF::GeneratorOptions
+    options_of(const Shape& shape)
+    {
+        ELF::GeneratorOptions options;
+        options.file_class      = shape.file_class;
+        options.endian          = shape.endian;
+        options.sections        = shape.sections;
+        options.program_headers = shape.segments;
+        options.symbols         = 500;
+        options.relocations     = 1200;
+        return options;
+    }
+
+    std::string
+    describe(const Shape& shape)
+    {
+        return std::string(shape.file_class == ELF::FileClass::ELF64 ? "elf64" : "elf32") +
+               (shape.endian == ELF::Endianness::Big ? "be" : "le") + "/" + std::to_string(shape.sections);
+    }
+
+    // Calls check for every shape with a reader over the generated file, eager and lazy.
+    void
+    for_each_file(const std::function<void(const ELF::GeneratorOptions&, const ELF::Reader&)>& check)
+    {
+        for (const Shape& shape : shapes())
+        {
+            ELF::GeneratorOptions options = options_of(shape);
+            std::vector<uint8_t>  bytes   = ELF::generate_elf(options);
+
+            for (ELF::LoadMode mode : { ELF::LoadMode::Eager, ELF::LoadMode::Lazy })
+            {
+                ELF::OpenResult reader = ELF::Reader::open(ELF::ByteView(bytes.data(), bytes.size()), mode);
+                if(!reader)
+                {
+                    std::cerr << describe(shape) << ": " << ELF::to_string(reader.error()) << std::endl;
+                    failures++;
+                    continue;
+                }
+
+                size_t before = failures;
+                check(options, *reader);
+
+                if(failures != before)
+                    std::cerr << "  in " << describe(shape) << std::endl;
+            }
+        }
+    }
+
+    // ------------------------------------------------------------------------------------------------
+
+    void
+    test_headers()
+    {
+        for_each_file([](const ELF::GeneratorOptions& options, const ELF::Reader& reader) {
+            const ELF::FileHeader& header = reader.get_file_header();
+
+            CHECK(header.bits == static_cast<uint8_t>(options.file_class));
+            CHECK(header.endian == options.endian);
+            CHECK(header.type == options.type);
+            CHECK(header.machine == options.machine);
+
+            // Past the 16-bit fields the counts come from section 0.
+            CHECK(reader.get_section_header_count() == options.sections);
+            CHECK(reader.get_program_header_count() == options.program_headers);
+            CHECK(reader.get_section_name_index() == options.sections - 1);
+            CHECK((header.shnum == 0) == (options.sections >= 0xFF00));
+            CHECK((header.phnum == 0xFFFF) == (options.program_headers >= 0xFFFF));
+
+            const auto& sections = reader.get_section_headers();
+            const auto& segments = reader.get_program_headers();
+
+            CHECK(sections.size() == options.sections);
+            CHECK(segments.size() == options.program_headers);
+
+            const ELF::SectionHeader* text = reader.find_section(".text");
+            CHECK(text != nullptr);
+            CHECK(reader.find_section(".shstrtab") == &sections.back());
+            CHECK(reader.find_section(".missing") == nullptr);
+
+            if(text != nullptr)
+            {
+                CHECK(text - sections.data() == std::ptrdiff_t(options.sections - 2));
+                CHECK(text->addr == options.text_address);
+                CHECK(text->size == options.symbols * options.function_size);
+
+                CHECK(segments[0].type == ELF::SegmentType::LOAD);
+                CHECK(segments[0].vaddr == text->addr);
+                CHECK(segments[0].offset == text->offset);
+                CHECK(segments[0].filesz == text->size);
+            }
+
+            for (size_t i = 1; i < segments.size(); i++)
+                CHECK(segments[i].type == ELF::SegmentType::NONE);
+
+            // Filler sections are named after their index.
+            size_t filler = options.sections - 3;
+            CHECK(reader.get_section_name(sections[filler]) == ".fill." + std::to_string(filler));
+        });
+    }
+
+    void
+    test_symbols()
+    {
+        for_each_file([](const ELF::GeneratorOptions& options, const ELF::Reader& reader) {
+            const ELF::SymbolTable& symbols = reader.get_symbol_table();
+            uint32_t text = static_cast<uint32_t>(options.sections - 2);
+
+            CHECK(symbols.count() == options.symbols + 1);
+            CHECK(reader.get_section_name(reader.get_section_headers()[symbols.section]) == ".symtab");
+
+            for (size_t i = 1; i < symbols.count(); i++)
+            {
+                uint64_t function = i - 1;
+
+                CHECK(reader.get_symbol_name(symbols, i) == "function_" + std::to_string(function));
+                CHECK(symbols.value[i] == options.text_address + function * options.function_size);
+                CHECK(symbols.size[i] == options.function_size);
+                CHECK(symbols.binding(i) == ELF::SymbolBinding::GLOBAL);
+                CHECK(symbols.type(i) == ELF::SymbolType::FUNC);
+
+                // SHN_XINDEX entries resolve through .symtab_shndx.
+                CHECK(symbols.shndx[i] == text);
+
+                if(failures != 0)
+                    return;
+            }
+        });
+    }
+
+    void
+    test_relocations()
+    {
+        for_each_file([](const ELF::GeneratorOptions& options, const ELF::Reader& reader) {
+            const ELF::SectionHeader* rela = reader.find_section(".rela.text");
+            CHECK(rela != nullptr);
+
+            if(rela == nullptr)
+                return;
+
+            ELF::RelocationTable table = reader.read_relocations(size_t(rela - reader.get_section_headers().data()));
+
+            CHECK(table.rela);
+            CHECK(table.count() == options.relocations);
+            CHECK(table.target == options.sections - 2);
+            CHECK(table.count_of(1) == options.relocations);
+            CHECK(table.count_of(2) == 0);
+            CHECK(table.large_type_counts.empty());
+
+            for (size_t i = 0; i < table.count(); i++)
+            {
+                uint64_t function = i % options.symbols;
+
+                CHECK(table.offset[i] == options.text_address + function * options.function_size);
+                CHECK(table.symbol[i] == function + 1);
+                CHECK(table.type[i] == 1);
+                CHECK(table.addend[i] == 0);
+
+                if(failures != 0)
+                    return;
+            }
+        });
+    }
+
+    void
+    test_lookup()
+    {
+        for_each_file([](const ELF::GeneratorOptions& options, const ELF::Reader& reader) {
+            for (size_t function : { size_t(0), size_t(1), options.symbols / 2, options.symbols - 1 })
+            {
+                ELF::SymbolLookup found = reader.lookup_symbol("function_" + std::to_string(function));
+
+                CHECK(found);
+                CHECK(found.index == function + 1);
+                CHECK(found.symbol.value == options.text_address + function * options.function_size);
+
+                ELF::AddressLookup address = reader.symbolize(found.symbol.value + 3);
+                CHECK(address.function.index == function + 1);
+                CHECK(address.offset == 3);
+            }
+
+            CHECK(!reader.lookup_symbol("function_"));
+            CHECK(!reader.lookup_symbol("function_" + std::to_string(options.symbols)));
+            CHECK(!reader.symbolize(options.text_address - 1).function);
+        });
+    }
+
+    // Exported functions of a real shared library, found through GNU_HASH or HASH over .dynsym.
+    void
+    test_hash(const std::string& library)
+    {
+        ELF::Reader reader(library);
+
+        const ELF::SectionHeader* hash = reader.find_section(".gnu.hash");
+        if(hash == nullptr)
+            hash = reader.find_section(".hash");
+
+        CHECK(hash != nullptr);
+
+        for (const char* name : { "readelf_test_first", "readelf_test_second", "readelf_test_third" })
+        {
+            ELF::SymbolLookup found = reader.lookup_symbol(name);
+
+            CHECK(found);
+            CHECK(found && reader.get_section_headers()[found.section].type == ELF::SectionType::DYNSYM);
+            CHECK(found.symbol.value != 0);
+        }
+
+        CHECK(!reader.lookup_symbol("readelf_test_missing"));
+    }
+
+    // An ld.so.cache naming one library, in the new format alone or, with compat, after an
+    // old-format header and entry as glibc before 2.32 writes by default.
+    void
+    write_ld_cache(const std::string& path, bool compat, const std::string& name, const std::string& target)
+    {
+        std::string bytes;
+
+        auto u32 = [&bytes](uint32_t value) {
+            bytes.append(reinterpret_cast<const char*>(&value), sizeof(value));
+        };
+
+        if(compat)
+        {
+            // struct cache_file: the magic padded to 12, nlibs, then 12-byte entries.
+            bytes.append("ld.so-1.7.0", 12);
+            u32(1);
+            u32(0x0303); u32(0); u32(0);
+
+            // The new header follows at 4-byte alignment, 28 here.
+            bytes.resize((bytes.size() + 3) & ~size_t(3), '\0');
+        }
+
+        size_t header = bytes.size();
+        bytes.append("glibc-ld.so.cache1.1");
+
+        // Strings follow the single entry, offsets are relative to the new header.
+        uint32_t key   = 48 + 24;
+        uint32_t value = key + uint32_t(name.size()) + 1;
+
+        u32(1);
+        u32(uint32_t(name.size() + target.size() + 2));
+        bytes.resize(header + 48, '\0');
+
+        u32(0x0303); u32(key); u32(value); u32(0); u32(0); u32(0);
+        bytes.append(name).append(1, '\0');
+        bytes.append(target).append(1, '\0');
+
+        std::ofstream(path, std::ios::binary).write(bytes.data(), std::streamsize(bytes.size()));
+    }
+
+    // The dependency of a library without any search path, found only through the cache.
+    void
+    test_ldcache(const std::string& library, const std::string& dependency, const std::string& directory)
+    {
+        std::string name = dependency.substr(dependency.rfind('/') + 1);
+
+        for (bool compat : { false, true })
+        {
+            std::string cache = directory + (compat ? "/compat.cache" : "/new.cache");
+            write_ld_cache(cache, compat, name, dependency);
+
+            ELF::ResolveOptions options;
+            options.cache_file = cache;
+            options.default_paths.clear();
+
+            ELF::DependencyResolver resolver(options);
+            ELF::DependencyGraph    graph = resolver.resolve(library);
+
+            bool found = false;
+            for (const ELF::Dependency& node : graph.nodes)
+                found = found || (node.name == name && node.path == dependency);
+
+            CHECK(found);
+
+            if(!found)
+            {
+                std::cerr << "  with " << cache << std::endl;
+
+                for (const ELF::Dependency& node : graph.nodes)
+                    std::cerr << "  " << node.name << " => " << node.path << std::endl;
+            }
+        }
+    }
+
+    // Corruptions that once made the reader allocate without bound or fail every later lookup.
+    void
+    test_malformed()
+    {
+        ELF::GeneratorOptions options;
+        options.sections = 8;
+
+        std::vector<uint8_t> bytes = ELF::generate_elf(options);
+
+        ELF::Reader pristine(ELF::ByteView(bytes.data(), bytes.size()));
+        const auto& sections = pristine.get_section_headers();
+
+        size_t rela   = size_t(pristine.find_section(".rela.text") - sections.data());
+        size_t filler = 4;
+
+        // r_type of the first relocation set to 0xFFFFFFF0, the low half of a little-endian r_info.
+        std::vector<uint8_t> large_type = bytes;
+        std::memset(large_type.data() + sections[rela].offset + 8, 0xFF, 4);
+        large_type[sections[rela].offset + 8] = 0xF0;
+
+        ELF::Reader relocations(ELF::ByteView(large_type.data(), large_type.size()));
+        ELF::RelocationTable table = relocations.read_relocations(rela);
+
+        CHECK(table.type[0] == 0xFFFFFFF0U);
+        CHECK(table.count_of(0xFFFFFFF0U) == 1);
+        CHECK(table.count_of(1) == options.relocations - 1);
+        CHECK(table.type_counts.size() <= 256);
+
+        // sh_name of a filler section pointing far past .shstrtab.
+        std::vector<uint8_t> bad_name = bytes;
+        std::memset(bad_name.data() + pristine.get_file_header().shoff + filler * pristine.get_file_header().shentsize, 0xFF, 3);
+
+        ELF::Reader names(ELF::ByteView(bad_name.data(), bad_name.size()));
+        CHECK(names.find_section(".text") != nullptr);
+        CHECK(names.find_section(".symtab") != nullptr);
+
+        bool threw = false;
+        try
+        {
+            names.get_section_name(names.get_section_headers()[filler]);
+        }
+        catch(const std::exception&)
+        {
+            threw = true;
+        }
+
+        CHECK(threw);
+    }
+
+    // Little-endian writes for the hand-built DWARF and ELF below.
+    struct Bytes : std::string
+    {
+        Bytes& u8(uint8_t value)   { push_back(char(value)); return *this; }
+        Bytes& u16(uint16_t value) { return u8(uint8_t(value)).u8(uint8_t(value >> 8)); }
+        Bytes& u32(uint32_t value) { return u16(uint16_t(value)).u16(uint16_t(value >> 16)); }
+        Bytes& u64(uint64_t value) { return u32(uint32_t(value)).u32(uint32_t(value >> 32)); }
+        Bytes& str(const char* value) { append(value, std::strlen(value) + 1); return *this; }
+    };
+
+    // An ELF64 executable holding nothing but the named sections.
+    std::vector<uint8_t>
+    debug_file(const std::vector<std::pair<std::string, Bytes>>& sections)
+    {
+        Bytes names;
+        names.u8(0);
+
+        Bytes data;
+        std::vector<std::pair<uint32_t, uint64_t>> placed; // name, offset
+
+        for (const auto& [name, bytes] : sections)
+        {
+            placed.emplace_back(uint32_t(names.size()), 64 + data.size());
+            names.str(name.c_str());
+            data += bytes;
+        }
+
+        placed.emplace_back(uint32_t(names.size()), 64 + data.size());
+        names.str(".shstrtab");
+        data += names;
+
+        Bytes file;
+        file.u32(0x464C457F).u8(2).u8(1).u8(1).u8(0).u64(0);
+        file.u16(2).u16(62).u32(1).u64(0).u64(0).u64(64 + data.size()).u32(0);
+        file.u16(64).u16(56).u16(0).u16(64).u16(uint16_t(placed.size() + 1)).u16(uint16_t(placed.size()));
+        file += data;
+
+        file.append(64, '\0');
+        for (size_t i = 0; i < placed.size(); i++)
+        {
+            uint64_t size = (i < sections.size()) ? sections[i].second.size() : names.size();
+            uint32_t type = (i < sections.size()) ? 1 : 3;
+
+            file.u32(placed[i].first).u32(type).u64(0).u64(0).u64(placed[i].second).u64(size);
+            file.u32(0).u32(0).u64(1).u64(0);
+        }
+
+        return std::vector<uint8_t>(file.begin(), file.end());
+    }
+
+    // A line program over [address, address + 0x20) with a row per file: the unit's first file
+    // from address, the second from address + 0x10 at line 5. DWARF 5 files go through
+    // DW_FORM_indirect and start with the primary file, which no row names.
+    void
+    line_program(Bytes& out, uint16_t version, uint64_t address)
+    {
+        Bytes header;
+        header.u8(1).u8(1).u8(1).u8(uint8_t(-5)).u8(14).u8(13);
+        for (uint8_t length : { 0, 1, 1, 1, 1, 0, 0, 0, 1, 0, 0, 1 })
+            header.u8(length);
+
+        if(version >= 5)
+        {
+            header.u8(1).u8(1).u8(0x08);                   // DW_LNCT_path, DW_FORM_string
+            header.u8(1).str("/v5");
+            header.u8(2).u8(1).u8(0x16).u8(2).u8(0x0f);    // DW_FORM_indirect, DW_LNCT_directory_index
+            header.u8(3);
+            for (const char* name : { "primary.c", "first.c", "second.c" })
+                header.u8(0x08).str(name).u8(0);
+        }
+        else
+        {
+            header.str("/v4").u8(0);
+            header.str("first.c").u8(1).u8(0).u8(0);
+            header.str("second.c").u8(1).u8(0).u8(0);
+            header.u8(0);
+        }
+
+        Bytes program;
+        program.u8(0).u8(9).u8(2).u64(address);            // DW_LNE_set_address
+        program.u8(1);                                     // DW_LNS_copy
+        program.u8(2).u8(0x10).u8(3).u8(4).u8(4).u8(2);    // advance_pc, advance_line, set_file
+        program.u8(1);
+        program.u8(2).u8(0x10).u8(0).u8(1).u8(1);          // DW_LNE_end_sequence
+
+        Bytes unit;
+        unit.u16(version);
+        if(version >= 5)
+            unit.u8(8).u8(0);
+        unit.u32(uint32_t(header.size())) += header;
+        unit += program;
+
+        out.u32(uint32_t(unit.size())) += unit;
+    }
+
+    // A DWARF 4 and a DWARF 5 unit, only the first one listed in .debug_aranges.
+    void
+    test_lines()
+    {
+        Bytes lines;
+        line_program(lines, 4, 0x1000);
+        uint32_t second = uint32_t(lines.size());
+        line_program(lines, 5, 0x2000);
+
+        // Abbreviation 1 has DW_AT_stmt_list as DW_FORM_sec_offset, 2 through DW_FORM_indirect.
+        Bytes abbrev;
+        abbrev.u8(1).u8(0x11).u8(0).u8(0x10).u8(0x17).u8(0).u8(0);
+        abbrev.u8(2).u8(0x11).u8(0).u8(0x10).u8(0x16).u8(0).u8(0);
+        abbrev.u8(0);
+
+        Bytes info;
+        info.u32(12).u16(4).u32(0).u8(8).u8(1).u32(0);
+        info.u32(14).u16(5).u8(1).u8(8).u32(0).u8(2).u8(0x17).u32(second);
+
+        Bytes aranges;
+        aranges.u32(44).u16(2).u32(0).u8(8).u8(0).u32(0);
+        aranges.u64(0x1000).u64(0x20).u64(0).u64(0);
+
+        std::vector<uint8_t> bytes = debug_file({
+            { ".debug_line", lines }, { ".debug_abbrev", abbrev }, { ".debug_info", info }, { ".debug_aranges", aranges }
+        });
+
+        ELF::OpenResult reader = ELF::Reader::open(ELF::ByteView(bytes.data(), bytes.size()));
+        CHECK(reader);
+        if(!reader)
+            return;
+
+        ELF::LineTable table(*reader);
+        CHECK(table.has_lines());
+
+        struct Expected
+        {
+            uint64_t    address;
+            const char* file;
+            const char* directory;
+            uint32_t    line;
+        };
+
+        const Expected expected[] = {
+            { 0x1004, "first.c",  "/v4", 1 },
+            { 0x1018, "second.c", "/v4", 5 },
+            { 0x2000, "first.c",  "/v5", 1 },
+            { 0x201f, "second.c", "/v5", 5 },
+        };
+
+        for (const Expected& row : expected)
+        {
+            ELF::LineInfo info = table.lookup(row.address);
+            CHECK(info.file == row.file && info.directory == row.directory && info.line == row.line);
+
+            if(info.file != row.file || info.line != row.line)
+                std::cerr << "  at 0x" << std::hex << row.address << std::dec << ": " << info.file << ":" << info.line << std::endl;
+        }
+
+        CHECK(table.lookup(0x1020).line == 0);
+        CHECK(table.lookup(0x2020).line == 0);
+    }
+
+    // ------------------------------------------------------------------------------------------------
+
+    // Just enough of a JSON parser to tell whether a document is well formed.
+    class JsonValidator
+    {
+    public:
+        explicit JsonValidator(std::string_view text) : text(text) {}
+
+        bool
+        document()
+        {
+            return value() && (skip(), at == text.size());
+        }
+
+    private:
+        void skip() { while(at < text.size() && (text[at] == ' ' || text[at] == '\t' || text[at] == '\r' || text[at] == '\n')) at++; }
+        bool next(char c) { skip(); return at < text.size() && text[at] == c && (at++, true); }
+
+        bool
+        value()
+        {
+            skip();
+            if(at == text.size())
+                return false;
+
+            switch(text[at])
+            {
+            case '{': return object();
+            case '[': return array();
+            case '"': return string();
+            case 't': return literal("true");
+            case 'f': return literal("false");
+            case 'n': return literal("null");
+            default:  return number();
+            }
+        }
+
+        bool
+        object()
+        {
+            at++;
+            if(next('}'))
+                return true;
+
+            do
+            {
+                skip();
+                if(!string() || !next(':') || !value())
+                    return false;
+            }
+            while(next(','));
+
+            return next('}');
+        }
+
+        bool
+        array()
+        {
+            at++;
+            if(next(']'))
+                return true;
+
+            do
+            {
+                if(!value())
+                    return false;
+            }
+            while(next(','));
+
+            return next(']');
+        }
+
+        bool
+        string()
+        {
+            if(at == text.size() || text[at] != '"')
+                return false;
+
+            for (at++; at < text.size(); at++)
+            {
+                unsigned char c = static_cast<unsigned char>(text[at]);
+
+                if(c == '"')
+                    return at++, true;
+
+                if(c < 0x20)
+                    return false;
+
+                if(c == '\\')
+                {
+                    if(++at == text.size() || std::strchr("\"\\/bfnrtu", text[at]) == nullptr)
+                        return false;
+
+                    if(text[at] == 'u')
+                    {
+                        for (size_t i = 0; i < 4; i++)
+                        {
+                            if(++at == text.size() || !std::isxdigit(static_cast<unsigned char>(text[at])))
+                                return false;
+                        }
+                    }
+                }
+            }
+
+            return false;
+        }
+
+        bool
+        number()
+        {
+            if(at < text.size() && text[at] == '-')
+                at++;
+
+            size_t digits = at;
+            while(at < text.size() && std::isdigit(static_cast<unsigned char>(text[at])))
+                at++;
+
+            // Integers are all the dumps write.
+            return at != digits && (text[digits] != '0' || at == digits + 1);
+        }
+
+        bool
+        literal(std::string_view word)
+        {
+            if(text.substr(at, word.size()) != word)
+                return false;
+
+            at += word.size();
+            return true;
+        }
+
+    private:
+        std::string_view text;
+        size_t           at = 0;
+    };
+
+    bool
+    run(const std::string& command, std::string& output)
+    {
+        FILE* pipe = ::popen(command.c_str(), "r");
+        if(pipe == nullptr)
+            return false;
+
+        char   buffer[1 << 16];
+        size_t length;
+
+        while((length = std::fread(buffer, 1, sizeof(buffer), pipe)) != 0)
+            output.append(buffer, length);
+
+        return ::pclose(pipe) == 0;
+    }
+
+    // The demo's JSON and NDJSON output of generated files, including a name that needs escaping.
+    void
+    test_json(const std::string& demo, const std::string& directory)
+    {
+        // The smallest ELF32 file and the ELF64 big-endian one with extended counts.
+        const std::vector<Shape> all = shapes();
+        const Shape generated[] = { all[0], all[7] };
+
+        std::vector<std::string> files;
+
+        for (const Shape& shape : generated)
+        {
+            std::string path = directory + "/json-" + std::to_string(files.size()) + ".elf";
+            CHECK(ELF::write_elf(path, options_of(shape)));
+            files.push_back(path);
+        }
+
+        ELF::GeneratorOptions escaped;
+        escaped.sections = 8;
+
+        // A section named with a quote, a backslash, a control character and stray UTF-8 bytes.
+        {
+            std::vector<uint8_t> bytes = ELF::generate_elf(escaped);
+            ELF::Reader reader(ELF::ByteView(bytes.data(), bytes.size()));
+
+            const ELF::SectionHeader& names = reader.get_section_headers().back();
+            const ELF::SectionHeader* filler = reader.find_section(".fill.4");
+            CHECK(filler != nullptr);
+
+            if(filler != nullptr)
+                std::memcpy(bytes.data() + names.offset + filler->name, "\"\\\x01\xC3\xFF", 5);
+
+            std::string path = directory + "/json-escaped.elf";
+            std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char*>(bytes.data()), std::streamsize(bytes.size()));
+            files.push_back(path);
+        }
+
+        // No section name table at all, which is valid: e_shstrndx is SHN_UNDEF.
+        {
+            std::vector<uint8_t> bytes = ELF::generate_elf(escaped);
+            std::memset(bytes.data() + (escaped.file_class == ELF::FileClass::ELF64 ? 62 : 50), 0, 2);
+
+            std::string path = directory + "/json-unnamed.elf";
+            std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char*>(bytes.data()), std::streamsize(bytes.size()));
+            files.push_back(path);
+        }
+
+        std::string arguments;
+        for (const std::string& path : files)
+            arguments += " '" + path + "'";
+
+        std::string json;
+        CHECK(run("'" + demo + "' --format=json" + arguments, json));
+        CHECK(JsonValidator(json).document());
+        CHECK(json.find("\"<no-strings>\"") != std::string::npos);
+
+        std::string ndjson;
+        CHECK(run("'" + demo + "' --format=ndjson" + arguments, ndjson));
+
+        // A header record per file, then one per segment and section.
+        size_t expected = 2 * (1 + escaped.sections + escaped.program_headers);
+        for (const Shape& shape : generated)
+            expected += 1 + shape.sections + shape.segments;
+
+        size_t lines = 0;
+        for (size_t first = 0; first < ndjson.size(); lines++)
+        {
+            size_t end = ndjson.find('\n', first);
+            CHECK(end != std::string::npos);
+
+            if(end == std::string::npos)
+                break;
+
+            CHECK(JsonValidator(std::string_view(ndjson).substr(first, end - first)).document());
+            first = end + 1;
+
+            if(failures != 0)
+                return;
+        }
+
+        CHECK(lines == expected);
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+
+int main(int argc, char** argv)
+{
+    std::string name = argc > 1 ? argv[1] : "";
+
+    try
+    {
+        if(name == "headers")
+            test_headers();
+        else if(name == "symbols")
+            test_symbols();
+        else if(name == "relocations")
+            test_relocations();
+        else if(name == "lookup")
+            test_lookup();
+        else if(name == "malformed")
+            test_malformed();
+        else if(name == "lines")
+            test_lines();
+        else if(name == "hash" && argc > 2)
+            test_hash(argv[2]);
+        else if(name == "ldcache" && argc > 4)
+            test_ldcache(argv[2], argv[3], argv[4]);
+        else if(name == "json" && argc > 3)
+            test_json(argv[2], argv[3]);
+        else
+        {
+            std::cerr << "usage: readelf-test headers|symbols|relocations|lookup|malformed|lines\n"
+                         "       readelf-test hash <shared library>\n"
+                         "       readelf-test ldcache <shared library> <its dependency> <scratch directory>\n"
+                         "       readelf-test json <readelf demo> <scratch directory>" << std::endl;
+            return 2;
+        }
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << name << ": " << e.what() << std::endl;
+        return 1;
+    }
+
+    if(failures != 0)
+        std::cerr << failures << " checks failed." << std::endl;
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,3 @@
+// Dependency of readelf-testlib, only reachable through the ld.so.cache readelf-test writes.
+
+extern "C" int readelf_test_base(int value) { return value; }
@@ -0,0 +1,8 @@
+// Exported functions looked up through the hash tables of a real shared library by readelf-test.
+// The library needs readelf-testdep, which readelf-test resolves through an ld.so.cache.
+
+extern "C" int readelf_test_base(int value);
+
+extern "C" int readelf_test_first(int value)  { return readelf_test_base(value) + 1; }
+extern "C" int readelf_test_second(int value) { return readelf_test_base(value) * 2; }
+extern "C" int readelf_test_third(int value)  { return readelf_test_base(value) - 3; }
@@ -0,0 +1,154 @@
+#include "threadpool.hpp"
+
+// ------------------------------------------------------------------------------------------------
+
+namespace ELF
+{
+    // Pool and index of the worker running on this thread.
+    static thread_local const ThreadPool* current_pool  = nullptr;
+    static thread_local size_t            current_index = 0;
+
+    // ------------------------------------------------------------------------------------------------
+
+    ThreadPool::ThreadPool(size_t threads)
+    {
+        if(threads == 0)
+            threads = std::thread::hardware_concurrency();
+
+        if(threads == 0)
+            threads = 1;
+
+        // Outside threads have no queue of their own, they submit round robin and steal while waiting.
+        for (size_t i = 0; i < threads; i++)
+            queues.push_back(std::make_unique<Queue>());
+
+        workers.reserve(threads);
+        for (size_t i = 0; i < threads; i++)
+            workers.emplace_back(&ThreadPool::worker_loop, this, i);
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+            stopping = true;
+        }
+
+        wake.notify_all();
+
+        for (auto& worker : workers)
+            worker.join();
+    }
+
+    size_t
+    ThreadPool::current_worker() const
+    {
+        return (current_pool == this) ? current_index : workers.size();
+    }
+
+    void
+    ThreadPool::submit(TaskGroup& group, Task task)
+    {
+        group.pending.fetch_add(1, std::memory_order_relaxed);
+
+        // Outside threads spread their tasks round robin, a worker keeps its own close.
+        size_t self   = current_worker();
+        size_t target = (self < workers.size()) ? self : next.fetch_add(1, std::memory_order_relaxed) % workers.size();
+
+        {
+            std::lock_guard<std::mutex> lock(queues[target]->mutex);
+            queues[target]->items.push_back(Item { std::move(task), &group });
+        }
+
+        queued.fetch_add(1, std::memory_order_release);
+
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+        }
+
+        wake.notify_one();
+    }
+
+    bool
+    ThreadPool::try_run(size_t self)
+    {
+        Item item { nullptr, nullptr };
+        bool found = false;
+
+        if(self < workers.size())
+        {
+            std::lock_guard<std::mutex> lock(queues[self]->mutex);
+
+            if(!queues[self]->items.empty())
+            {
+                item = std::move(queues[self]->items.back());
+                queues[self]->items.pop_back();
+                found = true;
+            }
+        }
+
+        for (size_t i = 1; !found && i <= queues.size(); i++)
+        {
+            Queue& victim = *queues[(self + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+
+            if(!victim.items.empty())
+            {
+                item = std::move(victim.items.front());
+                victim.items.pop_front();
+                found = true;
+            }
+        }
+
+        if(!found)
+            return false;
+
+        queued.fetch_sub(1, std::memory_order_relaxed);
+        item.task();
+
+        if(item.group->pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+            wake.notify_all();
+        }
+
+        return true;
+    }
+
+    void
+    ThreadPool::worker_loop(size_t index)
+    {
+        current_pool  = this;
+        current_index = index;
+
+        for (;;)
+        {
+            if(try_run(index))
+                continue;
+
+            std::unique_lock<std::mutex> lock(sleep_mutex);
+            wake.wait(lock, [this] { return stopping || queued.load(std::memory_order_acquire) != 0; });
+
+            if(stopping && queued.load(std::memory_order_acquire) == 0)
+                return;
+        }
+    }
+
+    void
+    ThreadPool::wait(TaskGroup& group)
+    {
+        size_t self = current_worker();
+
+        while(group.pending.load(std::memory_order_acquire) != 0)
+        {
+            if(try_run(self))
+                continue;
+
+            std::unique_lock<std::mutex> lock(sleep_mutex);
+            wake.wait(lock, [this, &group] {
+                return group.pending.load(std::memory_order_acquire) == 0 ||
+                       queued.load(std::memory_order_acquire) != 0;
+            });
+        }
+    }
+}
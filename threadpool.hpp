@@ -0,0 +1,102 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2021 Eviatar
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// ------------------------------------------------------------------------------------------------
+
+namespace ELF
+{
+    // Work-stealing thread pool. Every worker pops its own queue from the back and steals
+    // from the front of the others once it runs dry, so one slow task never holds up the rest.
+    class ThreadPool
+    {
+    public:
+        using Task = std::function<void()>;
+
+        // Counts the pending tasks of one batch, so that a caller can wait for exactly those.
+        class TaskGroup
+        {
+            friend class ThreadPool;
+            std::atomic<size_t> pending { 0 };
+        };
+
+        // 0 threads uses every hardware thread.
+        explicit ThreadPool(size_t threads = 0);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        inline size_t size() const { return workers.size(); }
+
+        // Tasks must not throw. A task submitted from a worker goes to that worker's own queue.
+        void submit(TaskGroup& group, Task task);
+
+        // Blocks until every task of the group ran, running queued tasks in the meantime.
+        void wait(TaskGroup& group);
+
+        // Index of the calling worker, size() for any thread outside the pool.
+        size_t current_worker() const;
+
+    private:
+        struct Item
+        {
+            Task       task;
+            TaskGroup* group;
+        };
+
+        struct Queue
+        {
+            std::mutex       mutex;
+            std::deque<Item> items;
+        };
+
+        void worker_loop(size_t index);
+        bool try_run(size_t self);
+
+    private:
+        std::vector<std::unique_ptr<Queue>> queues;
+        std::vector<std::thread>            workers;
+
+        std::mutex              sleep_mutex;
+        std::condition_variable wake;
+        std::atomic<size_t>     queued   { 0 };
+        std::atomic<size_t>     next     { 0 };
+        bool                    stopping = false;
+    };
+}
+
+#endif // THREADPOOL_HPP
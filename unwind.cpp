@@ -0,0 +1,781 @@
+#include "unwind.hpp"
+#include "dwarf.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+// ------------------------------------------------------------------------------------------------
+
+namespace ELF
+{
+    namespace details {
+        // Pointer encodings, the low nibble is the format and the high one how it applies.
+        enum PointerEncoding : uint8_t
+        {
+            DW_EH_PE_absptr   = 0x00,
+            DW_EH_PE_uleb128  = 0x01,
+            DW_EH_PE_udata2   = 0x02,
+            DW_EH_PE_udata4   = 0x03,
+            DW_EH_PE_udata8   = 0x04,
+            DW_EH_PE_sleb128  = 0x09,
+            DW_EH_PE_sdata2   = 0x0A,
+            DW_EH_PE_sdata4   = 0x0B,
+            DW_EH_PE_sdata8   = 0x0C,
+            DW_EH_PE_pcrel    = 0x10,
+            DW_EH_PE_textrel  = 0x20,
+            DW_EH_PE_datarel  = 0x30,
+            DW_EH_PE_funcrel  = 0x40,
+            DW_EH_PE_aligned  = 0x50,
+            DW_EH_PE_indirect = 0x80,
+            DW_EH_PE_omit     = 0xFF
+        };
+
+        enum FrameOpcode : uint8_t
+        {
+            DW_CFA_advance_loc                 = 0x40,
+            DW_CFA_offset                      = 0x80,
+            DW_CFA_restore                     = 0xC0,
+            DW_CFA_nop                         = 0x00,
+            DW_CFA_set_loc                     = 0x01,
+            DW_CFA_advance_loc1                = 0x02,
+            DW_CFA_advance_loc2                = 0x03,
+            DW_CFA_advance_loc4                = 0x04,
+            DW_CFA_offset_extended             = 0x05,
+            DW_CFA_restore_extended            = 0x06,
+            DW_CFA_undefined                   = 0x07,
+            DW_CFA_same_value                  = 0x08,
+            DW_CFA_register                    = 0x09,
+            DW_CFA_remember_state              = 0x0A,
+            DW_CFA_restore_state               = 0x0B,
+            DW_CFA_def_cfa                     = 0x0C,
+            DW_CFA_def_cfa_register            = 0x0D,
+            DW_CFA_def_cfa_offset              = 0x0E,
+            DW_CFA_def_cfa_expression          = 0x0F,
+            DW_CFA_expression                  = 0x10,
+            DW_CFA_offset_extended_sf          = 0x11,
+            DW_CFA_def_cfa_sf                  = 0x12,
+            DW_CFA_def_cfa_offset_sf           = 0x13,
+            DW_CFA_val_offset                  = 0x14,
+            DW_CFA_val_offset_sf               = 0x15,
+            DW_CFA_val_expression              = 0x16,
+            DW_CFA_GNU_window_save             = 0x2D, // AArch64 negate_ra_state, no operands.
+            DW_CFA_GNU_args_size               = 0x2E,
+            DW_CFA_GNU_negative_offset_extended = 0x2F
+        };
+
+        // What a CIE contributes to its FDEs.
+        struct CommonInformation
+        {
+            uint64_t code_alignment  = 1;
+            int64_t  data_alignment  = 1;
+            uint32_t return_register = 0;
+            uint8_t  fde_encoding    = DW_EH_PE_absptr;
+            uint8_t  lsda_encoding   = DW_EH_PE_omit;
+            bool     augmented       = false; // 'z', FDEs carry augmentation data.
+            bool     signal_frame    = false;
+            uint64_t personality     = 0;
+            ByteView instructions;
+        };
+
+        struct FrameRow
+        {
+            uint64_t begin;
+            CfaRule  cfa;
+            uint32_t first; // into FrameRules::registers.
+            uint32_t count;
+        };
+
+        // Interpreted instructions of one FDE, rows sorted by address.
+        struct FrameRules
+        {
+            uint64_t                  end = 0;
+            uint32_t                  return_register = 0;
+            std::vector<FrameRow>     rows;
+            std::vector<RegisterRule> registers;
+        };
+
+        struct FrameState
+        {
+            CfaRule                   cfa;
+            std::vector<RegisterRule> registers; // sorted by register.
+
+            void
+            set(const RegisterRule& rule)
+            {
+                auto it = std::lower_bound(registers.begin(), registers.end(), rule.reg, [](const RegisterRule& r, uint32_t reg) {
+                    return r.reg < reg;
+                });
+
+                if(it != registers.end() && it->reg == rule.reg)
+                    *it = rule;
+                else
+                    registers.insert(it, rule);
+            }
+
+            // Back to the rule of the CIE's initial instructions, none when they didn't set one.
+            void
+            restore(uint32_t reg, const FrameState& initial)
+            {
+                auto is_reg = [reg](const RegisterRule& r) { return r.reg == reg; };
+                auto it     = std::find_if(initial.registers.begin(), initial.registers.end(), is_reg);
+
+                if(it != initial.registers.end())
+                    set(*it);
+                else
+                    registers.erase(std::remove_if(registers.begin(), registers.end(), is_reg), registers.end());
+            }
+        };
+
+        // Bytes of a fixed-size pointer format, 0 for the LEB128 ones.
+        static inline
+        size_t
+        pointer_size(uint8_t encoding, uint8_t address_size)
+        {
+            switch(encoding & 0x0F)
+            {
+            case DW_EH_PE_absptr: return address_size;
+            case DW_EH_PE_udata2:
+            case DW_EH_PE_sdata2: return 2;
+            case DW_EH_PE_udata4:
+            case DW_EH_PE_sdata4: return 4;
+            case DW_EH_PE_udata8:
+            case DW_EH_PE_sdata8: return 8;
+            default:              return 0;
+            }
+        }
+    }
+
+    // ------------------------------------------------------------------------------------------------
+
+    UnwindTable::UnwindTable(const Reader& reader)
+        : reader(reader),
+          endian(reader.get_file_header().endian),
+          address_size(reader.get_file_header().bits == uint8_t(FileClass::ELF64) ? 8 : 4)
+    {
+        if(const ProgramHeader* segment = reader.find_segment(SegmentType::GNU_EH_FRAME))
+        {
+            header         = reader.get_segment_data(*segment);
+            header_address = segment->vaddr;
+        }
+        else if(const SectionHeader* section = reader.find_section(".eh_frame_hdr"))
+        {
+            header         = reader.get_section_data(*section);
+            header_address = section->addr;
+        }
+
+        if(!header.empty() && !read_header())
+            throw std::runtime_error("Malformed .eh_frame_hdr.");
+
+        if(frames.empty())
+        {
+            if(const SectionHeader* section = reader.find_section(".eh_frame"))
+            {
+                frames         = reader.get_section_data(*section);
+                frames_address = section->addr;
+            }
+        }
+    }
+
+    UnwindTable::~UnwindTable() = default;
+
+    bool
+    UnwindTable::read_header()
+    {
+        using namespace details;
+
+        DwarfCursor cursor(header, 0, endian);
+
+        uint8_t version        = cursor.u8();
+        uint8_t frame_encoding = cursor.u8();
+        uint8_t count_encoding = cursor.u8();
+        table_encoding         = cursor.u8();
+
+        uint64_t frame_pointer = 0;
+        if(!cursor.ok() || version != 1 || !read_pointer(cursor, frame_encoding, header_address, frame_pointer))
+            return false;
+
+        // .eh_frame is where the header says, its section when there is one or else the rest of its segment.
+        const SectionHeader* section = reader.find_section(".eh_frame");
+        if(section && section->addr == frame_pointer)
+            frames = reader.get_section_data(*section);
+        else
+        {
+            for (const ProgramHeader& segment : reader.get_program_headers())
+            {
+                if(segment.type == SegmentType::LOAD && frame_pointer >= segment.vaddr && frame_pointer - segment.vaddr < segment.filesz)
+                {
+                    frames = reader.get_segment_data(segment).subview(size_t(frame_pointer - segment.vaddr));
+                    break;
+                }
+            }
+        }
+
+        frames_address = frame_pointer;
+
+        uint64_t count = 0;
+        if(count_encoding == DW_EH_PE_omit || table_encoding == DW_EH_PE_omit)
+            return true;
+
+        if(!read_pointer(cursor, count_encoding, header_address, count))
+            return false;
+
+        table_offset = cursor.offset();
+        table_field  = pointer_size(table_encoding, address_size);
+        search_table = true;
+
+        // Fixed-size entries are searched in place, others are decoded once.
+        if(table_field != 0 && (table_encoding & 0x70) != DW_EH_PE_aligned && !(table_encoding & DW_EH_PE_indirect))
+        {
+            if(count > cursor.remaining() / (2 * table_field))
+                return false;
+
+            table_count = size_t(count);
+            return true;
+        }
+
+        for (uint64_t i = 0; i < count && cursor.remaining(); i++)
+        {
+            uint64_t location = 0, entry = 0;
+            if(!read_pointer(cursor, table_encoding, header_address, location) || !read_pointer(cursor, table_encoding, header_address, entry))
+                return false;
+
+            if(entry >= frames_address && entry - frames_address < frames.size())
+                sorted_frames.emplace_back(location, entry - frames_address);
+        }
+
+        std::sort(sorted_frames.begin(), sorted_frames.end());
+        frames_sorted = true;
+        return true;
+    }
+
+    bool
+    UnwindTable::read_pointer(details::DwarfCursor& cursor, uint8_t encoding, uint64_t base, uint64_t& value) const
+    {
+        using namespace details;
+
+        if(encoding == DW_EH_PE_omit)
+            return false;
+
+        if((encoding & 0x70) == DW_EH_PE_aligned)
+            cursor.skip((address_size - (base + cursor.offset()) % address_size) % address_size);
+
+        uint64_t field = base + cursor.offset();
+
+        switch(encoding & 0x0F)
+        {
+        case DW_EH_PE_absptr:  value = cursor.unsigned_value(address_size); break;
+        case DW_EH_PE_uleb128: value = cursor.uleb(); break;
+        case DW_EH_PE_udata2:  value = cursor.u16(); break;
+        case DW_EH_PE_udata4:  value = cursor.u32(); break;
+        case DW_EH_PE_udata8:  value = cursor.unsigned_value(8); break;
+        case DW_EH_PE_sleb128: value = uint64_t(cursor.sleb()); break;
+        case DW_EH_PE_sdata2:  value = uint64_t(int64_t(int16_t(cursor.u16()))); break;
+        case DW_EH_PE_sdata4:  value = uint64_t(int64_t(int32_t(cursor.u32()))); break;
+        case DW_EH_PE_sdata8:  value = cursor.unsigned_value(8); break;
+        default:               return false;
+        }
+
+        // A zero pointer stays zero whatever its encoding, as with GCC's unwinder. Data-relative
+        // pointers are only defined by .eh_frame_hdr, relative to its start.
+        if(value == 0)
+            return cursor.ok();
+
+        switch(encoding & 0x70)
+        {
+        case DW_EH_PE_absptr:
+        case DW_EH_PE_aligned: break;
+        case DW_EH_PE_pcrel:   value += field; break;
+        case DW_EH_PE_datarel: value += header_address; break;
+        default:               return false;
+        }
+
+        if(address_size == 4)
+            value &= 0xFFFFFFFFU;
+
+        // Indirect pointers go through a pointer stored in the file, as it is before relocation.
+        if(encoding & DW_EH_PE_indirect)
+        {
+            std::optional<uint64_t> offset = reader.virtual_to_offset(value);
+            if(!offset)
+                return false;
+
+            DwarfCursor target(reader.get_data(), size_t(std::min<uint64_t>(*offset, reader.get_data().size())), endian);
+            value = target.unsigned_value(address_size);
+
+            if(!target.ok())
+                return false;
+        }
+
+        return cursor.ok();
+    }
+
+    // ------------------------------------------------------------------------------------------------
+
+    const details::CommonInformation*
+    UnwindTable::read_cie(uint64_t offset) const
+    {
+        using namespace details;
+
+        if(auto it = cies.find(offset); it != cies.end())
+            return it->second.get();
+
+        DwarfCursor cursor(frames, size_t(std::min<uint64_t>(offset, frames.size())), endian);
+        uint8_t     offset_size = 4;
+        uint64_t    end = cursor.initial_length(offset_size);
+        uint64_t    id  = cursor.unsigned_value(offset_size);
+        uint8_t     version = cursor.u8();
+        std::string_view augmentation = cursor.string();
+
+        if(!cursor.ok() || id != 0 || (version != 1 && version != 3 && version != 4))
+            return nullptr;
+
+        auto cie = std::make_unique<CommonInformation>();
+
+        // GCC 2 "eh" augmentation: the address of an exception table.
+        if(augmentation.compare(0, 2, "eh") == 0)
+            cursor.skip(address_size);
+
+        if(version == 4)
+            cursor.skip(2); // address and segment selector sizes
+
+        cie->code_alignment  = cursor.uleb();
+        cie->data_alignment  = cursor.sleb();
+        cie->return_register = static_cast<uint32_t>(version == 1 ? cursor.u8() : cursor.uleb());
+
+        if(!augmentation.empty() && augmentation[0] == 'z')
+        {
+            cie->augmented = true;
+
+            uint64_t length = cursor.uleb();
+            size_t   next   = cursor.offset() + size_t(std::min<uint64_t>(length, cursor.remaining()));
+            uint64_t base   = frames_address;
+
+            for (char c : augmentation.substr(1))
+            {
+                if(c == 'L')
+                    cie->lsda_encoding = cursor.u8();
+                else if(c == 'R')
+                    cie->fde_encoding = cursor.u8();
+                else if(c == 'S')
+                    cie->signal_frame = true;
+                else if(c == 'P')
+                {
+                    uint8_t encoding = cursor.u8();
+                    if(!read_pointer(cursor, encoding, base, cie->personality))
+                        return nullptr;
+                }
+                else if(c != 'B' && c != 'G')
+                    break; // the data length still says where the instructions start.
+            }
+
+            cursor.seek(next);
+        }
+
+        if(!cursor.ok() || cursor.offset() > end)
+            return nullptr;
+
+        cie->instructions = frames.subview(cursor.offset(), size_t(end) - cursor.offset());
+        return cies.emplace(offset, std::move(cie)).first->second.get();
+    }
+
+    std::optional<FrameDescription>
+    UnwindTable::read_fde(uint64_t offset) const
+    {
+        using namespace details;
+
+        DwarfCursor cursor(frames, size_t(std::min<uint64_t>(offset, frames.size())), endian);
+        uint8_t     offset_size = 4;
+        uint64_t    end     = cursor.initial_length(offset_size);
+        uint64_t    id_at   = cursor.offset();
+        uint64_t    pointer = cursor.unsigned_value(offset_size);
+
+        // In .eh_frame the CIE pointer counts back from its own field, 0 marks a CIE.
+        if(!cursor.ok() || pointer == 0 || pointer > id_at)
+            return std::nullopt;
+
+        const CommonInformation* cie = read_cie(id_at - pointer);
+        if(cie == nullptr)
+            return std::nullopt;
+
+        FrameDescription fde;
+        uint64_t range = 0;
+
+        fde.offset     = offset;
+        fde.cie_offset = id_at - pointer;
+
+        // The range has the format of the start, but is never relative.
+        if(!read_pointer(cursor, cie->fde_encoding, frames_address, fde.begin) ||
+           !read_pointer(cursor, cie->fde_encoding & 0x0F, frames_address, range))
+            return std::nullopt;
+
+        fde.end = fde.begin + range;
+
+        if(cie->augmented)
+        {
+            uint64_t length = cursor.uleb();
+            size_t   next   = cursor.offset() + size_t(std::min<uint64_t>(length, cursor.remaining()));
+
+            if(cie->lsda_encoding != DW_EH_PE_omit && length != 0)
+                read_pointer(cursor, cie->lsda_encoding, frames_address, fde.lsda);
+
+            cursor.seek(next);
+        }
+
+        if(!cursor.ok() || cursor.offset() > end)
+            return std::nullopt;
+
+        fde.personality          = cie->personality;
+        fde.code_alignment       = cie->code_alignment;
+        fde.data_alignment       = cie->data_alignment;
+        fde.return_register      = cie->return_register;
+        fde.signal_frame         = cie->signal_frame;
+        fde.initial_instructions = cie->instructions;
+        fde.instructions         = frames.subview(cursor.offset(), size_t(end) - cursor.offset());
+
+        return fde;
+    }
+
+    // ------------------------------------------------------------------------------------------------
+
+    void
+    UnwindTable::sort_frames() const
+    {
+        frames_sorted = true;
+
+        details::DwarfCursor cursor(frames, 0, endian);
+
+        while(cursor.remaining())
+        {
+            uint64_t offset = cursor.offset();
+            uint8_t  offset_size = 4;
+            uint64_t end = cursor.initial_length(offset_size);
+
+            // A zero length terminates .eh_frame.
+            if(!cursor.ok() || end == cursor.offset())
+                break;
+
+            if(std::optional<FrameDescription> fde = read_fde(offset); fde && fde->end > fde->begin)
+                sorted_frames.emplace_back(fde->begin, offset);
+
+            cursor.seek(end);
+        }
+
+        std::sort(sorted_frames.begin(), sorted_frames.end());
+    }
+
+    // Offset of the FDE with the greatest initial location not above the address.
+    bool
+    UnwindTable::find_entry(uint64_t address, uint64_t& offset) const
+    {
+        if(table_count != 0)
+        {
+            auto location = [this](size_t index, size_t field, uint64_t& value) {
+                details::DwarfCursor cursor(header, table_offset + (2 * index + field) * table_field, endian);
+                return read_pointer(cursor, table_encoding, header_address, value);
+            };
+
+            size_t low = 0, high = table_count;
+            while(low < high)
+            {
+                size_t   middle = low + (high - low) / 2;
+                uint64_t value  = 0;
+
+                if(!location(middle, 0, value))
+                    return false;
+
+                if(value <= address)
+                    low = middle + 1;
+                else
+                    high = middle;
+            }
+
+            uint64_t entry = 0;
+            if(low == 0 || !location(low - 1, 1, entry) || entry < frames_address)
+                return false;
+
+            offset = entry - frames_address;
+            return offset < frames.size();
+        }
+
+        if(!frames_sorted)
+            sort_frames();
+
+        auto it = std::upper_bound(sorted_frames.begin(), sorted_frames.end(), address, [](uint64_t address, const std::pair<uint64_t, uint64_t>& entry) {
+            return address < entry.first;
+        });
+
+        if(it == sorted_frames.begin())
+            return false;
+
+        offset = (it - 1)->second;
+        return true;
+    }
+
+    size_t
+    UnwindTable::get_fde_count() const
+    {
+        if(table_count != 0)
+            return table_count;
+
+        if(!frames_sorted)
+            sort_frames();
+
+        return sorted_frames.size();
+    }
+
+    std::optional<FrameDescription>
+    UnwindTable::find_fde(uint64_t address) const
+    {
+        uint64_t offset = 0;
+        if(frames.empty() || !find_entry(address, offset))
+            return std::nullopt;
+
+        std::optional<FrameDescription> fde = read_fde(offset);
+        if(!fde || address < fde->begin || address >= fde->end)
+            return std::nullopt;
+
+        return fde;
+    }
+
+    // ------------------------------------------------------------------------------------------------
+
+    const details::FrameRules*
+    UnwindTable::get_rules(uint64_t offset) const
+    {
+        using namespace details;
+
+        if(auto it = rules.find(offset); it != rules.end())
+            return it->second.get();
+
+        std::optional<FrameDescription> fde = read_fde(offset);
+        if(!fde)
+            return nullptr;
+
+        auto result = std::make_unique<FrameRules>();
+        result->end             = fde->end;
+        result->return_register = fde->return_register;
+
+        FrameState state;
+        FrameState initial;
+        std::vector<FrameState> stack;
+
+        uint64_t location = fde->begin;
+        bool     valid    = true;
+
+        auto add_row = [&] {
+            if(!result->rows.empty() && result->rows.back().begin == location)
+                result->rows.pop_back();
+
+            result->rows.push_back(FrameRow { location, state.cfa, static_cast<uint32_t>(result->registers.size()), static_cast<uint32_t>(state.registers.size()) });
+            result->registers.insert(result->registers.end(), state.registers.begin(), state.registers.end());
+        };
+
+        // Runs the CIE's initial instructions, then the FDE's. A row is closed whenever the location moves.
+        auto run = [&](ByteView program, bool advances) {
+            DwarfCursor cursor(program, 0, endian);
+            uint64_t    base = frames_address + uint64_t(program.data() - frames.data());
+
+            auto advance = [&](uint64_t target) {
+                if(advances && target != location)
+                {
+                    add_row();
+                    location = target;
+                }
+            };
+
+            auto rule = [&](uint64_t reg, RegisterRuleType type, int64_t value, ByteView expression = {}) {
+                state.set(RegisterRule { static_cast<uint32_t>(reg), type, value, expression });
+            };
+
+            auto block = [&]() {
+                uint64_t length = cursor.uleb();
+                ByteView bytes  = program.subview(cursor.offset(), size_t(std::min<uint64_t>(length, cursor.remaining())));
+                cursor.skip(length);
+                return bytes;
+            };
+
+            int64_t factor = fde->data_alignment;
+
+            while(cursor.remaining() && valid)
+            {
+                uint8_t opcode  = cursor.u8();
+                uint8_t operand = opcode & 0x3F;
+
+                switch(opcode & 0xC0)
+                {
+                case DW_CFA_advance_loc:
+                    advance(location + operand * fde->code_alignment);
+                    continue;
+                case DW_CFA_offset:
+                    rule(operand, RegisterRuleType::Offset, int64_t(cursor.uleb()) * factor);
+                    continue;
+                case DW_CFA_restore:
+                    state.restore(operand, initial);
+                    continue;
+                default:
+                    break;
+                }
+
+                switch(opcode)
+                {
+                case DW_CFA_nop:
+                    break;
+                case DW_CFA_set_loc:
+                {
+                    uint64_t target = 0;
+                    const CommonInformation* cie = read_cie(fde->cie_offset);
+                    valid = cie && read_pointer(cursor, cie->fde_encoding, base, target);
+                    advance(target);
+                    break;
+                }
+                case DW_CFA_advance_loc1: advance(location + cursor.u8() * fde->code_alignment); break;
+                case DW_CFA_advance_loc2: advance(location + cursor.u16() * fde->code_alignment); break;
+                case DW_CFA_advance_loc4: advance(location + cursor.u32() * fde->code_alignment); break;
+                case DW_CFA_offset_extended:
+                {
+                    uint64_t reg = cursor.uleb();
+                    rule(reg, RegisterRuleType::Offset, int64_t(cursor.uleb()) * factor);
+                    break;
+                }
+                case DW_CFA_offset_extended_sf:
+                {
+                    uint64_t reg = cursor.uleb();
+                    rule(reg, RegisterRuleType::Offset, cursor.sleb() * factor);
+                    break;
+                }
+                case DW_CFA_GNU_negative_offset_extended:
+                {
+                    uint64_t reg = cursor.uleb();
+                    rule(reg, RegisterRuleType::Offset, -int64_t(cursor.uleb()) * factor);
+                    break;
+                }
+                case DW_CFA_val_offset:
+                {
+                    uint64_t reg = cursor.uleb();
+                    rule(reg, RegisterRuleType::ValOffset, int64_t(cursor.uleb()) * factor);
+                    break;
+                }
+                case DW_CFA_val_offset_sf:
+                {
+                    uint64_t reg = cursor.uleb();
+                    rule(reg, RegisterRuleType::ValOffset, cursor.sleb() * factor);
+                    break;
+                }
+                case DW_CFA_restore_extended:
+                    state.restore(static_cast<uint32_t>(cursor.uleb()), initial);
+                    break;
+                case DW_CFA_undefined:
+                    rule(cursor.uleb(), RegisterRuleType::Undefined, 0);
+                    break;
+                case DW_CFA_same_value:
+                    rule(cursor.uleb(), RegisterRuleType::SameValue, 0);
+                    break;
+                case DW_CFA_register:
+                {
+                    uint64_t reg = cursor.uleb();
+                    rule(reg, RegisterRuleType::Register, int64_t(cursor.uleb()));
+                    break;
+                }
+                case DW_CFA_expression:
+                {
+                    uint64_t reg = cursor.uleb();
+                    rule(reg, RegisterRuleType::Expression, 0, block());
+                    break;
+                }
+                case DW_CFA_val_expression:
+                {
+                    uint64_t reg = cursor.uleb();
+                    rule(reg, RegisterRuleType::ValExpression, 0, block());
+                    break;
+                }
+                case DW_CFA_remember_state:
+                    stack.push_back(state);
+                    break;
+                case DW_CFA_restore_state:
+                    // The CFA is restored too, as GCC's unwinder does.
+                    valid = !stack.empty();
+                    if(valid)
+                    {
+                        state = std::move(stack.back());
+                        stack.pop_back();
+                    }
+                    break;
+                case DW_CFA_def_cfa:
+                    state.cfa.type   = CfaRuleType::RegisterOffset;
+                    state.cfa.reg    = static_cast<uint32_t>(cursor.uleb());
+                    state.cfa.offset = int64_t(cursor.uleb());
+                    break;
+                case DW_CFA_def_cfa_sf:
+                    state.cfa.type   = CfaRuleType::RegisterOffset;
+                    state.cfa.reg    = static_cast<uint32_t>(cursor.uleb());
+                    state.cfa.offset = cursor.sleb() * factor;
+                    break;
+                case DW_CFA_def_cfa_register:
+                    state.cfa.type = CfaRuleType::RegisterOffset;
+                    state.cfa.reg  = static_cast<uint32_t>(cursor.uleb());
+                    break;
+                case DW_CFA_def_cfa_offset:
+                    state.cfa.offset = int64_t(cursor.uleb());
+                    break;
+                case DW_CFA_def_cfa_offset_sf:
+                    state.cfa.offset = cursor.sleb() * factor;
+                    break;
+                case DW_CFA_def_cfa_expression:
+                    state.cfa.type       = CfaRuleType::Expression;
+                    state.cfa.expression = block();
+                    break;
+                case DW_CFA_GNU_args_size:
+                    cursor.uleb();
+                    break;
+                case DW_CFA_GNU_window_save:
+                    break;
+                default:
+                    valid = false;
+                    break;
+                }
+            }
+
+            valid = valid && cursor.ok();
+        };
+
+        run(fde->initial_instructions, false);
+        initial = state;
+        run(fde->instructions, true);
+
+        if(!valid)
+            return nullptr;
+
+        if(location < fde->end)
+            add_row();
+
+        result->rows.shrink_to_fit();
+        result->registers.shrink_to_fit();
+
+        return rules.emplace(offset, std::move(result)).first->second.get();
+    }
+
+    std::optional<UnwindRow>
+    UnwindTable::find_row(uint64_t address) const
+    {
+        uint64_t offset = 0;
+        if(frames.empty() || !find_entry(address, offset))
+            return std::nullopt;
+
+        const details::FrameRules* frame = get_rules(offset);
+        if(frame == nullptr || frame->rows.empty() || address < frame->rows.front().begin || address >= frame->end)
+            return std::nullopt;
+
+        auto it = std::upper_bound(frame->rows.begin(), frame->rows.end(), address, [](uint64_t address, const details::FrameRow& row) {
+            return address < row.begin;
+        }) - 1;
+
+        UnwindRow row;
+        row.begin           = it->begin;
+        row.end             = (it + 1 != frame->rows.end()) ? (it + 1)->begin : frame->end;
+        row.cfa             = it->cfa;
+        row.registers       = ArrayView<RegisterRule>(frame->registers.data() + it->first, it->count);
+        row.return_register = frame->return_register;
+
+        return row;
+    }
+}
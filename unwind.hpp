@@ -0,0 +1,178 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2021 Eviatar
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef UNWIND_HPP
+#define UNWIND_HPP
+#pragma once
+
+#include "readelf.hpp"
+
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+// ------------------------------------------------------------------------------------------------
+
+namespace ELF
+{
+    // Frame description entry of .eh_frame with what its CIE adds, addresses are virtual.
+    struct FrameDescription
+    {
+        uint64_t begin           = 0; // first address covered.
+        uint64_t end             = 0; // first address past it.
+        uint64_t offset          = 0; // of the FDE in .eh_frame.
+        uint64_t cie_offset      = 0;
+        uint64_t lsda            = 0; // 0 when there is none, as for the personality.
+        uint64_t personality     = 0;
+        uint64_t code_alignment  = 1;
+        int64_t  data_alignment  = 1;
+        uint32_t return_register = 0;
+        bool     signal_frame    = false;
+        ByteView initial_instructions; // of the CIE.
+        ByteView instructions;
+    };
+
+    enum class CfaRuleType : uint8_t
+    {
+        RegisterOffset, // CFA = register + offset
+        Expression      // CFA = value of the DWARF expression
+    };
+
+    struct CfaRule
+    {
+        CfaRuleType type     = CfaRuleType::RegisterOffset;
+        uint32_t    reg      = 0;
+        int64_t     offset   = 0;
+        ByteView    expression;
+    };
+
+    // How the caller's value of a register is recovered.
+    enum class RegisterRuleType : uint8_t
+    {
+        Undefined,
+        SameValue,
+        Offset,        // saved at CFA + value
+        ValOffset,     // is CFA + value
+        Register,      // saved in register value
+        Expression,    // saved at the address the expression computes
+        ValExpression  // is the value of the expression
+    };
+
+    struct RegisterRule
+    {
+        uint32_t         reg   = 0;
+        RegisterRuleType type  = RegisterRuleType::Undefined;
+        int64_t          value = 0;
+        ByteView         expression;
+    };
+
+    // Rules in effect over [begin, end) of a function. Registers without a rule keep their
+    // value, the views point into the table's cache and .eh_frame.
+    struct UnwindRow
+    {
+        uint64_t                begin = 0;
+        uint64_t                end   = 0;
+        CfaRule                 cfa;
+        ArrayView<RegisterRule> registers;
+        uint32_t                return_register = 0;
+    };
+
+    namespace details {
+        class DwarfCursor;
+        struct CommonInformation;
+        struct FrameRules;
+    }
+
+    // Offline unwinding support over .eh_frame. The FDE covering an address is found by a
+    // binary search of the .eh_frame_hdr table (PT_GNU_EH_FRAME), read in place whatever its
+    // pointer encoding; files without one get a table sorted from .eh_frame on first lookup.
+    // The call frame instructions of an FDE are interpreted once into rows of rules which
+    // are cached, so that repeated lookups in a function are two binary searches and a hash.
+    //
+    // Like the Reader, lookups fill caches and need the caller's own synchronization.
+    class UnwindTable
+    {
+    public:
+        // Throws std::runtime_error when .eh_frame_hdr is malformed.
+        explicit UnwindTable(const Reader& reader);
+        ~UnwindTable();
+
+        UnwindTable(const UnwindTable&) = delete;
+        UnwindTable& operator=(const UnwindTable&) = delete;
+
+        inline bool has_frames() const       { return !frames.empty(); }
+        inline bool has_search_table() const { return search_table; }
+
+        size_t get_fde_count() const;
+
+        // FDE covering the address, nullopt when none does or it can't be parsed.
+        std::optional<FrameDescription> find_fde(uint64_t address) const;
+
+        // Row of rules in effect at the address, nullopt without a covering FDE or when its
+        // instructions use an opcode this interpreter doesn't know.
+        std::optional<UnwindRow> find_row(uint64_t address) const;
+
+        // FDE parsed at an offset of .eh_frame, nullopt for a CIE or malformed entry.
+        std::optional<FrameDescription> read_fde(uint64_t offset) const;
+
+        inline size_t get_cached_fde_count() const { return rules.size(); }
+
+    private:
+        bool read_header();
+        bool find_entry(uint64_t address, uint64_t& offset) const;
+        void sort_frames() const;
+
+        bool read_pointer(details::DwarfCursor& cursor, uint8_t encoding, uint64_t base, uint64_t& value) const;
+
+        const details::CommonInformation* read_cie(uint64_t offset) const;
+        const details::FrameRules* get_rules(uint64_t offset) const;
+
+    private:
+        const Reader& reader;
+        Endianness    endian;
+        uint8_t       address_size;
+
+        ByteView frames;            // .eh_frame
+        uint64_t frames_address = 0;
+
+        // Search table of .eh_frame_hdr, entries of two pointers in table_encoding. Tables of
+        // variable-length pointers are decoded into sorted_frames instead of read in place.
+        ByteView header;
+        uint64_t header_address = 0;
+        size_t   table_offset   = 0;
+        size_t   table_count    = 0;
+        size_t   table_field    = 0;
+        uint8_t  table_encoding = 0;
+        bool     search_table   = false;
+
+        // Without a usable table: (initial location, FDE offset) pairs sorted on first lookup.
+        mutable std::vector<std::pair<uint64_t, uint64_t>> sorted_frames;
+        mutable bool frames_sorted = false;
+
+        mutable std::unordered_map<uint64_t, std::unique_ptr<const details::CommonInformation>> cies;
+        mutable std::unordered_map<uint64_t, std::unique_ptr<const details::FrameRules>> rules;
+    };
+}
+
+#endif // UNWIND_HPP